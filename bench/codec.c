@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <lwmqtt/pipe.h>
+
+#include "../src/packet.h"
+
+#define MAX_PAYLOAD (1024 * 1024)
+#define MAX_FILTERS 1000
+#define MAX_CLIENT_PAYLOAD 4096
+
+static uint8_t payload[MAX_PAYLOAD];
+static uint8_t buf[MAX_PAYLOAD + 1024];
+static size_t buf_len;
+
+static char filters[MAX_FILTERS][32];
+static lwmqtt_string_t topic_filters[MAX_FILTERS];
+static lwmqtt_qos_t qos_levels[MAX_FILTERS];
+
+static lwmqtt_pipe_clock_t pipe_clock;
+static lwmqtt_pipe_t pipe;
+static uint8_t pipe_buf[4 * (MAX_CLIENT_PAYLOAD + 256)];
+static lwmqtt_pipe_timer_t timer1, timer2;
+static lwmqtt_client_t client;
+static uint8_t write_buf[MAX_CLIENT_PAYLOAD + 256], read_buf[MAX_CLIENT_PAYLOAD + 256];
+static uint8_t packet[MAX_CLIENT_PAYLOAD + 256];
+static size_t packet_len;
+
+static size_t allocations = 0;
+
+#ifdef BENCH_WRAP_MALLOC
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t num, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  allocations++;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t num, size_t size) {
+  allocations++;
+  return __real_calloc(num, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  allocations++;
+  return __real_realloc(ptr, size);
+}
+
+#endif
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+  int count;
+  size_t payload_len;
+  uint32_t varnum;
+  lwmqtt_packet_type_t packet_type;
+  lwmqtt_qos_t qos;
+} params_t;
+
+typedef lwmqtt_err_t (*bench_fn_t)(params_t *params);
+
+static lwmqtt_err_t encode_connect(params_t *params) {
+  lwmqtt_options_t options = lwmqtt_default_options;
+  options.client_id = lwmqtt_string("lwmqtt-bench-client");
+  options.username = lwmqtt_string("username");
+  options.password = lwmqtt_string("password");
+  lwmqtt_will_t will = lwmqtt_default_will;
+  will.topic = lwmqtt_string("clients/lwmqtt-bench-client/status");
+  will.payload = lwmqtt_string("offline");
+  return lwmqtt_encode_connect(buf, sizeof(buf), &buf_len, options, &will);
+}
+
+static lwmqtt_err_t decode_connack(params_t *params) {
+  bool session_present;
+  lwmqtt_return_code_t return_code;
+  return lwmqtt_decode_connack(buf, buf_len, &session_present, &return_code);
+}
+
+static lwmqtt_err_t encode_publish(params_t *params) {
+  lwmqtt_message_t msg = {LWMQTT_QOS1, false, payload, params->payload_len};
+  return lwmqtt_encode_publish(buf, sizeof(buf), &buf_len, false, 42, lwmqtt_string("devices/bench/telemetry"), msg);
+}
+
+static lwmqtt_err_t decode_publish(params_t *params) {
+  bool dup;
+  uint16_t packet_id;
+  lwmqtt_string_t topic;
+  lwmqtt_message_t msg;
+  return lwmqtt_decode_publish(buf, buf_len, &dup, &packet_id, &topic, &msg);
+}
+
+static lwmqtt_err_t encode_ack(params_t *params) {
+  return lwmqtt_encode_ack(buf, sizeof(buf), &buf_len, params->packet_type, false, 42);
+}
+
+static lwmqtt_err_t decode_ack(params_t *params) {
+  bool dup;
+  uint16_t packet_id;
+  return lwmqtt_decode_ack(buf, buf_len, params->packet_type, &dup, &packet_id);
+}
+
+static lwmqtt_err_t encode_zero(params_t *params) {
+  return lwmqtt_encode_zero(buf, sizeof(buf), &buf_len, params->packet_type);
+}
+
+static lwmqtt_err_t encode_subscribe(params_t *params) {
+  return lwmqtt_encode_subscribe(buf, sizeof(buf), &buf_len, 42, params->count, topic_filters, qos_levels);
+}
+
+static lwmqtt_err_t encode_unsubscribe(params_t *params) {
+  return lwmqtt_encode_unsubscribe(buf, sizeof(buf), &buf_len, 42, params->count, topic_filters);
+}
+
+static lwmqtt_err_t decode_suback(params_t *params) {
+  uint16_t packet_id;
+  int count;
+  lwmqtt_qos_t granted_qos[MAX_FILTERS];
+  return lwmqtt_decode_suback(buf, buf_len, &packet_id, params->count, &count, granted_qos);
+}
+
+static lwmqtt_err_t detect_packet(params_t *params) {
+  lwmqtt_packet_type_t packet_type;
+  lwmqtt_err_t err = lwmqtt_detect_packet_type(buf, buf_len, &packet_type);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+  uint32_t rem_len;
+  return lwmqtt_detect_remaining_length(buf + 1, buf_len - 1, &rem_len);
+}
+
+static lwmqtt_err_t write_varnum(params_t *params) {
+  uint8_t *ptr = buf;
+  return lwmqtt_write_varnum(&ptr, buf + 4, params->varnum);
+}
+
+static lwmqtt_err_t read_varnum(params_t *params) {
+  uint8_t *ptr = buf;
+  uint32_t varnum;
+  return lwmqtt_read_varnum(&ptr, buf + 4, &varnum);
+}
+
+static void message_arrived(lwmqtt_client_t *c, void *ref, lwmqtt_string_t topic, lwmqtt_message_t msg) {}
+
+static lwmqtt_err_t drain_pipe() {
+  // read everything the client has written
+  size_t available = lwmqtt_pipe_available(&pipe.b);
+  size_t read = 0;
+  return lwmqtt_pipe_read(&pipe.b, buf, available, &read, 0);
+}
+
+static void connect_client() {
+  // prepare client
+  lwmqtt_pipe_init(&pipe, &pipe_clock, pipe_buf, sizeof(pipe_buf));
+  lwmqtt_pipe_timer_init(&timer1, &pipe_clock);
+  lwmqtt_pipe_timer_init(&timer2, &pipe_clock);
+  lwmqtt_init(&client, write_buf, sizeof(write_buf), read_buf, sizeof(read_buf));
+  lwmqtt_set_network(&client, &pipe.a, lwmqtt_pipe_read, lwmqtt_pipe_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_pipe_timer_set, lwmqtt_pipe_timer_get);
+  lwmqtt_set_callback(&client, NULL, message_arrived);
+
+  // queue connack and connect
+  size_t sent = 0;
+  lwmqtt_pipe_write(&pipe.b, (uint8_t[]){LWMQTT_CONNACK_PACKET << 4, 2, 0, 0}, 4, &sent, 0);
+  lwmqtt_return_code_t return_code;
+  lwmqtt_err_t err = lwmqtt_connect(&client, (lwmqtt_options_t)lwmqtt_default_options, NULL, &return_code, 1000);
+  if (err != LWMQTT_SUCCESS || drain_pipe() != LWMQTT_SUCCESS) {
+    fprintf(stderr, "client connect failed: %d\n", err);
+    exit(1);
+  }
+}
+
+static lwmqtt_err_t client_publish(params_t *params) {
+  // queue the acknowledgements for the next packet id
+  uint16_t packet_id = client.last_packet_id == 65535 ? 1 : client.last_packet_id + 1;
+  size_t sent = 0;
+  if (params->qos == LWMQTT_QOS1) {
+    lwmqtt_pipe_write(&pipe.b, (uint8_t[]){LWMQTT_PUBACK_PACKET << 4, 2, packet_id >> 8, packet_id & 0xFF}, 4, &sent,
+                      0);
+  } else if (params->qos == LWMQTT_QOS2) {
+    lwmqtt_pipe_write(&pipe.b, (uint8_t[]){LWMQTT_PUBREC_PACKET << 4, 2, packet_id >> 8, packet_id & 0xFF}, 4, &sent,
+                      0);
+    lwmqtt_pipe_write(&pipe.b, (uint8_t[]){LWMQTT_PUBCOMP_PACKET << 4, 2, packet_id >> 8, packet_id & 0xFF}, 4, &sent,
+                      0);
+  }
+
+  // publish message
+  lwmqtt_message_t msg = {params->qos, false, payload, params->payload_len};
+  lwmqtt_err_t err = lwmqtt_publish(&client, lwmqtt_string("devices/bench/telemetry"), msg, 1000);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  return drain_pipe();
+}
+
+static lwmqtt_err_t client_receive(params_t *params) {
+  // queue encoded message
+  size_t sent = 0;
+  lwmqtt_err_t err = lwmqtt_pipe_write(&pipe.b, packet, packet_len, &sent, 0);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // process message
+  err = lwmqtt_yield(&client, packet_len, 1000);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  return drain_pipe();
+}
+
+static void bench(const char *filter, const char *name, size_t bytes, bench_fn_t fn, params_t *params) {
+  // skip benchmarks that do not match the filter
+  if (filter != NULL && strstr(name, filter) == NULL) {
+    return;
+  }
+
+  // warm up and check for errors
+  lwmqtt_err_t err = fn(params);
+  if (err != LWMQTT_SUCCESS) {
+    fprintf(stderr, "%s failed: %d\n", name, err);
+    exit(1);
+  }
+
+  // double iterations until a measurement takes at least 100 ms
+  size_t iterations = 1;
+  double elapsed = 0;
+  size_t allocs = 0;
+  for (;;) {
+    size_t start_allocs = allocations;
+    double start = now();
+    for (size_t i = 0; i < iterations; i++) {
+      fn(params);
+    }
+    elapsed = now() - start;
+    allocs = allocations - start_allocs;
+    if (elapsed >= 0.1) {
+      break;
+    }
+    iterations *= 2;
+  }
+
+  // print result
+  double ns_op = elapsed * 1e9 / (double)iterations;
+  printf("{\"name\":\"%s\",\"iterations\":%zu,\"ns_op\":%.2f,\"bytes_s\":%.0f,\"allocs_op\":%.2f}\n", name, iterations,
+         ns_op, (double)bytes * 1e9 / ns_op, (double)allocs / (double)iterations);
+}
+
+int main(int argc, char **argv) {
+  // get optional name filter
+  const char *filter = argc > 1 ? argv[1] : NULL;
+
+  // prepare payload and filters
+  for (size_t i = 0; i < sizeof(payload); i++) {
+    payload[i] = (uint8_t)(i * 31);
+  }
+  for (int i = 0; i < MAX_FILTERS; i++) {
+    snprintf(filters[i], sizeof(filters[i]), "devices/%04d/+/telemetry", i);
+    topic_filters[i] = lwmqtt_string(filters[i]);
+    qos_levels[i] = (lwmqtt_qos_t)(i % 3);
+  }
+
+  char name[64];
+  params_t params = {0, 0, 0, LWMQTT_NO_PACKET, LWMQTT_QOS0};
+
+  // connect and connack
+  encode_connect(&params);
+  bench(filter, "connect/encode", buf_len, encode_connect, &params);
+  buf_len = 4;
+  memcpy(buf, (uint8_t[]){LWMQTT_CONNACK_PACKET << 4, 2, 0, 0}, 4);
+  bench(filter, "connack/decode", buf_len, decode_connack, &params);
+
+  // publish at increasing payload sizes
+  size_t payload_lens[] = {0, 16, 256, 4096, 65536, MAX_PAYLOAD};
+  for (size_t i = 0; i < sizeof(payload_lens) / sizeof(payload_lens[0]); i++) {
+    params.payload_len = payload_lens[i];
+    encode_publish(&params);
+    snprintf(name, sizeof(name), "publish/encode/%zu", params.payload_len);
+    bench(filter, name, buf_len, encode_publish, &params);
+    snprintf(name, sizeof(name), "publish/decode/%zu", params.payload_len);
+    bench(filter, name, buf_len, decode_publish, &params);
+    snprintf(name, sizeof(name), "detect/%zu", params.payload_len);
+    bench(filter, name, buf_len, detect_packet, &params);
+  }
+
+  // acks and zero length packets
+  lwmqtt_packet_type_t acks[] = {LWMQTT_PUBACK_PACKET, LWMQTT_PUBREC_PACKET, LWMQTT_PUBREL_PACKET,
+                                 LWMQTT_PUBCOMP_PACKET, LWMQTT_UNSUBACK_PACKET};
+  const char *ack_names[] = {"puback", "pubrec", "pubrel", "pubcomp", "unsuback"};
+  for (size_t i = 0; i < sizeof(acks) / sizeof(acks[0]); i++) {
+    params.packet_type = acks[i];
+    snprintf(name, sizeof(name), "%s/encode", ack_names[i]);
+    bench(filter, name, 4, encode_ack, &params);
+    snprintf(name, sizeof(name), "%s/decode", ack_names[i]);
+    bench(filter, name, 4, decode_ack, &params);
+  }
+  params.packet_type = LWMQTT_PINGREQ_PACKET;
+  bench(filter, "pingreq/encode", 2, encode_zero, &params);
+
+  // subscribe, unsubscribe and suback with increasing filter counts
+  int counts[] = {1, 10, 100, 1000};
+  for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+    params.count = counts[i];
+    encode_subscribe(&params);
+    snprintf(name, sizeof(name), "subscribe/encode/%d", params.count);
+    bench(filter, name, buf_len, encode_subscribe, &params);
+    encode_unsubscribe(&params);
+    snprintf(name, sizeof(name), "unsubscribe/encode/%d", params.count);
+    bench(filter, name, buf_len, encode_unsubscribe, &params);
+
+    // prepare suback
+    uint8_t *ptr = buf;
+    lwmqtt_write_byte(&ptr, buf + sizeof(buf), LWMQTT_SUBACK_PACKET << 4);
+    lwmqtt_write_varnum(&ptr, buf + sizeof(buf), 2 + (uint32_t)params.count);
+    lwmqtt_write_num(&ptr, buf + sizeof(buf), 42);
+    for (int j = 0; j < params.count; j++) {
+      lwmqtt_write_byte(&ptr, buf + sizeof(buf), (uint8_t)qos_levels[j]);
+    }
+    buf_len = (size_t)(ptr - buf);
+    snprintf(name, sizeof(name), "suback/decode/%d", params.count);
+    bench(filter, name, buf_len, decode_suback, &params);
+  }
+
+  // variable numbers of all lengths
+  uint32_t varnums[] = {127, 16383, 2097151, 268435455};
+  for (size_t i = 0; i < sizeof(varnums) / sizeof(varnums[0]); i++) {
+    params.varnum = varnums[i];
+    write_varnum(&params);
+    snprintf(name, sizeof(name), "varnum/write/%zu", i + 1);
+    bench(filter, name, i + 1, write_varnum, &params);
+    snprintf(name, sizeof(name), "varnum/read/%zu", i + 1);
+    bench(filter, name, i + 1, read_varnum, &params);
+  }
+
+  // client publish and receive over an in-memory pipe
+  connect_client();
+  size_t client_payload_lens[] = {16, 256, MAX_CLIENT_PAYLOAD};
+  for (size_t i = 0; i < sizeof(client_payload_lens) / sizeof(client_payload_lens[0]); i++) {
+    params.payload_len = client_payload_lens[i];
+    for (int qos = 0; qos <= 2; qos++) {
+      params.qos = (lwmqtt_qos_t)qos;
+      snprintf(name, sizeof(name), "client/publish/qos%d/%zu", qos, params.payload_len);
+      bench(filter, name, params.payload_len, client_publish, &params);
+    }
+    for (int qos = 0; qos <= 1; qos++) {
+      lwmqtt_message_t msg = {(lwmqtt_qos_t)qos, false, payload, params.payload_len};
+      lwmqtt_encode_publish(packet, sizeof(packet), &packet_len, false, 42, lwmqtt_string("devices/bench/telemetry"),
+                            msg);
+      snprintf(name, sizeof(name), "client/receive/qos%d/%zu", qos, params.payload_len);
+      bench(filter, name, params.payload_len, client_receive, &params);
+    }
+  }
+
+  return 0;
+}
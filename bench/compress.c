@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <lwmqtt/lz.h>
+
+#define MAX_PAYLOAD 65536
+
+static lwmqtt_lz_state_t state;
+
+static uint8_t payload[MAX_PAYLOAD];
+static uint8_t compressed[MAX_PAYLOAD + 64];
+static uint8_t decompressed[MAX_PAYLOAD];
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void telemetry(uint8_t *buf, size_t size) {
+  // fill buffer with json sensor readings with varying values
+  uint32_t seed = 1;
+  size_t len = 0;
+  for (unsigned i = 0; len < size; i++) {
+    seed = seed * 1103515245 + 12345;
+    char reading[192];
+    int n = snprintf(reading, sizeof(reading),
+                     "{\"device\":\"sensor-%04u\",\"ts\":%u,\"temperature\":%u.%02u,\"humidity\":%u.%u,"
+                     "\"battery\":%u,\"status\":\"%s\"}\n",
+                     (seed >> 8) % 1000, 1700000000u + i * 7, 15 + (seed >> 4) % 15, (seed >> 12) % 100,
+                     30 + (seed >> 16) % 50, (seed >> 20) % 10, 50 + (seed >> 24) % 50,
+                     (seed >> 28) % 8 == 0 ? "degraded" : "ok");
+    size_t copy = size - len < (size_t)n ? size - len : (size_t)n;
+    memcpy(buf + len, reading, copy);
+    len += copy;
+  }
+}
+
+static void bench(const char *name, size_t len) {
+  // calibrate iterations to roughly 100 MB per measurement
+  size_t iterations = 1 + (size_t)(100e6 / (double)len);
+
+  // measure compression
+  size_t compressed_len = 0;
+  bool transformed = false;
+  double start = now();
+  for (size_t i = 0; i < iterations; i++) {
+    lwmqtt_err_t err =
+        lwmqtt_lz_compress(&state, payload, len, compressed, sizeof(compressed), &compressed_len, &transformed);
+    if (err != LWMQTT_SUCCESS) {
+      fprintf(stderr, "compress failed: %d\n", err);
+      exit(1);
+    }
+  }
+  double compress_time = now() - start;
+
+  // use raw payload if not compressible
+  if (!transformed) {
+    compressed_len = len;
+    memcpy(compressed, payload, len);
+  }
+
+  // measure decompression
+  size_t decompressed_len = 0;
+  start = now();
+  for (size_t i = 0; i < iterations; i++) {
+    lwmqtt_err_t err = lwmqtt_lz_decompress(NULL, compressed, compressed_len, decompressed, sizeof(decompressed),
+                                            &decompressed_len, &transformed);
+    if (err != LWMQTT_SUCCESS) {
+      fprintf(stderr, "decompress failed: %d\n", err);
+      exit(1);
+    }
+  }
+  double decompress_time = now() - start;
+
+  // verify round trip
+  if (transformed && (decompressed_len != len || memcmp(decompressed, payload, len) != 0)) {
+    fprintf(stderr, "round trip mismatch\n");
+    exit(1);
+  }
+
+  // print result
+  printf(
+      "{\"name\":\"%s\",\"bytes\":%zu,\"compressed\":%zu,\"ratio\":%.3f,\"compress_mb_s\":%.1f,"
+      "\"decompress_mb_s\":%.1f}\n",
+      name, len, compressed_len, (double)len / (double)compressed_len,
+      (double)len * (double)iterations / compress_time / 1e6, (double)len * (double)iterations / decompress_time / 1e6);
+}
+
+int main() {
+  // prepare payload
+  telemetry(payload, sizeof(payload));
+
+  bench("lz/json-64", 64);
+  bench("lz/json-256", 256);
+  bench("lz/json-1k", 1024);
+  bench("lz/json-4k", 4096);
+  bench("lz/json-16k", 16384);
+  bench("lz/json-64k", 65536);
+
+  return 0;
+}
@@ -0,0 +1,225 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <lwmqtt.h>
+#include <lwmqtt/latency.h>
+#include <lwmqtt/unix.h>
+
+#include "../tests/broker.h"
+
+#define MAX_PAYLOAD 65536
+#define BUF_SIZE (MAX_PAYLOAD + 256)
+#define MAX_INFLIGHT 16
+#define TIMEOUT 5000
+#define SPIN 1000
+#define ZEROCOPY 16384
+
+typedef struct {
+  const char *transport;
+  lwmqtt_qos_t qos;
+  size_t payload_len;
+  int inflight;
+} config_t;
+
+typedef struct {
+  lwmqtt_unix_network_t network;
+  lwmqtt_unix_timer_t timer1, timer2;
+  lwmqtt_client_t client;
+  uint8_t write_buf[BUF_SIZE], read_buf[BUF_SIZE];
+} endpoint_t;
+
+static endpoint_t publisher, subscriber;
+
+static uint8_t payloads[MAX_INFLIGHT][MAX_PAYLOAD];
+
+static lwmqtt_histogram_t histogram;
+static atomic_size_t received;
+static atomic_bool stopped;
+
+static void message_arrived(lwmqtt_client_t *client, void *ref, lwmqtt_string_t topic, lwmqtt_message_t msg) {
+  // read embedded timestamp
+  uint64_t sent;
+  memcpy(&sent, msg.payload, sizeof(sent));
+
+  // record latency
+  uint64_t latency = lwmqtt_unix_clock_get(NULL) - sent;
+  lwmqtt_histogram_record(&histogram, latency > UINT32_MAX ? UINT32_MAX : (uint32_t)latency);
+
+  atomic_fetch_add(&received, 1);
+}
+
+static void check(lwmqtt_err_t err, const char *what) {
+  if (err != LWMQTT_SUCCESS) {
+    fprintf(stderr, "%s failed: %d\n", what, err);
+    exit(1);
+  }
+}
+
+static void connect_endpoint(endpoint_t *endpoint, const char *host, int port, uint32_t spin, size_t zerocopy,
+                             const char *client_id) {
+  // prepare client
+  lwmqtt_init(&endpoint->client, endpoint->write_buf, BUF_SIZE, endpoint->read_buf, BUF_SIZE);
+  lwmqtt_set_network(&endpoint->client, &endpoint->network, lwmqtt_unix_network_read, lwmqtt_unix_network_write);
+  lwmqtt_set_timers(&endpoint->client, &endpoint->timer1, &endpoint->timer2, lwmqtt_unix_timer_set,
+                    lwmqtt_unix_timer_get);
+
+  // connect network
+  lwmqtt_unix_options_t network_options = lwmqtt_unix_default_options;
+  network_options.spin = spin;
+  network_options.zerocopy = zerocopy;
+  lwmqtt_set_direct_payload(&endpoint->client, zerocopy, lwmqtt_unix_network_write_direct);
+  check(lwmqtt_unix_network_connect_options(&endpoint->network, (char *)host, port, TIMEOUT, &network_options),
+        "network connect");
+
+  // connect client
+  lwmqtt_options_t options = lwmqtt_default_options;
+  options.client_id = lwmqtt_string(client_id);
+  lwmqtt_return_code_t return_code;
+  check(lwmqtt_connect(&endpoint->client, options, NULL, &return_code, TIMEOUT), "connect");
+}
+
+static void *subscribe_loop(void *ref) {
+  // process incoming messages until stopped
+  while (!atomic_load(&stopped)) {
+    check(lwmqtt_yield(&subscriber.client, 0, 100), "yield");
+  }
+
+  return NULL;
+}
+
+static void run(config_t config, double duration, const char *filter) {
+  // prepare name
+  char name[64];
+  snprintf(name, sizeof(name), "%s/qos%d/%zu/inflight%d", config.transport, config.qos, config.payload_len,
+           config.inflight);
+
+  // skip benchmarks that do not match the filter
+  if (filter != NULL && strstr(name, filter) == NULL) {
+    return;
+  }
+
+  // prepare socket path for the local transport
+  char path[64];
+  char host[sizeof(path) + sizeof(LWMQTT_UNIX_LOCAL_PREFIX)];
+  bool local = strcmp(config.transport, "unix") == 0;
+  snprintf(path, sizeof(path), "/tmp/lwmqtt-e2e-%d.sock", (int)getpid());
+  snprintf(host, sizeof(host), "%s%s", LWMQTT_UNIX_LOCAL_PREFIX, path);
+
+  // start broker and connect clients
+  mock_broker_options_t options = mock_broker_default_options;
+  options.path = local ? path : NULL;
+  mock_broker_t *broker = mock_broker_start(options);
+  if (broker == NULL) {
+    fprintf(stderr, "broker failed\n");
+    exit(1);
+  }
+  uint32_t spin = strcmp(config.transport, "spin") == 0 ? SPIN : 0;
+  size_t zerocopy = strcmp(config.transport, "zerocopy") == 0 ? ZEROCOPY : 0;
+  connect_endpoint(&publisher, local ? host : "127.0.0.1", mock_broker_port(broker), spin, zerocopy, "publisher");
+  connect_endpoint(&subscriber, local ? host : "127.0.0.1", mock_broker_port(broker), spin, 0, "subscriber");
+  lwmqtt_set_callback(&subscriber.client, NULL, message_arrived);
+  check(lwmqtt_subscribe_one(&subscriber.client, lwmqtt_string("bench"), LWMQTT_QOS2, TIMEOUT), "subscribe");
+
+  // reset state and start subscriber
+  lwmqtt_histogram_reset(&histogram);
+  atomic_store(&received, 0);
+  atomic_store(&stopped, false);
+  pthread_t thread;
+  pthread_create(&thread, NULL, subscribe_loop, NULL);
+
+  // prepare messages
+  lwmqtt_string_t topics[MAX_INFLIGHT];
+  lwmqtt_message_t messages[MAX_INFLIGHT];
+  lwmqtt_err_t results[MAX_INFLIGHT];
+  for (int i = 0; i < config.inflight; i++) {
+    topics[i] = lwmqtt_string("bench");
+    messages[i] = (lwmqtt_message_t){config.qos, false, payloads[i], config.payload_len};
+  }
+
+  // publish until the duration has elapsed
+  size_t sent = 0;
+  uint64_t start = lwmqtt_unix_clock_get(NULL);
+  uint64_t end = start + (uint64_t)(duration * 1e6);
+  while (lwmqtt_unix_clock_get(NULL) < end) {
+    // wait until the kernel has released the payloads
+    if (zerocopy > 0) {
+      check(lwmqtt_unix_network_await_zerocopy(&publisher.network, TIMEOUT), "zerocopy");
+    }
+
+    // embed timestamps
+    uint64_t now = lwmqtt_unix_clock_get(NULL);
+    for (int i = 0; i < config.inflight; i++) {
+      memcpy(payloads[i], &now, sizeof(now));
+    }
+
+    // publish messages
+    if (config.inflight == 1) {
+      check(lwmqtt_publish(&publisher.client, topics[0], messages[0], TIMEOUT), "publish");
+    } else {
+      check(lwmqtt_publish_batch(&publisher.client, config.inflight, topics, messages, results, TIMEOUT), "batch");
+    }
+    sent += (size_t)config.inflight;
+
+    // process incoming packets of the publisher
+    check(lwmqtt_yield(&publisher.client, 0, 0), "yield");
+
+    // wait for the echoes, so that the latencies are round trips and not queueing delays of unacknowledged messages
+    uint64_t timeout = lwmqtt_unix_clock_get(NULL) + TIMEOUT * 1000;
+    while (atomic_load(&received) < sent && lwmqtt_unix_clock_get(NULL) < timeout) {
+      sched_yield();
+    }
+  }
+
+  // wait until all messages have been received
+  uint64_t deadline = lwmqtt_unix_clock_get(NULL) + TIMEOUT * 1000;
+  while (atomic_load(&received) < sent && lwmqtt_unix_clock_get(NULL) < deadline) {
+    struct timespec ts = {0, 100000};
+    nanosleep(&ts, NULL);
+  }
+  double elapsed = (double)(lwmqtt_unix_clock_get(NULL) - start) / 1e6;
+
+  // stop subscriber and broker
+  atomic_store(&stopped, true);
+  pthread_join(thread, NULL);
+  lwmqtt_unix_network_disconnect(&publisher.network);
+  lwmqtt_unix_network_disconnect(&subscriber.network);
+  mock_broker_stop(broker);
+
+  // print result
+  size_t count = atomic_load(&received);
+  printf(
+      "{\"name\":\"%s\",\"sent\":%zu,\"received\":%zu,\"msg_s\":%.0f,\"mb_s\":%.2f,\"p50_us\":%u,\"p99_us\":%u,"
+      "\"p999_us\":%u}\n",
+      name, sent, count, (double)count / elapsed, (double)(count * config.payload_len) / elapsed / 1e6,
+      lwmqtt_histogram_percentile(&histogram, 50), lwmqtt_histogram_percentile(&histogram, 99),
+      lwmqtt_histogram_percentile(&histogram, 99.9));
+  fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+  // get optional duration and name filter
+  double duration = argc > 1 ? atof(argv[1]) : 1;
+  const char *filter = argc > 2 ? argv[2] : NULL;
+
+  // run matrix
+  const char *transports[] = {"tcp", "unix", "spin", "zerocopy"};
+  lwmqtt_qos_t levels[] = {LWMQTT_QOS0, LWMQTT_QOS1, LWMQTT_QOS2};
+  size_t payload_lens[] = {16, 256, 4096, MAX_PAYLOAD};
+  int inflights[] = {1, MAX_INFLIGHT};
+  for (size_t t = 0; t < sizeof(transports) / sizeof(transports[0]); t++) {
+    for (size_t q = 0; q < sizeof(levels) / sizeof(levels[0]); q++) {
+      for (size_t p = 0; p < sizeof(payload_lens) / sizeof(payload_lens[0]); p++) {
+        for (size_t i = 0; i < sizeof(inflights) / sizeof(inflights[0]); i++) {
+          run((config_t){transports[t], levels[q], payload_lens[p], inflights[i]}, duration, filter);
+        }
+      }
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,416 @@
+#include <math.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <lwmqtt.h>
+#include <lwmqtt/latency.h>
+#include <lwmqtt/unix.h>
+
+#include "../tests/broker.h"
+
+#define TIMEOUT 5000
+
+typedef struct {
+  lwmqtt_client_t client;
+  lwmqtt_unix_network_t network;
+  lwmqtt_unix_timer_t timer1, timer2;
+  char id[24];
+  bool connected;
+  uint64_t next_publish;
+  uint64_t next_keep_alive;
+  uint64_t next_reconnect;
+} device_t;
+
+typedef struct {
+  char *host;
+  int port;
+  int devices;
+  double duration;
+  uint32_t interval;
+  size_t payload_len;
+  lwmqtt_qos_t qos;
+  int subscriptions;
+  double churn;
+  uint16_t keep_alive;
+  size_t buf_size;
+} config_t;
+
+static config_t config = {NULL, 1883, 1000, 10, 1000, 64, LWMQTT_QOS0, 1, 0, 60, 512};
+
+static device_t *devices;
+static uint8_t *buffers;
+static struct pollfd *fds;
+static uint8_t *payload;
+
+static lwmqtt_unix_resolver_entry_t resolver_entries[1];
+static lwmqtt_unix_resolver_t resolver;
+
+static lwmqtt_stats_t stats;
+static lwmqtt_histogram_t connect_latency;
+static uint64_t published, received, connects, failures;
+
+static uint64_t random_state = 88172645463325252ull;
+
+static uint64_t random_next() {
+  // xorshift64
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 7;
+  random_state ^= random_state << 17;
+  return random_state;
+}
+
+static uint64_t random_delay(uint64_t mean) {
+  // pick an exponentially distributed delay around the mean
+  double u = (double)(random_next() >> 11) / (double)(1ull << 53);
+  return (uint64_t)(-log1p(-u) * (double)mean);
+}
+
+static void message_arrived(lwmqtt_client_t *client, void *ref, lwmqtt_string_t topic, lwmqtt_message_t msg) {
+  received++;
+}
+
+static void device_disconnect(device_t *device) {
+  // close connection
+  lwmqtt_unix_network_disconnect(&device->network);
+  device->connected = false;
+}
+
+static void device_fail(device_t *device, uint64_t now) {
+  // close connection and retry immediately
+  failures++;
+  device_disconnect(device);
+  device->next_reconnect = now;
+}
+
+static lwmqtt_err_t device_connect(device_t *device, uint64_t now) {
+  // connect network with the shared resolver cache
+  lwmqtt_unix_options_t network_options = lwmqtt_unix_default_options;
+  network_options.resolver = &resolver;
+  lwmqtt_err_t err =
+      lwmqtt_unix_network_connect_options(&device->network, config.host, config.port, TIMEOUT, &network_options);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // connect client
+  lwmqtt_options_t options = lwmqtt_default_options;
+  options.client_id = lwmqtt_string(device->id);
+  options.keep_alive = config.keep_alive;
+  lwmqtt_return_code_t return_code;
+  err = lwmqtt_connect(&device->client, options, NULL, &return_code, TIMEOUT);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // subscribe to own topics
+  for (int i = 0; i < config.subscriptions; i++) {
+    char topic[64];
+    snprintf(topic, sizeof(topic), "fleet/%s/%d", device->id, i);
+    err = lwmqtt_subscribe_one(&device->client, lwmqtt_string(topic), config.qos, TIMEOUT);
+    if (err != LWMQTT_SUCCESS) {
+      return err;
+    }
+  }
+
+  // record connect
+  uint64_t end = lwmqtt_unix_clock_get(NULL);
+  lwmqtt_histogram_record(&connect_latency, (uint32_t)(end - now));
+  connects++;
+
+  // schedule next events
+  device->connected = true;
+  device->next_publish = end + random_next() % ((uint64_t)config.interval * 1000 + 1);
+  device->next_keep_alive = end + 1000000;
+  device->next_reconnect = config.churn > 0 ? end + random_delay((uint64_t)(config.churn * 1e6)) : UINT64_MAX;
+
+  return LWMQTT_SUCCESS;
+}
+
+static lwmqtt_err_t device_publish(device_t *device) {
+  // pick a random subscribed topic or a telemetry topic
+  char topic[64];
+  if (config.subscriptions > 0) {
+    device_t *target = &devices[random_next() % (uint64_t)config.devices];
+    snprintf(topic, sizeof(topic), "fleet/%s/%d", target->id, (int)(random_next() % (uint64_t)config.subscriptions));
+  } else {
+    snprintf(topic, sizeof(topic), "fleet/%s/telemetry", device->id);
+  }
+
+  // publish message
+  lwmqtt_message_t msg = {config.qos, false, payload, config.payload_len};
+  lwmqtt_err_t err = lwmqtt_publish(&device->client, lwmqtt_string(topic), msg, TIMEOUT);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  published++;
+
+  return LWMQTT_SUCCESS;
+}
+
+static double cpu_time() {
+  // get user and system time
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (double)usage.ru_utime.tv_sec + (double)usage.ru_utime.tv_usec / 1e6 + (double)usage.ru_stime.tv_sec +
+         (double)usage.ru_stime.tv_usec / 1e6;
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [-H host] [-P port] [-n devices] [-d duration] [-i interval] [-s payload] [-q qos]\n"
+          "          [-S subscriptions] [-c churn] [-k keep-alive] [-b buffer]\n"
+          "\n"
+          "  -H  broker host, an in-process mock broker is started if omitted\n"
+          "  -P  broker port (1883)\n"
+          "  -n  number of devices (1000)\n"
+          "  -d  duration of the run phase in seconds (10)\n"
+          "  -i  publish interval per device in milliseconds (1000)\n"
+          "  -s  payload size in bytes (64)\n"
+          "  -q  publish and subscribe QOS level (0)\n"
+          "  -S  subscriptions per device, publishes go to random subscribed topics (1)\n"
+          "  -c  mean connection lifetime per device in seconds, 0 disables churn (0)\n"
+          "  -k  keep alive interval in seconds (60)\n"
+          "  -b  read and write buffer size per device (512)\n"
+          "\n"
+          "The resident memory per client includes the mock broker if it runs in-process.\n",
+          name);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  // parse options
+  int opt;
+  while ((opt = getopt(argc, argv, "H:P:n:d:i:s:q:S:c:k:b:")) != -1) {
+    switch (opt) {
+      case 'H':
+        config.host = optarg;
+        break;
+      case 'P':
+        config.port = atoi(optarg);
+        break;
+      case 'n':
+        config.devices = atoi(optarg);
+        break;
+      case 'd':
+        config.duration = atof(optarg);
+        break;
+      case 'i':
+        config.interval = (uint32_t)atoi(optarg);
+        break;
+      case 's':
+        config.payload_len = (size_t)atoi(optarg);
+        break;
+      case 'q':
+        config.qos = (lwmqtt_qos_t)atoi(optarg);
+        break;
+      case 'S':
+        config.subscriptions = atoi(optarg);
+        break;
+      case 'c':
+        config.churn = atof(optarg);
+        break;
+      case 'k':
+        config.keep_alive = (uint16_t)atoi(optarg);
+        break;
+      case 'b':
+        config.buf_size = (size_t)atoi(optarg);
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+
+  // check options
+  if (config.devices <= 0 || config.qos > LWMQTT_QOS2 || config.buf_size < config.payload_len + 64) {
+    usage(argv[0]);
+  }
+
+  // raise file descriptor limit
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  // start mock broker if no host is given
+  mock_broker_t *broker = NULL;
+  if (config.host == NULL) {
+    broker = mock_broker_start((mock_broker_options_t)mock_broker_default_options);
+    if (broker == NULL) {
+      fprintf(stderr, "failed to start broker\n");
+      return 1;
+    }
+    config.host = "127.0.0.1";
+    config.port = mock_broker_port(broker);
+  }
+
+  // allocate devices
+  size_t n = (size_t)config.devices;
+  devices = calloc(n, sizeof(device_t));
+  buffers = malloc(n * config.buf_size * 2);
+  fds = calloc(n, sizeof(struct pollfd));
+  payload = calloc(1, config.payload_len + 1);
+  if (devices == NULL || buffers == NULL || fds == NULL || payload == NULL) {
+    fprintf(stderr, "failed to allocate devices\n");
+    return 1;
+  }
+
+  // share one resolved address set between all devices
+  lwmqtt_unix_resolver_init(&resolver, resolver_entries, 1, 30000);
+
+  // prepare devices
+  for (size_t i = 0; i < n; i++) {
+    device_t *device = &devices[i];
+    uint8_t *buf = buffers + i * config.buf_size * 2;
+    snprintf(device->id, sizeof(device->id), "dev%zu", i);
+    lwmqtt_init(&device->client, buf, config.buf_size, buf + config.buf_size, config.buf_size);
+    lwmqtt_set_network(&device->client, &device->network, lwmqtt_unix_network_read, lwmqtt_unix_network_write);
+    lwmqtt_set_timers(&device->client, &device->timer1, &device->timer2, lwmqtt_unix_timer_set,
+                      lwmqtt_unix_timer_get);
+    lwmqtt_set_callback(&device->client, NULL, message_arrived);
+    lwmqtt_set_stats(&device->client, &stats);
+  }
+
+  // connect all devices
+  lwmqtt_histogram_reset(&connect_latency);
+  uint64_t ramp_start = lwmqtt_unix_clock_get(NULL);
+  for (size_t i = 0; i < n; i++) {
+    lwmqtt_err_t err = device_connect(&devices[i], lwmqtt_unix_clock_get(NULL));
+    if (err != LWMQTT_SUCCESS) {
+      fprintf(stderr, "failed to connect device %zu: %d\n", i, err);
+      return 1;
+    }
+  }
+  double ramp = (double)(lwmqtt_unix_clock_get(NULL) - ramp_start) / 1e6;
+
+  // reset counters
+  lwmqtt_stats_t start_stats;
+  lwmqtt_stats_snapshot(&stats, &start_stats);
+  uint64_t start_connects = connects;
+  double start_cpu = cpu_time();
+
+  // run schedule
+  uint64_t start = lwmqtt_unix_clock_get(NULL);
+  uint64_t end = start + (uint64_t)(config.duration * 1e6);
+  uint64_t now = start;
+  while (now < end) {
+    // wait for incoming data
+    for (size_t i = 0; i < n; i++) {
+      fds[i].fd = devices[i].connected ? devices[i].network.socket : -1;
+      fds[i].events = POLLIN;
+    }
+    if (poll(fds, n, 1) < 0) {
+      perror("poll");
+      return 1;
+    }
+    now = lwmqtt_unix_clock_get(NULL);
+
+    // process incoming data
+    for (size_t i = 0; i < n; i++) {
+      device_t *device = &devices[i];
+      if (!device->connected || fds[i].revents == 0) {
+        continue;
+      }
+
+      // handle closed connections
+      size_t available = 0;
+      if (lwmqtt_unix_network_peek(&device->network, &available) != LWMQTT_SUCCESS || available == 0) {
+        device_fail(device, now);
+        continue;
+      }
+
+      // process packets
+      if (lwmqtt_yield(&device->client, available, TIMEOUT) != LWMQTT_SUCCESS) {
+        device_fail(device, now);
+      }
+    }
+
+    // run due events
+    for (size_t i = 0; i < n; i++) {
+      device_t *device = &devices[i];
+
+      // reconnect device
+      if (now >= device->next_reconnect) {
+        if (device->connected) {
+          lwmqtt_disconnect(&device->client, TIMEOUT);
+          device_disconnect(device);
+        }
+        if (device_connect(device, now) != LWMQTT_SUCCESS) {
+          device_fail(device, now);
+        }
+        continue;
+      }
+
+      // publish message and skip missed slots
+      if (device->connected && now >= device->next_publish) {
+        if (device_publish(device) != LWMQTT_SUCCESS) {
+          device_fail(device, now);
+          continue;
+        }
+        device->next_publish += (uint64_t)config.interval * 1000;
+        if (device->next_publish < now) {
+          device->next_publish = now + (uint64_t)config.interval * 1000;
+        }
+      }
+
+      // keep connection alive
+      if (device->connected && now >= device->next_keep_alive) {
+        if (lwmqtt_keep_alive(&device->client, TIMEOUT) != LWMQTT_SUCCESS) {
+          device_fail(device, now);
+          continue;
+        }
+        device->next_keep_alive = now + 1000000;
+      }
+    }
+  }
+
+  // get results
+  double elapsed = (double)(lwmqtt_unix_clock_get(NULL) - start) / 1e6;
+  double cpu = cpu_time() - start_cpu;
+  lwmqtt_stats_t end_stats;
+  lwmqtt_stats_snapshot(&stats, &end_stats);
+  struct rusage resources;
+  getrusage(RUSAGE_SELF, &resources);
+
+  // print report
+  printf(
+      "{\"devices\":%d,\"ramp_s\":%.3f,\"connect_s\":%.0f,\"connect_p50_us\":%u,\"connect_p99_us\":%u,"
+      "\"reconnects\":%llu,\"failures\":%llu,\"published\":%llu,\"received\":%llu,\"pub_msg_s\":%.0f,"
+      "\"recv_msg_s\":%.0f,\"mb_s_out\":%.2f,\"mb_s_in\":%.2f,\"client_bytes\":%zu,\"rss_bytes_client\":%.0f,"
+      "\"cpu_us_msg\":%.2f}\n",
+      config.devices, ramp, (double)n / ramp, lwmqtt_histogram_percentile(&connect_latency, 50),
+      lwmqtt_histogram_percentile(&connect_latency, 99), (unsigned long long)(connects - start_connects),
+      (unsigned long long)failures, (unsigned long long)published, (unsigned long long)received,
+      (double)published / elapsed, (double)received / elapsed,
+      (double)(end_stats.bytes_out - start_stats.bytes_out) / elapsed / 1e6,
+      (double)(end_stats.bytes_in - start_stats.bytes_in) / elapsed / 1e6, sizeof(device_t) + config.buf_size * 2,
+      (double)resources.ru_maxrss * 1024 / (double)n,
+      published + received > 0 ? cpu * 1e6 / (double)(published + received) : 0);
+
+  // disconnect devices
+  for (size_t i = 0; i < n; i++) {
+    if (devices[i].connected) {
+      lwmqtt_disconnect(&devices[i].client, TIMEOUT);
+      device_disconnect(&devices[i]);
+    }
+  }
+
+  // stop broker
+  if (broker != NULL) {
+    mock_broker_stop(broker);
+  }
+
+  // free resolver and devices
+  lwmqtt_unix_resolver_destroy(&resolver);
+  free(devices);
+  free(buffers);
+  free(fds);
+  free(payload);
+
+  return 0;
+}
@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <lwmqtt.h>
+#include <lwmqtt/capture.h>
+#include <lwmqtt/unix.h>
+
+#define BUF_SIZE (1024 * 1024)
+
+static uint8_t write_buf[BUF_SIZE], read_buf[BUF_SIZE];
+
+static size_t messages = 0;
+
+static void message_arrived(lwmqtt_client_t *client, void *ref, lwmqtt_string_t topic, lwmqtt_message_t msg) {
+  messages++;
+}
+
+int main(int argc, char **argv) {
+  // check arguments
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <capture> [paced]\n", argv[0]);
+    return 1;
+  }
+
+  // map capture
+  lwmqtt_replay_t replay;
+  lwmqtt_err_t err = lwmqtt_replay_open(&replay, argv[1], argc > 2 && strcmp(argv[2], "paced") == 0);
+  if (err != LWMQTT_SUCCESS) {
+    fprintf(stderr, "failed to open capture: %d\n", err);
+    return 1;
+  }
+
+  // prepare client
+  lwmqtt_unix_timer_t timer1, timer2;
+  lwmqtt_client_t client;
+  lwmqtt_init(&client, write_buf, BUF_SIZE, read_buf, BUF_SIZE);
+  lwmqtt_set_network(&client, &replay, lwmqtt_replay_read, lwmqtt_replay_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get);
+  lwmqtt_set_callback(&client, NULL, message_arrived);
+
+  // feed all incoming data to the client
+  uint64_t start = lwmqtt_unix_clock_get(NULL);
+  while (!lwmqtt_replay_done(&replay)) {
+    err = lwmqtt_yield(&client, lwmqtt_replay_available(&replay), 1000);
+    if (err != LWMQTT_SUCCESS) {
+      fprintf(stderr, "replay failed at byte %zu: %d\n", replay.bytes_in, err);
+      return 1;
+    }
+  }
+  double elapsed = (double)(lwmqtt_unix_clock_get(NULL) - start) / 1e6;
+
+  // print result
+  printf("{\"bytes_in\":%zu,\"bytes_out\":%zu,\"messages\":%zu,\"seconds\":%.6f,\"msg_s\":%.0f,\"mb_s\":%.2f}\n",
+         replay.bytes_in, replay.bytes_out, messages, elapsed, (double)messages / elapsed,
+         (double)replay.bytes_in / elapsed / 1e6);
+
+  // unmap capture
+  lwmqtt_replay_close(&replay);
+
+  return 0;
+}
@@ -10,7 +10,9 @@
  *
  * If a function returns an error that operates on a connected client (e.g publish, keep_alive, etc.) the caller should
  * switch into a disconnected state, close and cleanup the current connection and start over by creating a new
- * connection.
+ * connection. The exceptions are LWMQTT_WOULD_BLOCK which signals that a packet has been accepted but could not be
+ * written completely without waiting, and LWMQTT_BUSY which signals that a command has been rejected without sending
+ * its packet because an earlier write is still pending, see lwmqtt_flush().
  */
 typedef enum {
   LWMQTT_SUCCESS = 0,
@@ -27,6 +29,9 @@ typedef enum {
   LWMQTT_FAILED_SUBSCRIPTION = -11,
   LWMQTT_SUBACK_ARRAY_OVERFLOW = -12,
   LWMQTT_PONG_TIMEOUT = -13,
+  LWMQTT_MALFORMED_PAYLOAD = -14,
+  LWMQTT_WOULD_BLOCK = -15,
+  LWMQTT_BUSY = -16,
 } lwmqtt_err_t;
 
 /**
@@ -104,7 +109,9 @@ typedef lwmqtt_err_t (*lwmqtt_network_read_t)(void *ref, uint8_t *buf, size_t le
  * The callback used to write to a network object.
  *
  * The callback is expected to write up to the amount of bytes from the passed buffer. It should wait up to the
- * specified timeout to write the specified data to the network.
+ * specified timeout to write the specified data to the network. Callbacks of non-blocking networks may return
+ * LWMQTT_WOULD_BLOCK after adding the amount of already written bytes to the counter if no more data can be written
+ * without waiting.
  *
  * @param ref - A custom reference.
  * @param buf - The buffer.
@@ -130,6 +137,28 @@ typedef void (*lwmqtt_timer_set_t)(void *ref, uint32_t timeout);
  */
 typedef int32_t (*lwmqtt_timer_get_t)(void *ref);
 
+/**
+ * The callback used to read a monotonic clock.
+ *
+ * @param ref - A custom reference.
+ * @return The current time in microseconds.
+ */
+typedef uint64_t (*lwmqtt_clock_get_t)(void *ref);
+
+/**
+ * Forward declaration of the latency object.
+ *
+ * @see lwmqtt/latency.h
+ */
+typedef struct lwmqtt_latency_t lwmqtt_latency_t;
+
+/**
+ * Forward declaration of the recorder object.
+ *
+ * @see lwmqtt/recorder.h
+ */
+typedef struct lwmqtt_recorder_t lwmqtt_recorder_t;
+
 /**
  * The callback used to forward incoming messages.
  *
@@ -141,6 +170,113 @@ typedef int32_t (*lwmqtt_timer_get_t)(void *ref);
  */
 typedef void (*lwmqtt_callback_t)(lwmqtt_client_t *client, void *ref, lwmqtt_string_t str, lwmqtt_message_t msg);
 
+/**
+ * The available packet types.
+ */
+typedef enum {
+  LWMQTT_NO_PACKET = 0,
+  LWMQTT_CONNECT_PACKET = 1,
+  LWMQTT_CONNACK_PACKET,
+  LWMQTT_PUBLISH_PACKET,
+  LWMQTT_PUBACK_PACKET,
+  LWMQTT_PUBREC_PACKET,
+  LWMQTT_PUBREL_PACKET,
+  LWMQTT_PUBCOMP_PACKET,
+  LWMQTT_SUBSCRIBE_PACKET,
+  LWMQTT_SUBACK_PACKET,
+  LWMQTT_UNSUBSCRIBE_PACKET,
+  LWMQTT_UNSUBACK_PACKET,
+  LWMQTT_PINGREQ_PACKET,
+  LWMQTT_PINGRESP_PACKET,
+  LWMQTT_DISCONNECT_PACKET
+} lwmqtt_packet_type_t;
+
+/**
+ * The available return codes transported by the connack packet.
+ */
+typedef enum {
+  LWMQTT_CONNECTION_ACCEPTED = 0,
+  LWMQTT_UNACCEPTABLE_PROTOCOL = 1,
+  LWMQTT_IDENTIFIER_REJECTED = 2,
+  LWMQTT_SERVER_UNAVAILABLE = 3,
+  LWMQTT_BAD_USERNAME_OR_PASSWORD = 4,
+  LWMQTT_NOT_AUTHORIZED = 5,
+  LWMQTT_UNKNOWN_RETURN_CODE = 6
+} lwmqtt_return_code_t;
+
+/**
+ * The response object passed to the response callback for every received packet other than publish packets.
+ *
+ * The packet id is set for acknowledgements, the session present flag and return code for connack packets and the
+ * granted QOS levels for suback packets. The granted QOS levels point into the received packet and are only valid
+ * during the callback.
+ */
+typedef struct {
+  lwmqtt_packet_type_t packet_type;
+  uint16_t packet_id;
+  bool session_present;
+  lwmqtt_return_code_t return_code;
+  uint8_t *granted_qos;
+  size_t granted_count;
+} lwmqtt_response_t;
+
+/**
+ * The callback used to forward received responses.
+ *
+ * The same restrictions as for lwmqtt_callback_t apply.
+ */
+typedef void (*lwmqtt_response_callback_t)(lwmqtt_client_t *client, void *ref, lwmqtt_response_t response);
+
+/**
+ * The callback used to transform outgoing and incoming payloads e.g. to compress and decompress them.
+ *
+ * The callback is expected to write the transformed payload to the output buffer and set the transformed flag. If the
+ * payload should be used as is the callback may leave the flag unset, in which case the output buffer is ignored.
+ *
+ * @param ref - A custom reference.
+ * @param in - The input payload.
+ * @param in_len - The length of the input payload.
+ * @param out - The output buffer.
+ * @param out_size - The size of the output buffer.
+ * @param out_len - Variable that must be set with the amount of written bytes.
+ * @param transformed - Variable that must be set if the payload has been transformed.
+ * @return An error value.
+ */
+typedef lwmqtt_err_t (*lwmqtt_transform_t)(void *ref, uint8_t *in, size_t in_len, uint8_t *out, size_t out_size,
+                                           size_t *out_len, bool *transformed);
+
+/**
+ * The number of packet types tracked by the statistics object.
+ */
+#define LWMQTT_STATS_PACKET_TYPES 16
+
+/**
+ * The number of error codes tracked by the statistics object.
+ */
+#define LWMQTT_STATS_ERRORS 32
+
+/**
+ * The statistics object that collects the counters of a client.
+ *
+ * The packet counters are indexed by the MQTT control packet type and the error counters by the negated error value.
+ * All counters are updated with relaxed atomic operations and may be read from other threads using
+ * lwmqtt_stats_snapshot(). Timeouts are counted when a read or write did not complete in time, waiting for the first
+ * byte of a packet is not considered a timeout. Errors are counted once when a client function returns them. For
+ * lwmqtt_publish_batch() the result of each message that differs from the returned error is counted as well.
+ *
+ * The counters are not updated if the library has been compiled with LWMQTT_DISABLE_STATS.
+ */
+typedef struct {
+  uint64_t bytes_in, bytes_out;
+  uint64_t packets_in[LWMQTT_STATS_PACKET_TYPES];
+  uint64_t packets_out[LWMQTT_STATS_PACKET_TYPES];
+  uint64_t read_calls, partial_reads;
+  uint64_t write_calls, partial_writes, blocked_writes;
+  uint64_t timeouts;
+  uint64_t dropped_overflows;
+  uint64_t errors[LWMQTT_STATS_ERRORS];
+} lwmqtt_stats_t;
+
 /**
  * The client object.
  */
@@ -152,9 +288,22 @@ struct lwmqtt_client_t {
   size_t write_buf_size, read_buf_size;
   uint8_t *write_buf, *read_buf;
 
+  uint8_t *partial_buf;
+  size_t partial_len, partial_offset;
+  bool partial_direct;
+  size_t deferred_len;
+
+  size_t direct_threshold;
+  lwmqtt_network_write_t direct_write;
+  uint8_t *direct_buf;
+  size_t direct_len;
+
   lwmqtt_callback_t callback;
   void *callback_ref;
 
+  lwmqtt_response_callback_t response_callback;
+  void *response_ref;
+
   void *network;
   lwmqtt_network_read_t network_read;
   lwmqtt_network_write_t network_write;
@@ -166,6 +315,31 @@ struct lwmqtt_client_t {
 
   bool drop_overflow;
   uint32_t *overflow_counter;
+
+  uint8_t *linger_buf;
+  size_t linger_buf_size, linger_len;
+  void *linger_timer;
+  uint32_t linger;
+
+  void *transform_ref;
+  lwmqtt_transform_t transform_encode;
+  lwmqtt_transform_t transform_decode;
+  uint8_t *transform_buf;
+  size_t transform_buf_size;
+
+  lwmqtt_stats_t *stats;
+
+  lwmqtt_latency_t *latency;
+  void *clock_ref;
+  lwmqtt_clock_get_t clock_get;
+  uint64_t command_sent, ping_sent;
+  bool batch_acks;
+
+  lwmqtt_recorder_t *recorder;
+
+  uint8_t *output_buf;
+  size_t output_buf_size, output_offset, output_len;
+  size_t feed_len, feed_need, feed_skip;
 };
 
 /**
@@ -221,6 +395,150 @@ void lwmqtt_set_callback(lwmqtt_client_t *client, void *ref, lwmqtt_callback_t c
  */
 void lwmqtt_drop_overflow(lwmqtt_client_t *client, bool enabled, uint32_t *counter);
 
+/**
+ * Will configure the client to coalesce small outbound packets into the specified linger buffer instead of writing
+ * them immediately. This applies to QOS 0 publish packets and the puback, pubrec and pubcomp packets sent in response
+ * to incoming messages.
+ *
+ * Buffered packets are written with a single write when the buffer is full, when the linger deadline has been reached
+ * at the next call of lwmqtt_publish(), lwmqtt_yield() or lwmqtt_keep_alive(), at the end of every lwmqtt_yield() and
+ * before any other packet is sent. Use lwmqtt_flush() to write them explicitly. The timer is driven by the callbacks
+ * set with lwmqtt_set_timers(). Passing a NULL buffer disables lingering.
+ *
+ * @param client - The client object.
+ * @param buf - The linger buffer.
+ * @param buf_size - The linger buffer size.
+ * @param timer - The reference to the linger timer.
+ * @param linger - The maximum time in milliseconds a packet may linger.
+ */
+void lwmqtt_set_linger(lwmqtt_client_t *client, uint8_t *buf, size_t buf_size, void *timer, uint32_t linger);
+
+/**
+ * Will set the callbacks used to transform the payload of outgoing and incoming messages.
+ *
+ * Outgoing payloads are transformed directly into the write buffer. Incoming payloads are transformed into the
+ * specified buffer before the message callback is called. Passing NULL callbacks disables the transformation.
+ *
+ * @param client - The client object.
+ * @param ref - A custom reference that will be passed to the callbacks.
+ * @param encode - The callback used for outgoing payloads.
+ * @param decode - The callback used for incoming payloads.
+ * @param buf - The buffer for transformed incoming payloads.
+ * @param buf_size - The size of the buffer.
+ */
+void lwmqtt_set_payload_transform(lwmqtt_client_t *client, void *ref, lwmqtt_transform_t encode,
+                                  lwmqtt_transform_t decode, uint8_t *buf, size_t buf_size);
+
+/**
+ * Will configure the client to write large payloads of lwmqtt_publish() and lwmqtt_publish_batch() directly from the
+ * message instead of copying them into the write buffer. Only the packet header is encoded into the write buffer and
+ * the payload is passed to a separate network write, which allows the payload to exceed the write buffer and
+ * transports to send it without a copy. Payloads that are transformed or queued in sans-IO mode are always copied.
+ * Passing zero disables direct writes.
+ *
+ * If a write would block, the payload is written by the call that finishes the pending write and must stay valid
+ * until then. An optional write callback is used for the payloads instead of the network write callback. As it only
+ * receives memory owned by the caller, it may send without a copy, which may require the payload to stay valid even
+ * longer.
+ *
+ * @param client - The client object.
+ * @param threshold - The minimum payload length that is written directly.
+ * @param write - The callback used for direct payloads or NULL to use the network write callback.
+ */
+void lwmqtt_set_direct_payload(lwmqtt_client_t *client, size_t threshold, lwmqtt_network_write_t write);
+
+/**
+ * Will attach the specified statistics object to the client. The object should be zeroed before it is attached.
+ * Passing NULL detaches the current object.
+ *
+ * @param client - The client object.
+ * @param stats - The statistics object.
+ */
+void lwmqtt_set_stats(lwmqtt_client_t *client, lwmqtt_stats_t *stats);
+
+/**
+ * Will copy the counters of a statistics object that may be concurrently updated by a client.
+ *
+ * @param stats - The statistics object.
+ * @param snapshot - The object that will receive the counters.
+ */
+void lwmqtt_stats_snapshot(lwmqtt_stats_t *stats, lwmqtt_stats_t *snapshot);
+
+/**
+ * Will attach the specified latency object to the client. The client will then record the time between sending a
+ * publish, subscribe, unsubscribe or pingreq packet and receiving its final ack using the specified clock. Messages of
+ * lwmqtt_publish_batch() are timed individually from the write that hands their chunk to the network. Passing NULL
+ * detaches the current object.
+ *
+ * @param client - The client object.
+ * @param latency - The latency object.
+ * @param ref - The reference to the clock.
+ * @param get - The clock callback.
+ */
+void lwmqtt_set_latency(lwmqtt_client_t *client, lwmqtt_latency_t *latency, void *ref, lwmqtt_clock_get_t get);
+
+/**
+ * Will attach the specified flight recorder object to the client. The client will then record an event for every sent
+ * and received packet as well as for errors. Passing NULL detaches the current object.
+ *
+ * @param client - The client object.
+ * @param recorder - The recorder object.
+ */
+void lwmqtt_set_recorder(lwmqtt_client_t *client, lwmqtt_recorder_t *recorder);
+
+/**
+ * Will set the callback used to receive responses e.g. to complete commands in sans-IO mode.
+ *
+ * @param client - The client object.
+ * @param ref - A custom reference that will passed to the callback.
+ * @param cb - The callback to be called.
+ */
+void lwmqtt_set_response_callback(lwmqtt_client_t *client, void *ref, lwmqtt_response_callback_t cb);
+
+/**
+ * Will switch the client to sans-IO mode and set the output buffer that collects all outgoing packets.
+ *
+ * In sans-IO mode the network callbacks are not used. Commands return as soon as their packet has been queued in the
+ * output buffer and their acknowledgements are reported to the response callback once fed with lwmqtt_feed(). The
+ * output must be drained using lwmqtt_pending_output() and lwmqtt_consume_output(). Commands fail with
+ * LWMQTT_BUFFER_TOO_SHORT if the output buffer cannot take their packet. The timers are still required for keep alive.
+ *
+ * @param client - The client object.
+ * @param buf - The output buffer.
+ * @param buf_size - The output buffer size.
+ */
+void lwmqtt_set_output(lwmqtt_client_t *client, uint8_t *buf, size_t buf_size);
+
+/**
+ * Will feed received bytes to the client.
+ *
+ * The data may be split at any position. Complete packets are handled directly from the passed data, while packets that
+ * are split across calls are assembled in the read buffer. After an error the connection should be closed.
+ *
+ * @param client - The client object.
+ * @param data - The received data.
+ * @param len - The length of the received data.
+ * @return An error value.
+ */
+lwmqtt_err_t lwmqtt_feed(lwmqtt_client_t *client, uint8_t *data, size_t len);
+
+/**
+ * Will return the queued outgoing bytes in sans-IO mode.
+ *
+ * @param client - The client object.
+ * @param buf - Variable that will be set to the first pending byte.
+ * @param len - Variable that will be set to the amount of pending bytes.
+ */
+void lwmqtt_pending_output(lwmqtt_client_t *client, uint8_t **buf, size_t *len);
+
+/**
+ * Will remove sent bytes from the output buffer in sans-IO mode.
+ *
+ * @param client - The client object.
+ * @param len - The amount of bytes that have been sent.
+ */
+void lwmqtt_consume_output(lwmqtt_client_t *client, size_t len);
+
 /**
  * The object defining the last will of a client.
  */
@@ -254,19 +572,6 @@ typedef struct {
 #define lwmqtt_default_options \
   { lwmqtt_default_string, 60, true, lwmqtt_default_string, lwmqtt_default_string }
 
-/**
- * The available return codes transported by the connack packet.
- */
-typedef enum {
-  LWMQTT_CONNECTION_ACCEPTED = 0,
-  LWMQTT_UNACCEPTABLE_PROTOCOL = 1,
-  LWMQTT_IDENTIFIER_REJECTED = 2,
-  LWMQTT_SERVER_UNAVAILABLE = 3,
-  LWMQTT_BAD_USERNAME_OR_PASSWORD = 4,
-  LWMQTT_NOT_AUTHORIZED = 5,
-  LWMQTT_UNKNOWN_RETURN_CODE = 6
-} lwmqtt_return_code_t;
-
 /**
  * Will send a connect packet and wait for a connack response and set the return code.
  *
@@ -283,6 +588,27 @@ typedef enum {
 lwmqtt_err_t lwmqtt_connect(lwmqtt_client_t *client, lwmqtt_options_t options, lwmqtt_will_t *will,
                             lwmqtt_return_code_t *return_code, uint32_t timeout);
 
+/**
+ * Will send a connect packet followed by a subscribe packet with multiple topic filters plus QOS levels in a single
+ * write and wait for the connack and suback responses. This saves a round trip compared to lwmqtt_connect() followed
+ * by lwmqtt_subscribe(). Both packets must fit into the write buffer together.
+ *
+ * Note: The message callback might be called with incoming messages as part of this call.
+ *
+ * @param client - The client object.
+ * @param options - The options object.
+ * @param will - The will object.
+ * @param return_code - The variable that will receive the return code.
+ * @param count - The number of topic filters and QOS levels.
+ * @param topic_filter - The list of topic filters.
+ * @param qos - The list of QOS levels.
+ * @param timeout - The command timeout.
+ * @return An error value.
+ */
+lwmqtt_err_t lwmqtt_connect_and_subscribe(lwmqtt_client_t *client, lwmqtt_options_t options, lwmqtt_will_t *will,
+                                          lwmqtt_return_code_t *return_code, int count, lwmqtt_string_t *topic_filter,
+                                          lwmqtt_qos_t *qos, uint32_t timeout);
+
 /**
  * Will send a publish packet and wait for all acks to complete. If the encoded packet is bigger than the write buffer
  * the function will return LWMQTT_BUFFER_TOO_SHORT without attempting to send the packet.
@@ -297,6 +623,31 @@ lwmqtt_err_t lwmqtt_connect(lwmqtt_client_t *client, lwmqtt_options_t options, l
  */
 lwmqtt_err_t lwmqtt_publish(lwmqtt_client_t *client, lwmqtt_string_t topic, lwmqtt_message_t msg, uint32_t timeout);
 
+/**
+ * Will send multiple publish packets and wait for all acks to complete. As many packets as fit are encoded back to back
+ * into the write buffer and sent with a single write before the acks of that chunk are awaited.
+ *
+ * The result of each message is stored in the results array. A message that does not fit into the write buffer at all
+ * receives LWMQTT_BUFFER_TOO_SHORT and is skipped without affecting the others. The returned error is only set if the
+ * connection failed, in which case all unfinished messages receive the same error.
+ *
+ * If the write of a chunk would block, the function returns LWMQTT_WOULD_BLOCK. The messages of that chunk receive
+ * LWMQTT_WOULD_BLOCK as they have been accepted and their acks are reported to the response callback by later calls
+ * to lwmqtt_yield(). All following messages receive LWMQTT_BUSY as they have not been sent, see lwmqtt_flush().
+ *
+ * Note: The message callback might be called with incoming messages as part of this call.
+ *
+ * @param client - The client object.
+ * @param count - The number of topics and messages.
+ * @param topics - The list of topics.
+ * @param messages - The list of messages.
+ * @param results - The list that will receive the result of each message.
+ * @param timeout - The command timeout.
+ * @return An error value.
+ */
+lwmqtt_err_t lwmqtt_publish_batch(lwmqtt_client_t *client, int count, lwmqtt_string_t *topics,
+                                  lwmqtt_message_t *messages, lwmqtt_err_t *results, uint32_t timeout);
+
 /**
  * Will send a subscribe packet with multiple topic filters plus QOS levels and wait for the suback to complete.
  *
@@ -380,6 +731,26 @@ lwmqtt_err_t lwmqtt_disconnect(lwmqtt_client_t *client, uint32_t timeout);
  */
 lwmqtt_err_t lwmqtt_yield(lwmqtt_client_t *client, size_t available, uint32_t timeout);
 
+/**
+ * Will write all packets that are lingering in the linger buffer.
+ *
+ * If a network write callback returns LWMQTT_WOULD_BLOCK the client remembers the partially written packet and the
+ * command that wrote it returns LWMQTT_WOULD_BLOCK. The packet has been accepted in that case and the rest is written
+ * by the next call to this function or lwmqtt_yield(), which return LWMQTT_WOULD_BLOCK as long as it cannot be
+ * completed. Acknowledgements of such commands are processed by later calls to lwmqtt_yield() and reported to the
+ * response callback.
+ *
+ * Any other command issued before the write has been completed attempts to complete it first. If that is not possible,
+ * the command fails with LWMQTT_BUSY before encoding its packet or allocating a packet id, and may be retried once
+ * this function has returned LWMQTT_SUCCESS. A command that has sent its packet and waits for the acknowledgement
+ * keeps waiting if a reply to another incoming packet would block.
+ *
+ * @param client - The client object.
+ * @param timeout - The command timeout.
+ * @return An error value.
+ */
+lwmqtt_err_t lwmqtt_flush(lwmqtt_client_t *client, uint32_t timeout);
+
 /**
  * Will yield control to the client to keep the connection alive.
  *
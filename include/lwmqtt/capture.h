@@ -0,0 +1,129 @@
+#ifndef LWMQTT_CAPTURE_H
+#define LWMQTT_CAPTURE_H
+
+#include <lwmqtt.h>
+
+/**
+ * The capture object that wraps another network and records every transferred byte.
+ *
+ * The capture file starts with a five byte header ("LWCP" and a version byte) followed by one record per non-empty
+ * read or write. Each record consists of a direction byte, the time since the previous record in microseconds and the
+ * data length as variable length integers, and the data itself.
+ */
+typedef struct {
+  void *ref;
+  lwmqtt_network_read_t read;
+  lwmqtt_network_write_t write;
+  int fd;
+  uint64_t last;
+} lwmqtt_capture_t;
+
+/**
+ * The record directions.
+ */
+#define LWMQTT_CAPTURE_IN 0
+#define LWMQTT_CAPTURE_OUT 1
+
+/**
+ * Function to create a capture file and wrap a network.
+ *
+ * @param capture - The capture object.
+ * @param path - The path of the capture file.
+ * @param ref - The reference of the wrapped network.
+ * @param read - The read callback of the wrapped network.
+ * @param write - The write callback of the wrapped network.
+ * @return An error value.
+ */
+lwmqtt_err_t lwmqtt_capture_open(lwmqtt_capture_t *capture, const char *path, void *ref, lwmqtt_network_read_t read,
+                                 lwmqtt_network_write_t write);
+
+/**
+ * Function to close a capture file.
+ *
+ * @param capture - The capture object.
+ */
+void lwmqtt_capture_close(lwmqtt_capture_t *capture);
+
+/**
+ * Callback to read from the wrapped network and record the data. The reference must point to a lwmqtt_capture_t
+ * object.
+ *
+ * @see lwmqtt_network_read_t.
+ */
+lwmqtt_err_t lwmqtt_capture_read(void *ref, uint8_t *buf, size_t len, size_t *read, uint32_t timeout);
+
+/**
+ * Callback to write to the wrapped network and record the data. The reference must point to a lwmqtt_capture_t
+ * object.
+ *
+ * @see lwmqtt_network_write_t.
+ */
+lwmqtt_err_t lwmqtt_capture_write(void *ref, uint8_t *buf, size_t len, size_t *sent, uint32_t timeout);
+
+/**
+ * The replay object that feeds the incoming data of a mapped capture file to a client.
+ *
+ * The replayed data is delivered as fast as it is read or, if paced, not before its recorded time relative to the
+ * first read. Written data is discarded.
+ */
+typedef struct {
+  uint8_t *data;
+  size_t size;
+  size_t offset;
+  uint8_t *chunk;
+  size_t chunk_len;
+  uint64_t time;
+  uint64_t start;
+  bool paced;
+  size_t bytes_in;
+  size_t bytes_out;
+} lwmqtt_replay_t;
+
+/**
+ * Function to map a capture file for replay.
+ *
+ * @param replay - The replay object.
+ * @param path - The path of the capture file.
+ * @param paced - Whether the recorded timing should be reproduced.
+ * @return An error value.
+ */
+lwmqtt_err_t lwmqtt_replay_open(lwmqtt_replay_t *replay, const char *path, bool paced);
+
+/**
+ * Function to unmap a capture file.
+ *
+ * @param replay - The replay object.
+ */
+void lwmqtt_replay_close(lwmqtt_replay_t *replay);
+
+/**
+ * Function to get the amount of incoming bytes that can be read at the current time.
+ *
+ * @param replay - The replay object.
+ * @return The available bytes.
+ */
+size_t lwmqtt_replay_available(lwmqtt_replay_t *replay);
+
+/**
+ * Function to check whether all incoming data has been read.
+ *
+ * @param replay - The replay object.
+ * @return Whether the replay has finished.
+ */
+bool lwmqtt_replay_done(lwmqtt_replay_t *replay);
+
+/**
+ * Callback to read the next incoming data from a replay. The reference must point to a lwmqtt_replay_t object.
+ *
+ * @see lwmqtt_network_read_t.
+ */
+lwmqtt_err_t lwmqtt_replay_read(void *ref, uint8_t *buf, size_t len, size_t *read, uint32_t timeout);
+
+/**
+ * Callback to discard outgoing data during a replay. The reference must point to a lwmqtt_replay_t object.
+ *
+ * @see lwmqtt_network_write_t.
+ */
+lwmqtt_err_t lwmqtt_replay_write(void *ref, uint8_t *buf, size_t len, size_t *sent, uint32_t timeout);
+
+#endif  // LWMQTT_CAPTURE_H
@@ -0,0 +1,106 @@
+#ifndef LWMQTT_ENVELOPE_H
+#define LWMQTT_ENVELOPE_H
+
+#include <lwmqtt.h>
+
+/**
+ * The envelope packer object.
+ *
+ * An envelope is a publish payload that carries multiple records. Each record is prefixed with its length encoded as a
+ * variable number in the same format as the remaining length of a packet.
+ */
+typedef struct {
+  uint8_t *buf;
+  size_t buf_size, len;
+  int count;
+
+  size_t flush_size;
+  uint32_t flush_time;
+
+  void *timer;
+  lwmqtt_timer_set_t timer_set;
+  lwmqtt_timer_get_t timer_get;
+} lwmqtt_envelope_packer_t;
+
+/**
+ * Will initialize the specified packer object.
+ *
+ * The packer is due to be flushed once the packed records reach the flush size or the flush time has elapsed since
+ * the first record has been packed. A flush size of zero only flushes full buffers and a NULL timer disables the time
+ * trigger.
+ *
+ * @param packer - The packer object.
+ * @param buf - The payload buffer.
+ * @param buf_size - The payload buffer size.
+ * @param flush_size - The size at which the envelope is due.
+ * @param timer - The reference to the flush timer.
+ * @param set - The timer set callback.
+ * @param get - The timer get callback.
+ * @param flush_time - The time in milliseconds after which the envelope is due.
+ */
+void lwmqtt_envelope_packer_init(lwmqtt_envelope_packer_t *packer, uint8_t *buf, size_t buf_size, size_t flush_size,
+                                 void *timer, lwmqtt_timer_set_t set, lwmqtt_timer_get_t get, uint32_t flush_time);
+
+/**
+ * Will append a record to the envelope. If the record does not fit into the remaining buffer the function will return
+ * LWMQTT_BUFFER_TOO_SHORT and the envelope should be flushed before retrying.
+ *
+ * @param packer - The packer object.
+ * @param data - The record data.
+ * @param len - The record length.
+ * @return An error value.
+ */
+lwmqtt_err_t lwmqtt_envelope_pack(lwmqtt_envelope_packer_t *packer, uint8_t *data, size_t len);
+
+/**
+ * Will check whether the envelope reached its flush size or flush time.
+ *
+ * @param packer - The packer object.
+ * @return Whether the envelope should be flushed.
+ */
+bool lwmqtt_envelope_due(lwmqtt_envelope_packer_t *packer);
+
+/**
+ * Will set the payload of the specified message to the packed envelope.
+ *
+ * @param packer - The packer object.
+ * @param msg - The message.
+ */
+void lwmqtt_envelope_fill(lwmqtt_envelope_packer_t *packer, lwmqtt_message_t *msg);
+
+/**
+ * Will remove all packed records from the envelope after it has been published.
+ *
+ * @param packer - The packer object.
+ */
+void lwmqtt_envelope_reset(lwmqtt_envelope_packer_t *packer);
+
+/**
+ * The envelope reader object.
+ */
+typedef struct {
+  uint8_t *ptr;
+  uint8_t *end;
+} lwmqtt_envelope_reader_t;
+
+/**
+ * Will initialize the specified reader object with the payload of a received message. The records returned by the
+ * reader point directly into the payload and are only valid as long as the payload.
+ *
+ * @param reader - The reader object.
+ * @param msg - The received message.
+ */
+void lwmqtt_envelope_reader_init(lwmqtt_envelope_reader_t *reader, lwmqtt_message_t msg);
+
+/**
+ * Will read the next record from the envelope.
+ *
+ * @param reader - The reader object.
+ * @param data - The pointer that will be set to the record data.
+ * @param len - The variable that will receive the record length.
+ * @param found - The variable that will be set if a record has been read.
+ * @return An error value.
+ */
+lwmqtt_err_t lwmqtt_envelope_next(lwmqtt_envelope_reader_t *reader, uint8_t **data, size_t *len, bool *found);
+
+#endif  // LWMQTT_ENVELOPE_H
@@ -0,0 +1,72 @@
+#ifndef LWMQTT_LATENCY_H
+#define LWMQTT_LATENCY_H
+
+#include <lwmqtt.h>
+
+/**
+ * The number of bits used to split every power of two into linear sub buckets. The relative error of a recorded value
+ * is at most 2^-bits.
+ */
+#ifndef LWMQTT_HISTOGRAM_BITS
+#define LWMQTT_HISTOGRAM_BITS 3
+#endif
+
+/**
+ * The number of buckets needed to cover all 32 bit values.
+ */
+#define LWMQTT_HISTOGRAM_BUCKETS ((33 - LWMQTT_HISTOGRAM_BITS) << LWMQTT_HISTOGRAM_BITS)
+
+/**
+ * The log-linear histogram object with a fixed memory footprint.
+ */
+typedef struct {
+  uint32_t counts[LWMQTT_HISTOGRAM_BUCKETS];
+  uint32_t count;
+  uint32_t min, max;
+} lwmqtt_histogram_t;
+
+/**
+ * The latency object that collects the round-trip times between sending a packet and receiving its final ack in
+ * microseconds.
+ */
+struct lwmqtt_latency_t {
+  lwmqtt_histogram_t publish_qos1;
+  lwmqtt_histogram_t publish_qos2;
+  lwmqtt_histogram_t subscribe;
+  lwmqtt_histogram_t unsubscribe;
+  lwmqtt_histogram_t ping;
+};
+
+/**
+ * Will reset the specified histogram object.
+ *
+ * @param histogram - The histogram object.
+ */
+void lwmqtt_histogram_reset(lwmqtt_histogram_t *histogram);
+
+/**
+ * Will record a value in the specified histogram object.
+ *
+ * @param histogram - The histogram object.
+ * @param value - The value.
+ */
+void lwmqtt_histogram_record(lwmqtt_histogram_t *histogram, uint32_t value);
+
+/**
+ * Will return the value at the specified percentile. The value is the upper bound of the bucket that holds the
+ * percentile, limited to the largest recorded value.
+ *
+ * @param histogram - The histogram object.
+ * @param percentile - The percentile between 0 and 100.
+ * @return The value or zero if the histogram is empty.
+ */
+uint32_t lwmqtt_histogram_percentile(lwmqtt_histogram_t *histogram, double percentile);
+
+/**
+ * Will reset all histograms of the specified latency object.
+ *
+ * @param latency - The latency object.
+ */
+void lwmqtt_latency_reset(lwmqtt_latency_t *latency);
+
+#endif  // LWMQTT_LATENCY_H
@@ -0,0 +1,45 @@
+#ifndef LWMQTT_LZ_H
+#define LWMQTT_LZ_H
+
+#include <lwmqtt.h>
+
+/**
+ * The number of bits used to index the match table.
+ */
+#ifndef LWMQTT_LZ_HASH_BITS
+#define LWMQTT_LZ_HASH_BITS 12
+#endif
+
+/**
+ * The LZ codec state object that holds the match table used by the compressor.
+ *
+ * The table does not need to be cleared between payloads as every candidate match is verified.
+ */
+typedef struct {
+  uint32_t table[1 << LWMQTT_LZ_HASH_BITS];
+} lwmqtt_lz_state_t;
+
+/**
+ * Callback to compress a payload using the built-in LZ codec.
+ *
+ * Compressed payloads start with a marker followed by the uncompressed length. Payloads that do not shrink are left
+ * untouched unless they start with the marker themselves, in which case they are always wrapped.
+ *
+ * The reference must point to a lwmqtt_lz_state_t object.
+ *
+ * @see lwmqtt_transform_t.
+ */
+lwmqtt_err_t lwmqtt_lz_compress(void *ref, uint8_t *in, size_t in_len, uint8_t *out, size_t out_size, size_t *out_len,
+                                bool *transformed);
+
+/**
+ * Callback to decompress a payload using the built-in LZ codec.
+ *
+ * Payloads that do not start with the marker are left untouched. The reference is not used.
+ *
+ * @see lwmqtt_transform_t.
+ */
+lwmqtt_err_t lwmqtt_lz_decompress(void *ref, uint8_t *in, size_t in_len, uint8_t *out, size_t out_size,
+                                  size_t *out_len, bool *transformed);
+
+#endif  // LWMQTT_LZ_H
@@ -0,0 +1,163 @@
+#ifndef LWMQTT_PIPE_H
+#define LWMQTT_PIPE_H
+
+#include <lwmqtt.h>
+
+/**
+ * The maximum number of in-flight segments per pipe direction. Further writes are merged into the last segment.
+ */
+#ifndef LWMQTT_PIPE_SEGMENTS
+#define LWMQTT_PIPE_SEGMENTS 64
+#endif
+
+/**
+ * The virtual clock object. The time is kept in microseconds and only moves when advanced explicitly or when a pipe
+ * read or write waits.
+ */
+typedef struct {
+  uint64_t now;
+} lwmqtt_pipe_clock_t;
+
+/**
+ * Function to advance the virtual clock.
+ *
+ * @param clock - The clock object.
+ * @param duration - The duration in microseconds.
+ */
+void lwmqtt_pipe_clock_advance(lwmqtt_pipe_clock_t *clock, uint64_t duration);
+
+/**
+ * Callback to read the virtual clock. The reference must point to a lwmqtt_pipe_clock_t object.
+ *
+ * @see lwmqtt_clock_get_t.
+ */
+uint64_t lwmqtt_pipe_clock_get(void *ref);
+
+/**
+ * The virtual timer object.
+ */
+typedef struct {
+  lwmqtt_pipe_clock_t *clock;
+  uint64_t end;
+} lwmqtt_pipe_timer_t;
+
+/**
+ * Function to initialize a virtual timer object.
+ *
+ * @param timer - The timer object.
+ * @param clock - The clock object.
+ */
+void lwmqtt_pipe_timer_init(lwmqtt_pipe_timer_t *timer, lwmqtt_pipe_clock_t *clock);
+
+/**
+ * Callback to set the virtual timer object.
+ *
+ * @see lwmqtt_timer_set_t.
+ */
+void lwmqtt_pipe_timer_set(void *ref, uint32_t timeout);
+
+/**
+ * Callback to read the virtual timer object.
+ *
+ * @see lwmqtt_timer_get_t.
+ */
+int32_t lwmqtt_pipe_timer_get(void *ref);
+
+/**
+ * The link and fault model of one pipe direction.
+ *
+ * Written bytes are delivered after the latency in microseconds plus their transmission time at the bandwidth in
+ * bytes per second. The maximum write and read sizes force partial transfers and a zero value disables any limit. Once
+ * the stream reaches the fail after offset, further writes and reads fail with a network error. Non-blocking writes
+ * return LWMQTT_WOULD_BLOCK instead of waiting for the timeout if the ring is full. The fields may be changed at any
+ * time to script a scenario.
+ */
+typedef struct {
+  uint32_t latency;
+  uint32_t bandwidth;
+  size_t max_write;
+  size_t max_read;
+  uint64_t fail_after;
+  bool nonblocking;
+} lwmqtt_pipe_options_t;
+
+/**
+ * The default initializer for the pipe options object.
+ */
+#define lwmqtt_pipe_default_options \
+  { 0, 0, 0, 0, UINT64_MAX, false }
+
+/**
+ * A single pipe direction backed by a ring buffer.
+ */
+typedef struct {
+  lwmqtt_pipe_options_t options;
+  uint8_t *buf;
+  size_t size;
+  uint64_t head;
+  uint64_t tail;
+  uint64_t busy;
+  struct {
+    uint64_t end;
+    uint64_t release;
+  } segments[LWMQTT_PIPE_SEGMENTS];
+  size_t first_segment;
+  size_t segment_count;
+} lwmqtt_pipe_ring_t;
+
+/**
+ * One end of a pipe that is passed as the network reference.
+ */
+typedef struct {
+  lwmqtt_pipe_ring_t *in;
+  lwmqtt_pipe_ring_t *out;
+  lwmqtt_pipe_clock_t *clock;
+} lwmqtt_pipe_end_t;
+
+/**
+ * The pipe object that connects two ends in memory.
+ *
+ * The pipe is meant to be driven from a single thread: A read that finds no deliverable data advances the clock to the
+ * next delivery or by the full timeout, and a write that finds the ring full advances the clock by the timeout.
+ */
+typedef struct {
+  lwmqtt_pipe_ring_t rings[2];
+  lwmqtt_pipe_end_t a;
+  lwmqtt_pipe_end_t b;
+} lwmqtt_pipe_t;
+
+/**
+ * Function to initialize a pipe object.
+ *
+ * The buffer is split in half to back both directions.
+ *
+ * @param pipe - The pipe object.
+ * @param clock - The clock object.
+ * @param buf - The buffer.
+ * @param buf_size - The buffer size.
+ */
+void lwmqtt_pipe_init(lwmqtt_pipe_t *pipe, lwmqtt_pipe_clock_t *clock, uint8_t *buf, size_t buf_size);
+
+/**
+ * Function to get the amount of bytes that can be read from a pipe end at the current time.
+ *
+ * @param end - The pipe end.
+ * @return The available bytes.
+ */
+size_t lwmqtt_pipe_available(lwmqtt_pipe_end_t *end);
+
+/**
+ * Callback to read from a pipe end. The reference must point to a lwmqtt_pipe_end_t object.
+ *
+ * @see lwmqtt_network_read_t.
+ */
+lwmqtt_err_t lwmqtt_pipe_read(void *ref, uint8_t *buf, size_t len, size_t *read, uint32_t timeout);
+
+/**
+ * Callback to write to a pipe end. The reference must point to a lwmqtt_pipe_end_t object.
+ *
+ * @see lwmqtt_network_write_t.
+ */
+lwmqtt_err_t lwmqtt_pipe_write(void *ref, uint8_t *buf, size_t len, size_t *sent, uint32_t timeout);
+
+#endif  // LWMQTT_PIPE_H
@@ -0,0 +1,75 @@
+#ifndef LWMQTT_RECORDER_H
+#define LWMQTT_RECORDER_H
+
+#include <lwmqtt.h>
+
+/**
+ * The available event directions.
+ */
+typedef enum { LWMQTT_EVENT_IN = 0, LWMQTT_EVENT_OUT = 1, LWMQTT_EVENT_ERROR = 2 } lwmqtt_event_direction_t;
+
+/**
+ * The compact event object stored by the recorder.
+ *
+ * The time is the lower 32 bits of the recorder clock in microseconds. Error events carry the error value and the
+ * type of the last received packet.
+ */
+typedef struct {
+  uint32_t time;
+  uint32_t len;
+  uint16_t packet_id;
+  uint8_t direction;
+  uint8_t packet_type;
+  int32_t err;
+} lwmqtt_event_t;
+
+/**
+ * The flight recorder object that keeps the most recent packet events of a client in a ring buffer.
+ *
+ * Events are written by the client without locks. The recorder should be read with lwmqtt_recorder_dump() from the
+ * thread that drives the client or after the client has stopped.
+ */
+struct lwmqtt_recorder_t {
+  lwmqtt_event_t *events;
+  uint32_t mask;
+  uint32_t head;
+  uint8_t last_type;
+
+  void *clock_ref;
+  lwmqtt_clock_get_t clock_get;
+};
+
+/**
+ * Will initialize the specified recorder object.
+ *
+ * @param recorder - The recorder object.
+ * @param events - The event buffer.
+ * @param size - The number of events in the buffer, must be a power of two.
+ * @param ref - The reference to the clock.
+ * @param get - The clock callback, may be NULL to not record time.
+ */
+void lwmqtt_recorder_init(lwmqtt_recorder_t *recorder, lwmqtt_event_t *events, uint32_t size, void *ref,
+                          lwmqtt_clock_get_t get);
+
+/**
+ * Will copy the recorded events in chronological order to the specified buffer. If the buffer is smaller than the
+ * number of recorded events, only the most recent events are copied.
+ *
+ * @param recorder - The recorder object.
+ * @param events - The buffer that will receive the events.
+ * @param count - The number of events the buffer can hold.
+ * @return The number of copied events.
+ */
+uint32_t lwmqtt_recorder_dump(lwmqtt_recorder_t *recorder, lwmqtt_event_t *events, uint32_t count);
+
+/**
+ * Will format the specified event as a human readable line.
+ *
+ * @param event - The event object.
+ * @param buf - The buffer that will receive the null terminated line.
+ * @param size - The size of the buffer.
+ * @return The length of the full line, as returned by snprintf().
+ */
+int lwmqtt_event_format(lwmqtt_event_t *event, char *buf, size_t size);
+
+#endif  // LWMQTT_RECORDER_H
@@ -1,6 +1,8 @@
 #ifndef LWMQTT_UNIX_H
 #define LWMQTT_UNIX_H
 
+#include <pthread.h>
+#include <sys/socket.h>
 #include <sys/time.h>
 
 #include <lwmqtt.h>
@@ -26,22 +28,244 @@ void lwmqtt_unix_timer_set(void *ref, uint32_t timeout);
  */
 int32_t lwmqtt_unix_timer_get(void *ref);
 
+/**
+ * Callback to read the monotonic UNIX clock. The reference is not used.
+ *
+ * @see lwmqtt_clock_get_t.
+ */
+uint64_t lwmqtt_unix_clock_get(void *ref);
+
 /**
  * The UNIX network object.
+ *
+ * A non-blocking network reports a full send buffer as LWMQTT_WOULD_BLOCK after writing what fits. Blocking networks
+ * wait until the write timeout and let the client fail the command with LWMQTT_NETWORK_TIMEOUT.
+ *
+ * If a spin time in microseconds is set, reads and selects first retry non-blocking receives until data arrives or
+ * the spin time or their timeout has passed, before they fall back to waiting in the kernel. This trades CPU time for
+ * avoiding the scheduler wakeups of a blocking wait and only pays off if the spinning thread has a core of its own.
+ * The counters report how many waits of the current connection were satisfied by spinning and how many fell back.
+ *
+ * If a zero copy threshold in bytes is set, direct payload writes of at least that size are sent with MSG_ZEROCOPY, see
+ * lwmqtt_unix_network_write_direct(). The kernel then reads the data from the payload until it reports the send as
+ * completed, see lwmqtt_unix_network_await_zerocopy(). The counters report the zero copy sends of the current
+ * connection, their completions and the completions for which the kernel copied the data after all.
  */
 typedef struct {
   int socket;
+  bool nonblocking;
+  uint32_t spin;
+  uint64_t spin_hits;
+  uint64_t spin_fallbacks;
+  size_t zerocopy;
+  uint32_t zerocopy_sends;
+  uint32_t zerocopy_completions;
+  uint32_t zerocopy_copies;
 } lwmqtt_unix_network_t;
 
+/**
+ * The maximum number of resolved addresses that are attempted by a connect.
+ */
+#define LWMQTT_UNIX_CONNECT_CANDIDATES 16
+
+/**
+ * The delay in milliseconds after which the next address is attempted while earlier attempts are still pending.
+ */
+#define LWMQTT_UNIX_CONNECT_DELAY 250
+
+/**
+ * The host prefix that selects a UNIX domain socket endpoint, e.g. "unix:/run/broker.sock" or "unix:@broker" for a
+ * socket in the abstract namespace.
+ */
+#define LWMQTT_UNIX_LOCAL_PREFIX "unix:"
+
+/**
+ * The maximum length of a host name stored by the resolver cache including the terminating zero.
+ */
+#define LWMQTT_UNIX_HOST_SIZE 256
+
+/**
+ * The resolved addresses of a host ordered for connecting.
+ */
+typedef struct {
+  struct sockaddr_storage addrs[LWMQTT_UNIX_CONNECT_CANDIDATES];
+  socklen_t lens[LWMQTT_UNIX_CONNECT_CANDIDATES];
+  size_t count;
+} lwmqtt_unix_addresses_t;
+
+/**
+ * A single entry of the resolver cache.
+ */
+typedef struct {
+  char host[LWMQTT_UNIX_HOST_SIZE];
+  int port;
+  lwmqtt_unix_addresses_t addresses;
+  uint64_t expires;
+  bool refreshing;
+} lwmqtt_unix_resolver_entry_t;
+
+/**
+ * The resolver cache object that can be shared by many connects and threads.
+ *
+ * Resolved addresses are reused until the TTL in milliseconds has passed, as the system resolver does not report the
+ * record TTLs. While one caller refreshes an expired entry, other callers keep using the stale addresses, and they
+ * are also kept if the refresh fails. If the cache is full the entry that expires first is replaced, skipping entries
+ * that are being refreshed. If all entries are being refreshed, the host is resolved without caching. The hit and
+ * miss counters are updated under the lock.
+ */
+typedef struct {
+  pthread_mutex_t mutex;
+  lwmqtt_unix_resolver_entry_t *entries;
+  size_t size;
+  uint32_t ttl;
+  uint64_t hits, misses;
+} lwmqtt_unix_resolver_t;
+
+/**
+ * Function to initialize a resolver cache object.
+ *
+ * @param resolver - The resolver object.
+ * @param entries - The entry array.
+ * @param size - The number of entries.
+ * @param ttl - The TTL in milliseconds.
+ */
+void lwmqtt_unix_resolver_init(lwmqtt_unix_resolver_t *resolver, lwmqtt_unix_resolver_entry_t *entries, size_t size,
+                               uint32_t ttl);
+
+/**
+ * Function to release a resolver cache object.
+ *
+ * @param resolver - The resolver object.
+ */
+void lwmqtt_unix_resolver_destroy(lwmqtt_unix_resolver_t *resolver);
+
+/**
+ * Function to resolve the addresses of a host.
+ *
+ * @param resolver - The resolver cache object or NULL to always use the system resolver.
+ * @param host - The host.
+ * @param port - The port.
+ * @param addresses - The object that will receive the addresses.
+ * @return An error value.
+ */
+lwmqtt_err_t lwmqtt_unix_resolve(lwmqtt_unix_resolver_t *resolver, const char *host, int port,
+                                 lwmqtt_unix_addresses_t *addresses);
+
+/**
+ * The socket options applied by a connect.
+ *
+ * Zero values keep the operating system defaults. Buffer sizes are in bytes, the user timeout in milliseconds, the
+ * keep alive idle time and interval in seconds and the busy poll time in microseconds. Keep alive probes are enabled if
+ * the idle time is set. TCP_QUICKACK is set on the established connection and may be reset by the kernel. Options that
+ * are not available on the platform are ignored, while a rejected option fails the connect.
+ *
+ * With fast open the connect completes immediately and the first write, usually the CONNECT packet, is sent with the
+ * SYN once the kernel holds a TCP Fast Open cookie for the server. The kernel falls back to a regular handshake if
+ * the server or the platform does not support it. Connection errors are then reported by the first write or read.
+ * As such a connect cannot tell which address is reachable, the addresses are not raced and the first one that can
+ * be connected is used.
+ *
+ * The spin time is set on the network object, see lwmqtt_unix_network_t. It is best combined with a busy poll time.
+ *
+ * The zero copy threshold is set on the network object if the platform supports SO_ZEROCOPY for the connection, see
+ * lwmqtt_unix_network_t.
+ *
+ * With nonblocking set, the socket stays in non-blocking mode after the connect, see lwmqtt_unix_network_t.
+ *
+ * If a resolver cache is set, it is used to resolve the host.
+ */
+typedef struct {
+  bool no_delay;
+  int send_buffer;
+  int receive_buffer;
+  int not_sent_lowat;
+  bool quick_ack;
+  unsigned int user_timeout;
+  int keep_alive_idle;
+  int keep_alive_interval;
+  int keep_alive_count;
+  int busy_poll;
+  bool fast_open;
+  uint32_t spin;
+  size_t zerocopy;
+  bool nonblocking;
+  lwmqtt_unix_resolver_t *resolver;
+} lwmqtt_unix_options_t;
+
+/**
+ * The default initializer for the options object.
+ */
+#define lwmqtt_unix_default_options \
+  { false, 0, 0, 0, false, 0, 0, 0, 0, 0, false, 0, 0, false, NULL }
+
+/**
+ * Function to establish a UNIX network connection without a deadline.
+ *
+ * @see lwmqtt_unix_network_connect_timeout.
+ */
+lwmqtt_err_t lwmqtt_unix_network_connect(lwmqtt_unix_network_t *network, char *host, int port);
+
 /**
  * Function to establish a UNIX network connection.
  *
+ * All IPv6 and IPv4 addresses of the host are attempted with non-blocking connects in the order returned by the
+ * resolver with alternating address families. A new attempt is started every LWMQTT_UNIX_CONNECT_DELAY milliseconds
+ * or as soon as all pending attempts have failed, and the first established connection wins (Happy Eyeballs). Fast
+ * open connects only start the next attempt once the previous one has failed. The name resolution itself is blocking
+ * and not covered by the timeout.
+ *
+ * Hosts starting with LWMQTT_UNIX_LOCAL_PREFIX connect to the UNIX domain socket at the following path instead and
+ * ignore the port. A path starting with "@" names a socket in the Linux abstract namespace. The TCP specific socket
+ * options are not applied to these connections.
+ *
  * @param network - The network object.
  * @param host - The host.
  * @param port - The port.
+ * @param timeout - The timeout in milliseconds or zero to wait for the operating system limits.
  * @return An error value.
  */
-lwmqtt_err_t lwmqtt_unix_network_connect(lwmqtt_unix_network_t *network, char *host, int port);
+lwmqtt_err_t lwmqtt_unix_network_connect_timeout(lwmqtt_unix_network_t *network, char *host, int port,
+                                                 uint32_t timeout);
+
+/**
+ * Function to establish a UNIX network connection with the specified socket options.
+ *
+ * @see lwmqtt_unix_network_connect_timeout.
+ *
+ * @param network - The network object.
+ * @param host - The host.
+ * @param port - The port.
+ * @param timeout - The timeout in milliseconds or zero to wait for the operating system limits.
+ * @param options - The socket options or NULL to keep the defaults.
+ * @return An error value.
+ */
+lwmqtt_err_t lwmqtt_unix_network_connect_options(lwmqtt_unix_network_t *network, char *host, int port,
+                                                 uint32_t timeout, const lwmqtt_unix_options_t *options);
+
+/**
+ * Function to establish a UNIX network connection to already resolved addresses. This allows connecting many
+ * networks with a single resolution.
+ *
+ * @see lwmqtt_unix_network_connect_timeout.
+ *
+ * @param network - The network object.
+ * @param addresses - The addresses.
+ * @param timeout - The timeout in milliseconds or zero to wait for the operating system limits.
+ * @param options - The socket options or NULL to keep the defaults.
+ * @return An error value.
+ */
+lwmqtt_err_t lwmqtt_unix_network_connect_addresses(lwmqtt_unix_network_t *network, lwmqtt_unix_addresses_t *addresses,
+                                                   uint32_t timeout, const lwmqtt_unix_options_t *options);
+
+/**
+ * Function to process the zero copy completions of a UNIX network connection. Buffers written with zero copy sends
+ * may only be modified or released once all sends have been completed.
+ *
+ * @param network - The network object.
+ * @param timeout - The time in milliseconds to wait for outstanding completions or zero to only check.
+ * @return LWMQTT_NETWORK_TIMEOUT if sends are still outstanding or another error value.
+ */
+lwmqtt_err_t lwmqtt_unix_network_await_zerocopy(lwmqtt_unix_network_t *network, uint32_t timeout);
 
 /**
  * Function to disconnect a UNIX network connection.
@@ -77,10 +301,20 @@ lwmqtt_err_t lwmqtt_unix_network_select(lwmqtt_unix_network_t *network, bool *av
 lwmqtt_err_t lwmqtt_unix_network_read(void *ref, uint8_t *buf, size_t len, size_t *read, uint32_t timeout);
 
 /**
- * Callback to write to a UNIX network connection.
+ * Callback to write to a UNIX network connection. Returns LWMQTT_WOULD_BLOCK if the send buffer of a non-blocking
+ * network is full. Blocking networks wait for the timeout instead.
  *
  * @see lwmqtt_network_write_t.
  */
 lwmqtt_err_t lwmqtt_unix_network_write(void *ref, uint8_t *buf, size_t len, size_t *sent, uint32_t timeout);
 
+/**
+ * Callback to write direct payloads to a UNIX network connection, see lwmqtt_set_direct_payload(). Payloads of at
+ * least the zero copy threshold are sent without a copy and must stay valid until their sends have been completed,
+ * see lwmqtt_unix_network_await_zerocopy(). Other writes behave like lwmqtt_unix_network_write().
+ *
+ * @see lwmqtt_network_write_t.
+ */
+lwmqtt_err_t lwmqtt_unix_network_write_direct(void *ref, uint8_t *buf, size_t len, size_t *sent, uint32_t timeout);
+
 #endif  // LWMQTT_UNIX_H
@@ -1,4 +1,28 @@
+#include <string.h>
+
+#include <lwmqtt/latency.h>
+#include <lwmqtt/recorder.h>
+
 #include "packet.h"
+#include "probes.h"
+
+#if defined(LWMQTT_DISABLE_STATS)
+#define LWMQTT_STATS_ADD(client, counter, n) ((void)0)
+#elif defined(__GNUC__)
+#define LWMQTT_STATS_ADD(client, counter, n)                                          \
+  do {                                                                                \
+    if ((client)->stats != NULL) {                                                    \
+      __atomic_fetch_add(&(client)->stats->counter, (uint64_t)(n), __ATOMIC_RELAXED); \
+    }                                                                                 \
+  } while (0)
+#else
+#define LWMQTT_STATS_ADD(client, counter, n)      \
+  do {                                            \
+    if ((client)->stats != NULL) {                \
+      (client)->stats->counter += (uint64_t)(n);  \
+    }                                             \
+  } while (0)
+#endif
 
 void lwmqtt_init(lwmqtt_client_t *client, uint8_t *write_buf, size_t write_buf_size, uint8_t *read_buf,
                  size_t read_buf_size) {
@@ -11,9 +35,23 @@ void lwmqtt_init(lwmqtt_client_t *client, uint8_t *write_buf, size_t write_buf_s
   client->read_buf = read_buf;
   client->read_buf_size = read_buf_size;
 
+  client->partial_buf = NULL;
+  client->partial_len = 0;
+  client->partial_offset = 0;
+  client->partial_direct = false;
+  client->deferred_len = 0;
+
+  client->direct_threshold = 0;
+  client->direct_write = NULL;
+  client->direct_buf = NULL;
+  client->direct_len = 0;
+
   client->callback = NULL;
   client->callback_ref = NULL;
 
+  client->response_callback = NULL;
+  client->response_ref = NULL;
+
   client->network = NULL;
   client->network_read = NULL;
   client->network_write = NULL;
@@ -25,6 +63,38 @@ void lwmqtt_init(lwmqtt_client_t *client, uint8_t *write_buf, size_t write_buf_s
 
   client->drop_overflow = false;
   client->overflow_counter = NULL;
+
+  client->linger_buf = NULL;
+  client->linger_buf_size = 0;
+  client->linger_len = 0;
+  client->linger_timer = NULL;
+  client->linger = 0;
+
+  client->transform_ref = NULL;
+  client->transform_encode = NULL;
+  client->transform_decode = NULL;
+  client->transform_buf = NULL;
+  client->transform_buf_size = 0;
+
+  client->stats = NULL;
+
+  client->latency = NULL;
+  client->clock_ref = NULL;
+  client->clock_get = NULL;
+  client->command_sent = 0;
+  client->ping_sent = 0;
+  client->batch_acks = false;
+
+  client->recorder = NULL;
+
+  client->output_buf = NULL;
+  client->output_buf_size = 0;
+  client->output_offset = 0;
+  client->output_len = 0;
+
+  client->feed_len = 0;
+  client->feed_need = 0;
+  client->feed_skip = 0;
 }
 
 void lwmqtt_set_network(lwmqtt_client_t *client, void *ref, lwmqtt_network_read_t read, lwmqtt_network_write_t write) {
@@ -49,20 +119,290 @@ void lwmqtt_set_callback(lwmqtt_client_t *client, void *ref, lwmqtt_callback_t c
   client->callback = cb;
 }
 
+void lwmqtt_set_response_callback(lwmqtt_client_t *client, void *ref, lwmqtt_response_callback_t cb) {
+  client->response_ref = ref;
+  client->response_callback = cb;
+}
+
 void lwmqtt_drop_overflow(lwmqtt_client_t *client, bool enabled, uint32_t *counter) {
   client->drop_overflow = enabled;
   client->overflow_counter = counter;
 }
 
-static uint16_t lwmqtt_get_next_packet_id(lwmqtt_client_t *client) {
+void lwmqtt_set_linger(lwmqtt_client_t *client, uint8_t *buf, size_t buf_size, void *timer, uint32_t linger) {
+  client->linger_buf = buf;
+  client->linger_buf_size = buf_size;
+  client->linger_len = 0;
+  client->linger_timer = timer;
+  client->linger = linger;
+}
+
+void lwmqtt_set_payload_transform(lwmqtt_client_t *client, void *ref, lwmqtt_transform_t encode,
+                                  lwmqtt_transform_t decode, uint8_t *buf, size_t buf_size) {
+  client->transform_ref = ref;
+  client->transform_encode = encode;
+  client->transform_decode = decode;
+  client->transform_buf = buf;
+  client->transform_buf_size = buf_size;
+}
+
+void lwmqtt_set_direct_payload(lwmqtt_client_t *client, size_t threshold, lwmqtt_network_write_t write) {
+  client->direct_threshold = threshold;
+  client->direct_write = write;
+}
+
+void lwmqtt_set_stats(lwmqtt_client_t *client, lwmqtt_stats_t *stats) { client->stats = stats; }
+
+void lwmqtt_stats_snapshot(lwmqtt_stats_t *stats, lwmqtt_stats_t *snapshot) {
+  // get counters
+  uint64_t *src = (uint64_t *)stats;
+  uint64_t *dst = (uint64_t *)snapshot;
+
+  // copy all counters
+  for (size_t i = 0; i < sizeof(lwmqtt_stats_t) / sizeof(uint64_t); i++) {
+#if defined(__GNUC__)
+    dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+#else
+    dst[i] = src[i];
+#endif
+  }
+}
+
+void lwmqtt_set_latency(lwmqtt_client_t *client, lwmqtt_latency_t *latency, void *ref, lwmqtt_clock_get_t get) {
+  client->latency = latency;
+  client->clock_ref = ref;
+  client->clock_get = get;
+}
+
+static void lwmqtt_mark_latency(lwmqtt_client_t *client, uint8_t *buf, size_t len) {
+  // return immediately if no latency object is attached
+  if (client->latency == NULL) {
+    return;
+  }
+
+  // remember send time of all packets in the buffer that are acknowledged
+  uint64_t now = client->clock_get(client->clock_ref);
+  uint8_t *ptr = buf;
+  uint8_t *end = buf + len;
+  while (ptr < end) {
+    // get packet type
+    int packet_type = ptr[0] >> 4;
+    if (packet_type == LWMQTT_PUBLISH_PACKET || packet_type == LWMQTT_SUBSCRIBE_PACKET ||
+        packet_type == LWMQTT_UNSUBSCRIBE_PACKET) {
+      client->command_sent = now;
+    } else if (packet_type == LWMQTT_PINGREQ_PACKET) {
+      client->ping_sent = now;
+    }
+
+    // skip packet
+    uint32_t rem_len;
+    ptr++;
+    if (lwmqtt_read_varnum(&ptr, end, &rem_len) != LWMQTT_SUCCESS) {
+      return;
+    }
+    ptr += rem_len;
+  }
+}
+
+static void lwmqtt_record_rtt(lwmqtt_client_t *client, lwmqtt_histogram_t *histogram, uint64_t sent) {
+  // calculate round-trip time
+  uint64_t rtt = client->clock_get(client->clock_ref) - sent;
+  if (rtt > UINT32_MAX) {
+    rtt = UINT32_MAX;
+  }
+
+  // record round-trip time
+  lwmqtt_histogram_record(histogram, (uint32_t)rtt);
+}
+
+static void lwmqtt_record_latency(lwmqtt_client_t *client, lwmqtt_packet_type_t packet_type) {
+  // return immediately if no latency object is attached
+  if (client->latency == NULL) {
+    return;
+  }
+
+  // leave publish acks to a batch that times its messages individually
+  if (client->batch_acks && (packet_type == LWMQTT_PUBACK_PACKET || packet_type == LWMQTT_PUBCOMP_PACKET)) {
+    return;
+  }
+
+  // select histogram and send time
+  lwmqtt_histogram_t *histogram;
+  uint64_t sent = client->command_sent;
+  switch (packet_type) {
+    case LWMQTT_PUBACK_PACKET:
+      histogram = &client->latency->publish_qos1;
+      break;
+    case LWMQTT_PUBCOMP_PACKET:
+      histogram = &client->latency->publish_qos2;
+      break;
+    case LWMQTT_SUBACK_PACKET:
+      histogram = &client->latency->subscribe;
+      break;
+    case LWMQTT_UNSUBACK_PACKET:
+      histogram = &client->latency->unsubscribe;
+      break;
+    case LWMQTT_PINGRESP_PACKET:
+      histogram = &client->latency->ping;
+      sent = client->ping_sent;
+      break;
+    default:
+      return;
+  }
+
+  // record round-trip time
+  lwmqtt_record_rtt(client, histogram, sent);
+}
+
+void lwmqtt_set_recorder(lwmqtt_client_t *client, lwmqtt_recorder_t *recorder) { client->recorder = recorder; }
+
+void lwmqtt_set_output(lwmqtt_client_t *client, uint8_t *buf, size_t buf_size) {
+  client->output_buf = buf;
+  client->output_buf_size = buf_size;
+  client->output_offset = 0;
+  client->output_len = 0;
+}
+
+void lwmqtt_pending_output(lwmqtt_client_t *client, uint8_t **buf, size_t *len) {
+  *buf = client->output_buf + client->output_offset;
+  *len = client->output_len;
+}
+
+void lwmqtt_consume_output(lwmqtt_client_t *client, size_t len) {
+  // limit length
+  if (len > client->output_len) {
+    len = client->output_len;
+  }
+
+  // advance output
+  client->output_offset += len;
+  client->output_len -= len;
+
+  // rewind if empty
+  if (client->output_len == 0) {
+    client->output_offset = 0;
+  }
+}
+
+static void lwmqtt_record_event(lwmqtt_recorder_t *recorder, lwmqtt_event_t event) {
+  // set time
+  if (recorder->clock_get != NULL) {
+    event.time = (uint32_t)recorder->clock_get(recorder->clock_ref);
+  }
+
+  // store event
+  uint32_t head = recorder->head;
+  recorder->events[head & recorder->mask] = event;
+
+  // publish event
+#if defined(__GNUC__)
+  __atomic_store_n(&recorder->head, head + 1, __ATOMIC_RELEASE);
+#else
+  recorder->head = head + 1;
+#endif
+}
+
+static void lwmqtt_record_packet(lwmqtt_client_t *client, lwmqtt_event_direction_t direction, uint8_t *buf,
+                                 size_t len) {
+  // return immediately if no recorder is attached
+  if (client->recorder == NULL) {
+    return;
+  }
+
+  // prepare event
+  lwmqtt_event_t event = {0, (uint32_t)len, 0, (uint8_t)direction, (uint8_t)(buf[0] >> 4), LWMQTT_SUCCESS};
+
+  // find variable header
+  uint8_t *ptr = buf + 1;
+  uint8_t *end = buf + len;
+  uint32_t rem_len;
+  if (lwmqtt_read_varnum(&ptr, end, &rem_len) == LWMQTT_SUCCESS) {
+    // skip topic of publish packets with a packet id if it is complete
+    bool has_id = event.packet_type >= LWMQTT_PUBACK_PACKET && event.packet_type <= LWMQTT_UNSUBACK_PACKET;
+    if (event.packet_type == LWMQTT_PUBLISH_PACKET && ((buf[0] >> 1) & 3) > 0 && end - ptr >= 2) {
+      size_t topic_len = (size_t)((ptr[0] << 8) | ptr[1]);
+      if ((size_t)(end - ptr) >= 2 + topic_len) {
+        ptr += 2 + topic_len;
+        has_id = true;
+      }
+    }
+
+    // read packet id
+    if (has_id && end - ptr >= 2) {
+      event.packet_id = (uint16_t)((ptr[0] << 8) | ptr[1]);
+    }
+  }
+
+  // remember last received packet type
+  if (direction == LWMQTT_EVENT_IN) {
+    client->recorder->last_type = event.packet_type;
+  }
+
+  // record event
+  lwmqtt_record_event(client->recorder, event);
+}
+
+static lwmqtt_err_t lwmqtt_track_error(lwmqtt_client_t *client, lwmqtt_err_t err) {
+  // ignore success and writes that are continued or retried later
+  if (err == LWMQTT_SUCCESS || err == LWMQTT_WOULD_BLOCK || err == LWMQTT_BUSY) {
+    return err;
+  }
+
+  // count error if it can be tracked
+  if (err < 0 && -err < LWMQTT_STATS_ERRORS) {
+    LWMQTT_STATS_ADD(client, errors[-err], 1);
+  }
+
+  // record error
+  if (client->recorder != NULL) {
+    lwmqtt_event_t event = {0, 0, 0, LWMQTT_EVENT_ERROR, client->recorder->last_type, err};
+    lwmqtt_record_event(client->recorder, event);
+  }
+
+  return err;
+}
+
+static void lwmqtt_trace_packets_out(lwmqtt_client_t *client, uint8_t *buf, size_t len) {
+  // return immediately if nothing is attached
+  if (client->stats == NULL && client->recorder == NULL && !LWMQTT_PROBE_ENABLED(packet__sent)) {
+    return;
+  }
+
+  // trace all packets in the buffer
+  uint8_t *ptr = buf;
+  uint8_t *end = buf + len;
+  while (ptr < end) {
+    // get packet type
+    uint8_t *start = ptr;
+    int packet_type = ptr[0] >> 4;
+
+    // skip packet
+    uint32_t rem_len;
+    ptr++;
+    if (lwmqtt_read_varnum(&ptr, end, &rem_len) != LWMQTT_SUCCESS) {
+      return;
+    }
+    ptr += rem_len;
+
+    // count, trace and record packet
+    LWMQTT_STATS_ADD(client, packets_out[packet_type], 1);
+    LWMQTT_PROBE2(packet__sent, packet_type, (size_t)(ptr - start));
+    lwmqtt_record_packet(client, LWMQTT_EVENT_OUT, start, (size_t)(ptr - start));
+  }
+}
+
+static uint16_t lwmqtt_peek_next_packet_id(lwmqtt_client_t *client) {
   // check overflow
   if (client->last_packet_id == 65535) {
-    client->last_packet_id = 1;
     return 1;
   }
 
+  return client->last_packet_id + 1;
+}
+
+static uint16_t lwmqtt_get_next_packet_id(lwmqtt_client_t *client) {
   // increment packet id
-  client->last_packet_id++;
+  client->last_packet_id = lwmqtt_peek_next_packet_id(client);
 
   return client->last_packet_id;
 }
@@ -81,17 +421,40 @@ static lwmqtt_err_t lwmqtt_read_from_network(lwmqtt_client_t *client, size_t off
     // check remaining time
     int32_t remaining_time = client->timer_get(client->command_timer);
     if (remaining_time <= 0) {
+      // waiting for the first byte of a packet is not a timeout
+      if (offset > 0 || read > 0) {
+        LWMQTT_STATS_ADD(client, timeouts, 1);
+        LWMQTT_PROBE1(timeout, 0);
+      }
+
       return LWMQTT_NETWORK_TIMEOUT;
     }
 
     // read
     size_t partial_read = 0;
+    LWMQTT_PROBE1(network__read__begin, len - read);
     lwmqtt_err_t err = client->network_read(client->network, client->read_buf + offset + read, len - read,
                                             &partial_read, (uint32_t)remaining_time);
-    if (err != LWMQTT_SUCCESS) {
+    LWMQTT_PROBE2(network__read__end, err, partial_read);
+    LWMQTT_STATS_ADD(client, read_calls, 1);
+    if (err == LWMQTT_NETWORK_TIMEOUT) {
+      // waiting for the first byte of a packet is not a timeout
+      if (offset > 0 || read > 0) {
+        LWMQTT_STATS_ADD(client, timeouts, 1);
+        LWMQTT_PROBE1(timeout, 0);
+      }
+
+      return err;
+    } else if (err != LWMQTT_SUCCESS) {
       return err;
     }
 
+    // update statistics
+    LWMQTT_STATS_ADD(client, bytes_in, partial_read);
+    if (partial_read < len - read) {
+      LWMQTT_STATS_ADD(client, partial_reads, 1);
+    }
+
     // increment counter
     read += partial_read;
   }
@@ -105,6 +468,8 @@ static lwmqtt_err_t lwmqtt_drain_network(lwmqtt_client_t *client, size_t amount)
     // check remaining time
     int32_t remaining_time = client->timer_get(client->command_timer);
     if (remaining_time <= 0) {
+      LWMQTT_STATS_ADD(client, timeouts, 1);
+      LWMQTT_PROBE1(timeout, 0);
       return LWMQTT_NETWORK_TIMEOUT;
     }
 
@@ -116,12 +481,21 @@ static lwmqtt_err_t lwmqtt_drain_network(lwmqtt_client_t *client, size_t amount)
 
     // read
     size_t partial_read = 0;
+    LWMQTT_PROBE1(network__read__begin, max_read);
     lwmqtt_err_t err =
         client->network_read(client->network, client->read_buf, max_read, &partial_read, (uint32_t)remaining_time);
+    LWMQTT_PROBE2(network__read__end, err, partial_read);
+    LWMQTT_STATS_ADD(client, read_calls, 1);
     if (err != LWMQTT_SUCCESS) {
       return err;
     }
 
+    // update statistics
+    LWMQTT_STATS_ADD(client, bytes_in, partial_read);
+    if (partial_read < max_read) {
+      LWMQTT_STATS_ADD(client, partial_reads, 1);
+    }
+
     // decrement counter
     amount -= partial_read;
   }
@@ -129,33 +503,153 @@ static lwmqtt_err_t lwmqtt_drain_network(lwmqtt_client_t *client, size_t amount)
   return LWMQTT_SUCCESS;
 }
 
-static lwmqtt_err_t lwmqtt_write_to_network(lwmqtt_client_t *client, size_t offset, size_t len) {
-  // prepare counter
-  size_t written = 0;
+static lwmqtt_err_t lwmqtt_write_to_output(lwmqtt_client_t *client, uint8_t *buf, size_t len) {
+  // move pending bytes to the front if the packet does not fit behind them
+  if (client->output_offset + client->output_len + len > client->output_buf_size && client->output_offset > 0) {
+    memmove(client->output_buf, client->output_buf + client->output_offset, client->output_len);
+    client->output_offset = 0;
+  }
+
+  // check output buffer capacity
+  if (client->output_offset + client->output_len + len > client->output_buf_size) {
+    return LWMQTT_BUFFER_TOO_SHORT;
+  }
+
+  // append packets
+  memcpy(client->output_buf + client->output_offset + client->output_len, buf, len);
+  client->output_len += len;
+
+  // update statistics
+  LWMQTT_STATS_ADD(client, bytes_out, len);
+
+  // count and trace written packets
+  lwmqtt_trace_packets_out(client, buf, len);
 
+  return LWMQTT_SUCCESS;
+}
+
+static lwmqtt_err_t lwmqtt_write_partial(lwmqtt_client_t *client) {
   // write while data is left
-  while (written < len) {
+  while (client->partial_offset < client->partial_len) {
     // check remaining time
     int32_t remaining_time = client->timer_get(client->command_timer);
     if (remaining_time <= 0) {
+      LWMQTT_STATS_ADD(client, timeouts, 1);
+      LWMQTT_PROBE1(timeout, 1);
       return LWMQTT_NETWORK_TIMEOUT;
     }
 
-    // write
+    // write, direct payloads with their own callback if set
+    size_t left = client->partial_len - client->partial_offset;
     size_t partial_write = 0;
-    lwmqtt_err_t err = client->network_write(client->network, client->write_buf + offset + written, len - written,
-                                             &partial_write, (uint32_t)remaining_time);
-    if (err != LWMQTT_SUCCESS) {
+    lwmqtt_network_write_t write = client->network_write;
+    if (client->partial_direct && client->direct_write != NULL) {
+      write = client->direct_write;
+    }
+    LWMQTT_PROBE1(network__write__begin, left);
+    lwmqtt_err_t err = write(client->network, client->partial_buf + client->partial_offset, left, &partial_write,
+                             (uint32_t)remaining_time);
+    LWMQTT_PROBE2(network__write__end, err, partial_write);
+    LWMQTT_STATS_ADD(client, write_calls, 1);
+    if (err != LWMQTT_SUCCESS && err != LWMQTT_WOULD_BLOCK) {
       return err;
     }
 
+    // update statistics
+    LWMQTT_STATS_ADD(client, bytes_out, partial_write);
+    if (partial_write < left) {
+      LWMQTT_STATS_ADD(client, partial_writes, 1);
+    }
+
     // increment counter
-    written += partial_write;
+    client->partial_offset += partial_write;
+
+    // keep the rest for the next flush if the network would block
+    if (err == LWMQTT_WOULD_BLOCK) {
+      LWMQTT_STATS_ADD(client, blocked_writes, 1);
+      return LWMQTT_WOULD_BLOCK;
+    }
+  }
+
+  // count and trace written packets, direct payloads have been traced with their header
+  if (!client->partial_direct) {
+    lwmqtt_trace_packets_out(client, client->partial_buf, client->partial_len);
+  }
+
+  // clear partial write
+  client->partial_buf = NULL;
+  client->partial_len = 0;
+  client->partial_offset = 0;
+  client->partial_direct = false;
+
+  return LWMQTT_SUCCESS;
+}
+
+static lwmqtt_err_t lwmqtt_write_to_network(lwmqtt_client_t *client, uint8_t *buf, size_t len) {
+  // queue packets in sans-io mode
+  if (client->output_buf != NULL) {
+    return lwmqtt_write_to_output(client, buf, len);
+  }
+
+  // start write
+  client->partial_buf = buf;
+  client->partial_len = len;
+  client->partial_offset = 0;
+
+  return lwmqtt_write_partial(client);
+}
+
+static lwmqtt_err_t lwmqtt_write_direct_to_network(lwmqtt_client_t *client, uint8_t *buf, size_t len) {
+  // start write of a payload that follows its already written header
+  client->partial_buf = buf;
+  client->partial_len = len;
+  client->partial_offset = 0;
+  client->partial_direct = true;
+
+  return lwmqtt_write_partial(client);
+}
+
+static lwmqtt_err_t lwmqtt_finish_write(lwmqtt_client_t *client) {
+  // write the rest of a partially written packet
+  if (client->partial_buf != NULL) {
+    lwmqtt_err_t err = lwmqtt_write_partial(client);
+    if (err != LWMQTT_SUCCESS) {
+      return err;
+    }
+  }
+
+  // write a packet that has been deferred in the write buffer
+  if (client->deferred_len > 0) {
+    size_t len = client->deferred_len;
+    client->deferred_len = 0;
+    lwmqtt_err_t err = lwmqtt_write_to_network(client, client->write_buf, len);
+    if (err != LWMQTT_SUCCESS) {
+      return err;
+    }
+  }
+
+  // write a payload that is pending behind its header
+  if (client->direct_len > 0) {
+    uint8_t *buf = client->direct_buf;
+    size_t len = client->direct_len;
+    client->direct_buf = NULL;
+    client->direct_len = 0;
+    return lwmqtt_write_direct_to_network(client, buf, len);
   }
 
   return LWMQTT_SUCCESS;
 }
 
+static lwmqtt_err_t lwmqtt_prepare_command(lwmqtt_client_t *client) {
+  // finish a partially written packet before a command sends its own
+  lwmqtt_err_t err = lwmqtt_finish_write(client);
+  if (err == LWMQTT_WOULD_BLOCK) {
+    return LWMQTT_BUSY;
+  }
+
+  return err;
+}
+
 static lwmqtt_err_t lwmqtt_read_packet_in_buffer(lwmqtt_client_t *client, size_t *read,
                                                  lwmqtt_packet_type_t *packet_type) {
   // preset packet type
@@ -216,6 +710,9 @@ static lwmqtt_err_t lwmqtt_read_packet_in_buffer(lwmqtt_client_t *client, size_t
       *client->overflow_counter += 1;
     }
 
+    // update statistics
+    LWMQTT_STATS_ADD(client, dropped_overflows, 1);
+
     return LWMQTT_SUCCESS;
   }
 
@@ -233,29 +730,186 @@ static lwmqtt_err_t lwmqtt_read_packet_in_buffer(lwmqtt_client_t *client, size_t
   return LWMQTT_SUCCESS;
 }
 
-static lwmqtt_err_t lwmqtt_send_packet_in_buffer(lwmqtt_client_t *client, size_t length) {
+static lwmqtt_err_t lwmqtt_flush_linger_buffer(lwmqtt_client_t *client) {
+  // return immediately if nothing is buffered
+  if (client->linger_len == 0) {
+    return LWMQTT_SUCCESS;
+  }
+
   // write to network
-  lwmqtt_err_t err = lwmqtt_write_to_network(client, 0, length);
-  if (err != LWMQTT_SUCCESS) {
+  lwmqtt_err_t err = lwmqtt_write_to_network(client, client->linger_buf, client->linger_len);
+  if (err != LWMQTT_SUCCESS && err != LWMQTT_WOULD_BLOCK) {
     return err;
   }
 
+  // reset buffer
+  client->linger_len = 0;
+
   // reset keep alive timer
   client->timer_set(client->keep_alive_timer, client->keep_alive_interval);
 
+  return err;
+}
+
+static lwmqtt_err_t lwmqtt_check_linger_deadline(lwmqtt_client_t *client) {
+  // flush buffer if the deadline has been reached
+  if (client->linger_len > 0 && client->timer_get(client->linger_timer) <= 0) {
+    return lwmqtt_flush_linger_buffer(client);
+  }
+
   return LWMQTT_SUCCESS;
 }
 
-static lwmqtt_err_t lwmqtt_cycle(lwmqtt_client_t *client, size_t *read, lwmqtt_packet_type_t *packet_type) {
-  // read next packet from the network
-  lwmqtt_err_t err = lwmqtt_read_packet_in_buffer(client, read, packet_type);
-  if (err != LWMQTT_SUCCESS) {
+static lwmqtt_err_t lwmqtt_send_packet_in_buffer(lwmqtt_client_t *client, size_t length) {
+  // remember send time
+  lwmqtt_mark_latency(client, client->write_buf, length);
+
+  // send buffered packets together with this packet if it fits
+  if (client->linger_len > 0 && client->linger_len + length <= client->linger_buf_size) {
+    memcpy(client->linger_buf + client->linger_len, client->write_buf, length);
+    client->linger_len += length;
+
+    return lwmqtt_flush_linger_buffer(client);
+  }
+
+  // otherwise flush buffered packets first
+  lwmqtt_err_t err = lwmqtt_flush_linger_buffer(client);
+  if (err == LWMQTT_WOULD_BLOCK) {
+    client->deferred_len = length;
     return err;
-  } else if (*packet_type == LWMQTT_NO_PACKET) {
-    return LWMQTT_SUCCESS;
+  } else if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // write to network
+  err = lwmqtt_write_to_network(client, client->write_buf, length);
+  if (err != LWMQTT_SUCCESS && err != LWMQTT_WOULD_BLOCK) {
+    return err;
+  }
+
+  // reset keep alive timer
+  client->timer_set(client->keep_alive_timer, client->keep_alive_interval);
+
+  return err;
+}
+
+static lwmqtt_err_t lwmqtt_send_packet_with_payload(lwmqtt_client_t *client, size_t length, uint8_t *payload,
+                                                    size_t payload_len) {
+  // send header
+  lwmqtt_err_t err = lwmqtt_send_packet_in_buffer(client, length);
+  if (err == LWMQTT_WOULD_BLOCK) {
+    client->direct_buf = payload;
+    client->direct_len = payload_len;
+    return err;
+  } else if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // write payload from the message
+  return lwmqtt_write_direct_to_network(client, payload, payload_len);
+}
+
+static bool lwmqtt_use_direct_payload(lwmqtt_client_t *client, lwmqtt_message_t message) {
+  // write large payloads directly unless they are transformed or queued
+  return client->direct_threshold > 0 && message.payload_len >= client->direct_threshold &&
+         client->transform_encode == NULL && client->output_buf == NULL;
+}
+
+static lwmqtt_err_t lwmqtt_linger_packet_in_buffer(lwmqtt_client_t *client, size_t length) {
+  // send packet immediately if lingering is disabled or the packet is too big
+  if (client->linger_buf == NULL || length > client->linger_buf_size) {
+    return lwmqtt_send_packet_in_buffer(client, length);
+  }
+
+  // flush buffer if the packet does not fit anymore
+  if (client->linger_len + length > client->linger_buf_size) {
+    lwmqtt_err_t err = lwmqtt_flush_linger_buffer(client);
+    if (err == LWMQTT_WOULD_BLOCK) {
+      client->deferred_len = length;
+      return err;
+    } else if (err != LWMQTT_SUCCESS) {
+      return err;
+    }
+  }
+
+  // start linger timer with the first packet
+  if (client->linger_len == 0) {
+    client->timer_set(client->linger_timer, client->linger);
+  }
+
+  // append packet
+  memcpy(client->linger_buf + client->linger_len, client->write_buf, length);
+  client->linger_len += length;
+
+  // flush buffer if it is full or the deadline has been reached
+  if (client->linger_len == client->linger_buf_size || client->timer_get(client->linger_timer) <= 0) {
+    return lwmqtt_flush_linger_buffer(client);
+  }
+
+  return LWMQTT_SUCCESS;
+}
+
+static void lwmqtt_report_response(lwmqtt_client_t *client, uint8_t *buf, size_t buf_len,
+                                   lwmqtt_packet_type_t packet_type) {
+  // return immediately if no callback is set
+  if (client->response_callback == NULL) {
+    return;
+  }
+
+  // prepare response
+  lwmqtt_response_t response = {packet_type, 0, false, LWMQTT_UNKNOWN_RETURN_CODE, NULL, 0};
+
+  // decode response
+  bool dup;
+  switch (packet_type) {
+    case LWMQTT_CONNACK_PACKET:
+      lwmqtt_decode_connack(buf, buf_len, &response.session_present, &response.return_code);
+      break;
+    case LWMQTT_PUBACK_PACKET:
+    case LWMQTT_PUBREC_PACKET:
+    case LWMQTT_PUBCOMP_PACKET:
+    case LWMQTT_UNSUBACK_PACKET:
+      lwmqtt_decode_ack(buf, buf_len, packet_type, &dup, &response.packet_id);
+      break;
+    case LWMQTT_SUBACK_PACKET: {
+      // read packet id and point to the granted qos levels
+      uint8_t *ptr = buf + 1;
+      uint8_t *end = buf + buf_len;
+      uint32_t rem_len;
+      if (lwmqtt_read_varnum(&ptr, end, &rem_len) == LWMQTT_SUCCESS &&
+          lwmqtt_read_num(&ptr, end, &response.packet_id) == LWMQTT_SUCCESS) {
+        response.granted_qos = ptr;
+        response.granted_count = (size_t)(end - ptr);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+
+  // call callback
+  client->response_callback(client, client->response_ref, response);
+}
+
+static lwmqtt_err_t lwmqtt_handle_packet(lwmqtt_client_t *client, uint8_t *buf, size_t buf_len,
+                                         lwmqtt_packet_type_t packet_type) {
+  // count, trace and record packet
+  LWMQTT_STATS_ADD(client, packets_in[packet_type], 1);
+  LWMQTT_PROBE2(packet__received, packet_type, buf_len);
+  lwmqtt_record_packet(client, LWMQTT_EVENT_IN, buf, buf_len);
+
+  // record round-trip time of acks
+  lwmqtt_record_latency(client, packet_type);
+
+  // report responses
+  if (packet_type != LWMQTT_PUBLISH_PACKET) {
+    lwmqtt_report_response(client, buf, buf_len, packet_type);
   }
 
-  switch (*packet_type) {
+  // prepare error
+  lwmqtt_err_t err;
+
+  switch (packet_type) {
     // handle publish packets
     case LWMQTT_PUBLISH_PACKET: {
       // decode publish packet
@@ -263,14 +917,33 @@ static lwmqtt_err_t lwmqtt_cycle(lwmqtt_client_t *client, size_t *read, lwmqtt_p
       uint16_t packet_id;
       lwmqtt_string_t topic;
       lwmqtt_message_t msg;
-      err = lwmqtt_decode_publish(client->read_buf, client->read_buf_size, &dup, &packet_id, &topic, &msg);
+      err = lwmqtt_decode_publish(buf, buf_len, &dup, &packet_id, &topic, &msg);
       if (err != LWMQTT_SUCCESS) {
         return err;
       }
 
+      // transform payload if enabled
+      if (client->transform_decode != NULL) {
+        size_t payload_len = 0;
+        bool transformed = false;
+        err = client->transform_decode(client->transform_ref, msg.payload, msg.payload_len, client->transform_buf,
+                                       client->transform_buf_size, &payload_len, &transformed);
+        if (err != LWMQTT_SUCCESS) {
+          return err;
+        }
+
+        // use transformed payload
+        if (transformed) {
+          msg.payload = client->transform_buf;
+          msg.payload_len = payload_len;
+        }
+      }
+
       // call callback if set
       if (client->callback != NULL) {
+        LWMQTT_PROBE2(callback__entry, topic.len, msg.payload_len);
         client->callback(client, client->callback_ref, topic, msg);
+        LWMQTT_PROBE(callback__return);
       }
 
       // break early on qos zero
@@ -293,8 +966,8 @@ static lwmqtt_err_t lwmqtt_cycle(lwmqtt_client_t *client, size_t *read, lwmqtt_p
         return err;
       }
 
-      // send ack packet
-      err = lwmqtt_send_packet_in_buffer(client, len);
+      // send or linger ack packet
+      err = lwmqtt_linger_packet_in_buffer(client, len);
       if (err != LWMQTT_SUCCESS) {
         return err;
       }
@@ -307,7 +980,7 @@ static lwmqtt_err_t lwmqtt_cycle(lwmqtt_client_t *client, size_t *read, lwmqtt_p
       // decode pubrec packet
       bool dup;
       uint16_t packet_id;
-      err = lwmqtt_decode_ack(client->read_buf, client->read_buf_size, LWMQTT_PUBREC_PACKET, &dup, &packet_id);
+      err = lwmqtt_decode_ack(buf, buf_len, LWMQTT_PUBREC_PACKET, &dup, &packet_id);
       if (err != LWMQTT_SUCCESS) {
         return err;
       }
@@ -333,7 +1006,7 @@ static lwmqtt_err_t lwmqtt_cycle(lwmqtt_client_t *client, size_t *read, lwmqtt_p
       // decode pubrec packet
       bool dup;
       uint16_t packet_id;
-      err = lwmqtt_decode_ack(client->read_buf, client->read_buf_size, LWMQTT_PUBREL_PACKET, &dup, &packet_id);
+      err = lwmqtt_decode_ack(buf, buf_len, LWMQTT_PUBREL_PACKET, &dup, &packet_id);
       if (err != LWMQTT_SUCCESS) {
         return err;
       }
@@ -345,8 +1018,8 @@ static lwmqtt_err_t lwmqtt_cycle(lwmqtt_client_t *client, size_t *read, lwmqtt_p
         return err;
       }
 
-      // send pubcomp packet
-      err = lwmqtt_send_packet_in_buffer(client, len);
+      // send or linger pubcomp packet
+      err = lwmqtt_linger_packet_in_buffer(client, len);
       if (err != LWMQTT_SUCCESS) {
         return err;
       }
@@ -369,6 +1042,28 @@ static lwmqtt_err_t lwmqtt_cycle(lwmqtt_client_t *client, size_t *read, lwmqtt_p
   return LWMQTT_SUCCESS;
 }
 
+static lwmqtt_err_t lwmqtt_cycle(lwmqtt_client_t *client, size_t *read, lwmqtt_packet_type_t *packet_type) {
+  // remember read counter
+  size_t offset = *read;
+
+  // finish a partially written packet before reading more
+  lwmqtt_err_t err = lwmqtt_finish_write(client);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // read next packet from the network
+  err = lwmqtt_read_packet_in_buffer(client, read, packet_type);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  } else if (*packet_type == LWMQTT_NO_PACKET) {
+    return LWMQTT_SUCCESS;
+  }
+
+  // handle packet
+  return lwmqtt_handle_packet(client, client->read_buf, *read - offset, *packet_type);
+}
+
 static lwmqtt_err_t lwmqtt_cycle_until(lwmqtt_client_t *client, lwmqtt_packet_type_t *packet_type, size_t available,
                                        lwmqtt_packet_type_t needle) {
   // prepare counter
@@ -378,6 +1073,10 @@ static lwmqtt_err_t lwmqtt_cycle_until(lwmqtt_client_t *client, lwmqtt_packet_ty
   do {
     // do one cycle
     lwmqtt_err_t err = lwmqtt_cycle(client, &read, packet_type);
+    if (err == LWMQTT_WOULD_BLOCK && needle != LWMQTT_NO_PACKET) {
+      // a blocked reply does not fail a sent command, it is retried while waiting for the ack
+      err = LWMQTT_SUCCESS;
+    }
     if (err != LWMQTT_SUCCESS) {
       return err;
     }
@@ -396,53 +1095,243 @@ static lwmqtt_err_t lwmqtt_cycle_until(lwmqtt_client_t *client, lwmqtt_packet_ty
   return LWMQTT_SUCCESS;
 }
 
-lwmqtt_err_t lwmqtt_yield(lwmqtt_client_t *client, size_t available, uint32_t timeout) {
+static lwmqtt_err_t lwmqtt_do_yield(lwmqtt_client_t *client, size_t available, uint32_t timeout) {
   // set command timer
   client->timer_set(client->command_timer, timeout);
 
+  // finish a partially written packet
+  lwmqtt_err_t err = lwmqtt_finish_write(client);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // flush lingering packets if their deadline has been reached
+  err = lwmqtt_check_linger_deadline(client);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
   // cycle until timeout has been reached
   lwmqtt_packet_type_t packet_type = LWMQTT_NO_PACKET;
-  lwmqtt_err_t err = lwmqtt_cycle_until(client, &packet_type, available, LWMQTT_NO_PACKET);
+  err = lwmqtt_cycle_until(client, &packet_type, available, LWMQTT_NO_PACKET);
   if (err != LWMQTT_SUCCESS) {
     return err;
   }
 
-  return LWMQTT_SUCCESS;
+  // flush all lingering packets
+  if (client->linger_len > 0) {
+    // renew command timer if it has been exhausted by the cycle
+    if (client->timer_get(client->command_timer) <= 0) {
+      client->timer_set(client->command_timer, timeout);
+    }
+
+    err = lwmqtt_flush_linger_buffer(client);
+    if (err != LWMQTT_SUCCESS) {
+      return err;
+    }
+  }
+
+  return LWMQTT_SUCCESS;
 }
 
-lwmqtt_err_t lwmqtt_connect(lwmqtt_client_t *client, lwmqtt_options_t options, lwmqtt_will_t *will,
-                            lwmqtt_return_code_t *return_code, uint32_t timeout) {
-  // set command timer
-  client->timer_set(client->command_timer, timeout);
+lwmqtt_err_t lwmqtt_yield(lwmqtt_client_t *client, size_t available, uint32_t timeout) {
+  return lwmqtt_track_error(client, lwmqtt_do_yield(client, available, timeout));
+}
 
-  // save keep alive interval
-  client->keep_alive_interval = (uint32_t)(options.keep_alive) * 1000;
+static lwmqtt_err_t lwmqtt_feed_byte(lwmqtt_client_t *client, uint8_t byte) {
+  // check read buffer capacity
+  if (client->feed_len >= client->read_buf_size) {
+    return LWMQTT_BUFFER_TOO_SHORT;
+  }
 
-  // set keep alive timer
-  client->timer_set(client->keep_alive_timer, client->keep_alive_interval);
+  // append byte
+  client->read_buf[client->feed_len++] = byte;
 
-  // reset pong pending flag
-  client->pong_pending = false;
+  // check packet type of the first byte
+  lwmqtt_packet_type_t packet_type;
+  if (client->feed_len == 1) {
+    lwmqtt_err_t err = lwmqtt_detect_packet_type(client->read_buf, 1, &packet_type);
+    if (err != LWMQTT_SUCCESS) {
+      return err;
+    }
 
-  // initialize return code
-  *return_code = LWMQTT_UNKNOWN_RETURN_CODE;
+    return LWMQTT_SUCCESS;
+  }
 
-  // encode connect packet
-  size_t len;
-  lwmqtt_err_t err = lwmqtt_encode_connect(client->write_buf, client->write_buf_size, &len, options, will);
+  // attempt to detect remaining length
+  uint32_t rem_len;
+  lwmqtt_err_t err = lwmqtt_detect_remaining_length(client->read_buf + 1, client->feed_len - 1, &rem_len);
+  if (err == LWMQTT_BUFFER_TOO_SHORT) {
+    return LWMQTT_SUCCESS;
+  } else if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // set packet length
+  client->feed_need = client->feed_len + rem_len;
+
+  // handle overflow
+  if (client->feed_need > client->read_buf_size) {
+    // fail if packets should not be dropped
+    if (!client->drop_overflow) {
+      return LWMQTT_BUFFER_TOO_SHORT;
+    }
+
+    // skip packet
+    client->feed_skip = rem_len;
+    client->feed_len = 0;
+    client->feed_need = 0;
+
+    // increment if counter is available
+    if (client->overflow_counter != NULL) {
+      *client->overflow_counter += 1;
+    }
+
+    // update statistics
+    LWMQTT_STATS_ADD(client, dropped_overflows, 1);
+  }
+
+  return LWMQTT_SUCCESS;
+}
+
+static lwmqtt_err_t lwmqtt_do_feed(lwmqtt_client_t *client, uint8_t *data, size_t len) {
+  // process all data
+  while (len > 0) {
+    // skip the rest of a dropped packet
+    if (client->feed_skip > 0) {
+      size_t skip = len < client->feed_skip ? len : client->feed_skip;
+      client->feed_skip -= skip;
+      data += skip;
+      len -= skip;
+      continue;
+    }
+
+    // handle complete packets directly from the data
+    if (client->feed_len == 0) {
+      // detect packet type
+      lwmqtt_packet_type_t packet_type;
+      lwmqtt_err_t err = lwmqtt_detect_packet_type(data, len, &packet_type);
+      if (err != LWMQTT_SUCCESS) {
+        return err;
+      }
+
+      // detect remaining length
+      uint8_t *ptr = data + 1;
+      uint32_t rem_len = 0;
+      err = lwmqtt_read_varnum(&ptr, data + len, &rem_len);
+      if (err == LWMQTT_VARNUM_OVERFLOW) {
+        return LWMQTT_REMAINING_LENGTH_OVERFLOW;
+      }
+
+      // handle packet if complete
+      size_t packet_len = (size_t)(ptr - data) + rem_len;
+      if (err == LWMQTT_SUCCESS && packet_len <= len) {
+        err = lwmqtt_handle_packet(client, data, packet_len, packet_type);
+        if (err != LWMQTT_SUCCESS) {
+          return err;
+        }
+
+        data += packet_len;
+        len -= packet_len;
+        continue;
+      }
+    }
+
+    // assemble header byte by byte or copy as much of the body as possible
+    if (client->feed_need == 0) {
+      lwmqtt_err_t err = lwmqtt_feed_byte(client, *data);
+      if (err != LWMQTT_SUCCESS) {
+        return err;
+      }
+
+      data++;
+      len--;
+    } else {
+      size_t copy = client->feed_need - client->feed_len;
+      if (copy > len) {
+        copy = len;
+      }
+
+      memcpy(client->read_buf + client->feed_len, data, copy);
+      client->feed_len += copy;
+      data += copy;
+      len -= copy;
+    }
+
+    // handle packet if complete
+    if (client->feed_need > 0 && client->feed_len == client->feed_need) {
+      // reset state
+      size_t packet_len = client->feed_len;
+      client->feed_len = 0;
+      client->feed_need = 0;
+
+      // handle packet
+      lwmqtt_packet_type_t packet_type;
+      lwmqtt_detect_packet_type(client->read_buf, packet_len, &packet_type);
+      lwmqtt_err_t err = lwmqtt_handle_packet(client, client->read_buf, packet_len, packet_type);
+      if (err != LWMQTT_SUCCESS) {
+        return err;
+      }
+    }
+  }
+
+  return LWMQTT_SUCCESS;
+}
+
+lwmqtt_err_t lwmqtt_feed(lwmqtt_client_t *client, uint8_t *data, size_t len) {
+  return lwmqtt_track_error(client, lwmqtt_do_feed(client, data, len));
+}
+
+static lwmqtt_err_t lwmqtt_do_flush(lwmqtt_client_t *client, uint32_t timeout) {
+  // set command timer
+  client->timer_set(client->command_timer, timeout);
+
+  // finish a partially written packet
+  lwmqtt_err_t err = lwmqtt_finish_write(client);
   if (err != LWMQTT_SUCCESS) {
     return err;
   }
 
-  // send packet
-  err = lwmqtt_send_packet_in_buffer(client, len);
+  // flush lingering packets
+  err = lwmqtt_flush_linger_buffer(client);
   if (err != LWMQTT_SUCCESS) {
     return err;
   }
 
+  return LWMQTT_SUCCESS;
+}
+
+lwmqtt_err_t lwmqtt_flush(lwmqtt_client_t *client, uint32_t timeout) {
+  return lwmqtt_track_error(client, lwmqtt_do_flush(client, timeout));
+}
+
+static void lwmqtt_reset_session(lwmqtt_client_t *client, lwmqtt_options_t options) {
+  // save keep alive interval
+  client->keep_alive_interval = (uint32_t)(options.keep_alive) * 1000;
+
+  // set keep alive timer
+  client->timer_set(client->keep_alive_timer, client->keep_alive_interval);
+
+  // reset pong pending flag
+  client->pong_pending = false;
+
+  // drop partial writes of a previous connection
+  client->partial_buf = NULL;
+  client->partial_len = 0;
+  client->partial_offset = 0;
+  client->partial_direct = false;
+  client->deferred_len = 0;
+  client->direct_buf = NULL;
+  client->direct_len = 0;
+
+  // drop lingering packets of a previous connection
+  client->linger_len = 0;
+}
+
+static lwmqtt_err_t lwmqtt_await_connack(lwmqtt_client_t *client, lwmqtt_return_code_t *return_code) {
   // wait for connack packet
   lwmqtt_packet_type_t packet_type = LWMQTT_NO_PACKET;
-  err = lwmqtt_cycle_until(client, &packet_type, 0, LWMQTT_CONNACK_PACKET);
+  lwmqtt_err_t err = lwmqtt_cycle_until(client, &packet_type, 0, LWMQTT_CONNACK_PACKET);
   if (err != LWMQTT_SUCCESS) {
     return err;
   } else if (packet_type != LWMQTT_CONNACK_PACKET) {
@@ -464,28 +1353,10 @@ lwmqtt_err_t lwmqtt_connect(lwmqtt_client_t *client, lwmqtt_options_t options, l
   return LWMQTT_SUCCESS;
 }
 
-lwmqtt_err_t lwmqtt_subscribe(lwmqtt_client_t *client, int count, lwmqtt_string_t *topic_filter, lwmqtt_qos_t *qos,
-                              uint32_t timeout) {
-  // set command timer
-  client->timer_set(client->command_timer, timeout);
-
-  // encode subscribe packet
-  size_t len;
-  lwmqtt_err_t err = lwmqtt_encode_subscribe(client->write_buf, client->write_buf_size, &len,
-                                             lwmqtt_get_next_packet_id(client), count, topic_filter, qos);
-  if (err != LWMQTT_SUCCESS) {
-    return err;
-  }
-
-  // send packet
-  err = lwmqtt_send_packet_in_buffer(client, len);
-  if (err != LWMQTT_SUCCESS) {
-    return err;
-  }
-
+static lwmqtt_err_t lwmqtt_await_suback(lwmqtt_client_t *client, int count) {
   // wait for suback packet
   lwmqtt_packet_type_t packet_type = LWMQTT_NO_PACKET;
-  err = lwmqtt_cycle_until(client, &packet_type, 0, LWMQTT_SUBACK_PACKET);
+  lwmqtt_err_t err = lwmqtt_cycle_until(client, &packet_type, 0, LWMQTT_SUBACK_PACKET);
   if (err != LWMQTT_SUCCESS) {
     return err;
   } else if (packet_type != LWMQTT_SUBACK_PACKET) {
@@ -511,19 +1382,156 @@ lwmqtt_err_t lwmqtt_subscribe(lwmqtt_client_t *client, int count, lwmqtt_string_
   return LWMQTT_SUCCESS;
 }
 
+static lwmqtt_err_t lwmqtt_do_connect(lwmqtt_client_t *client, lwmqtt_options_t options, lwmqtt_will_t *will,
+                                      lwmqtt_return_code_t *return_code, uint32_t timeout) {
+  // set command timer
+  client->timer_set(client->command_timer, timeout);
+
+  // reset session state
+  lwmqtt_reset_session(client, options);
+
+  // initialize return code
+  *return_code = LWMQTT_UNKNOWN_RETURN_CODE;
+
+  // encode connect packet
+  size_t len;
+  lwmqtt_err_t err = lwmqtt_encode_connect(client->write_buf, client->write_buf_size, &len, options, will);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // send packet
+  err = lwmqtt_send_packet_in_buffer(client, len);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // return immediately in sans-IO mode
+  if (client->output_buf != NULL) {
+    return LWMQTT_SUCCESS;
+  }
+
+  return lwmqtt_await_connack(client, return_code);
+}
+
+lwmqtt_err_t lwmqtt_connect(lwmqtt_client_t *client, lwmqtt_options_t options, lwmqtt_will_t *will,
+                            lwmqtt_return_code_t *return_code, uint32_t timeout) {
+  return lwmqtt_track_error(client, lwmqtt_do_connect(client, options, will, return_code, timeout));
+}
+
+static lwmqtt_err_t lwmqtt_do_connect_and_subscribe(lwmqtt_client_t *client, lwmqtt_options_t options,
+                                                    lwmqtt_will_t *will, lwmqtt_return_code_t *return_code, int count,
+                                                    lwmqtt_string_t *topic_filter, lwmqtt_qos_t *qos,
+                                                    uint32_t timeout) {
+  // set command timer
+  client->timer_set(client->command_timer, timeout);
+
+  // reset session state
+  lwmqtt_reset_session(client, options);
+
+  // initialize return code
+  *return_code = LWMQTT_UNKNOWN_RETURN_CODE;
+
+  // encode connect packet
+  size_t connect_len;
+  lwmqtt_err_t err = lwmqtt_encode_connect(client->write_buf, client->write_buf_size, &connect_len, options, will);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // encode subscribe packet behind the connect packet
+  size_t subscribe_len;
+  err = lwmqtt_encode_subscribe(client->write_buf + connect_len, client->write_buf_size - connect_len, &subscribe_len,
+                                lwmqtt_get_next_packet_id(client), count, topic_filter, qos);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // send both packets at once
+  err = lwmqtt_send_packet_in_buffer(client, connect_len + subscribe_len);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // return immediately in sans-IO mode
+  if (client->output_buf != NULL) {
+    return LWMQTT_SUCCESS;
+  }
+
+  // wait for connack packet
+  err = lwmqtt_await_connack(client, return_code);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  return lwmqtt_await_suback(client, count);
+}
+
+lwmqtt_err_t lwmqtt_connect_and_subscribe(lwmqtt_client_t *client, lwmqtt_options_t options, lwmqtt_will_t *will,
+                                          lwmqtt_return_code_t *return_code, int count, lwmqtt_string_t *topic_filter,
+                                          lwmqtt_qos_t *qos, uint32_t timeout) {
+  return lwmqtt_track_error(client, lwmqtt_do_connect_and_subscribe(client, options, will, return_code, count,
+                                                                    topic_filter, qos, timeout));
+}
+
+static lwmqtt_err_t lwmqtt_do_subscribe(lwmqtt_client_t *client, int count, lwmqtt_string_t *topic_filter,
+                                        lwmqtt_qos_t *qos, uint32_t timeout) {
+  // set command timer
+  client->timer_set(client->command_timer, timeout);
+
+  // finish a partially written packet, the command is rejected if it would block
+  lwmqtt_err_t err = lwmqtt_prepare_command(client);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // encode subscribe packet
+  size_t len;
+  err = lwmqtt_encode_subscribe(client->write_buf, client->write_buf_size, &len, lwmqtt_get_next_packet_id(client),
+                                count, topic_filter, qos);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // send packet
+  err = lwmqtt_send_packet_in_buffer(client, len);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // return immediately in sans-IO mode
+  if (client->output_buf != NULL) {
+    return LWMQTT_SUCCESS;
+  }
+
+  return lwmqtt_await_suback(client, count);
+}
+
+lwmqtt_err_t lwmqtt_subscribe(lwmqtt_client_t *client, int count, lwmqtt_string_t *topic_filter, lwmqtt_qos_t *qos,
+                              uint32_t timeout) {
+  return lwmqtt_track_error(client, lwmqtt_do_subscribe(client, count, topic_filter, qos, timeout));
+}
+
 lwmqtt_err_t lwmqtt_subscribe_one(lwmqtt_client_t *client, lwmqtt_string_t topic_filter, lwmqtt_qos_t qos,
                                   uint32_t timeout) {
   return lwmqtt_subscribe(client, 1, &topic_filter, &qos, timeout);
 }
 
-lwmqtt_err_t lwmqtt_unsubscribe(lwmqtt_client_t *client, int count, lwmqtt_string_t *topic_filter, uint32_t timeout) {
+static lwmqtt_err_t lwmqtt_do_unsubscribe(lwmqtt_client_t *client, int count, lwmqtt_string_t *topic_filter,
+                                          uint32_t timeout) {
   // set command timer
   client->timer_set(client->command_timer, timeout);
 
+  // finish a partially written packet, the command is rejected if it would block
+  lwmqtt_err_t err = lwmqtt_prepare_command(client);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
   // encode unsubscribe packet
   size_t len;
-  lwmqtt_err_t err = lwmqtt_encode_unsubscribe(client->write_buf, client->write_buf_size, &len,
-                                               lwmqtt_get_next_packet_id(client), count, topic_filter);
+  err = lwmqtt_encode_unsubscribe(client->write_buf, client->write_buf_size, &len, lwmqtt_get_next_packet_id(client),
+                                  count, topic_filter);
   if (err != LWMQTT_SUCCESS) {
     return err;
   }
@@ -534,6 +1542,11 @@ lwmqtt_err_t lwmqtt_unsubscribe(lwmqtt_client_t *client, int count, lwmqtt_strin
     return err;
   }
 
+  // return immediately in sans-IO mode
+  if (client->output_buf != NULL) {
+    return LWMQTT_SUCCESS;
+  }
+
   // wait for unsuback packet
   lwmqtt_packet_type_t packet_type = LWMQTT_NO_PACKET;
   err = lwmqtt_cycle_until(client, &packet_type, 0, LWMQTT_UNSUBACK_PACKET);
@@ -554,37 +1567,63 @@ lwmqtt_err_t lwmqtt_unsubscribe(lwmqtt_client_t *client, int count, lwmqtt_strin
   return LWMQTT_SUCCESS;
 }
 
+lwmqtt_err_t lwmqtt_unsubscribe(lwmqtt_client_t *client, int count, lwmqtt_string_t *topic_filter, uint32_t timeout) {
+  return lwmqtt_track_error(client, lwmqtt_do_unsubscribe(client, count, topic_filter, timeout));
+}
+
 lwmqtt_err_t lwmqtt_unsubscribe_one(lwmqtt_client_t *client, lwmqtt_string_t topic_filter, uint32_t timeout) {
   return lwmqtt_unsubscribe(client, 1, &topic_filter, timeout);
 }
 
-lwmqtt_err_t lwmqtt_publish(lwmqtt_client_t *client, lwmqtt_string_t topic, lwmqtt_message_t message,
-                            uint32_t timeout) {
+static lwmqtt_err_t lwmqtt_do_publish(lwmqtt_client_t *client, lwmqtt_string_t topic, lwmqtt_message_t message,
+                                      uint32_t timeout) {
   // set command timer
   client->timer_set(client->command_timer, timeout);
 
+  // finish a partially written packet, the command is rejected if it would block
+  lwmqtt_err_t err = lwmqtt_prepare_command(client);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
   // add packet id if at least qos 1
   uint16_t packet_id = 0;
   if (message.qos == LWMQTT_QOS1 || message.qos == LWMQTT_QOS2) {
     packet_id = lwmqtt_get_next_packet_id(client);
   }
 
-  // encode publish packet
+  // check if the payload is written directly
+  bool direct = lwmqtt_use_direct_payload(client, message);
+
+  // encode publish packet or only its header
   size_t len = 0;
-  lwmqtt_err_t err =
-      lwmqtt_encode_publish(client->write_buf, client->write_buf_size, &len, 0, packet_id, topic, message);
+  if (direct) {
+    err = lwmqtt_encode_publish_header(client->write_buf, client->write_buf_size, &len, 0, packet_id, topic, message);
+  } else {
+    err = lwmqtt_encode_publish_transformed(client->write_buf, client->write_buf_size, &len, 0, packet_id, topic,
+                                            message, client->transform_encode, client->transform_ref);
+  }
   if (err != LWMQTT_SUCCESS) {
     return err;
   }
 
+  // linger packet on qos zero
+  if (message.qos == LWMQTT_QOS0 && !direct) {
+    return lwmqtt_linger_packet_in_buffer(client, len);
+  }
+
   // send packet
-  err = lwmqtt_send_packet_in_buffer(client, len);
+  if (direct) {
+    err = lwmqtt_send_packet_with_payload(client, len, message.payload, message.payload_len);
+  } else {
+    err = lwmqtt_send_packet_in_buffer(client, len);
+  }
   if (err != LWMQTT_SUCCESS) {
     return err;
   }
 
-  // immediately return on qos zero
-  if (message.qos == LWMQTT_QOS0) {
+  // return immediately in sans-IO mode or if no ack is expected
+  if (client->output_buf != NULL || message.qos == LWMQTT_QOS0) {
     return LWMQTT_SUCCESS;
   }
 
@@ -615,13 +1654,252 @@ lwmqtt_err_t lwmqtt_publish(lwmqtt_client_t *client, lwmqtt_string_t topic, lwmq
   return LWMQTT_SUCCESS;
 }
 
-lwmqtt_err_t lwmqtt_disconnect(lwmqtt_client_t *client, uint32_t timeout) {
+lwmqtt_err_t lwmqtt_publish(lwmqtt_client_t *client, lwmqtt_string_t topic, lwmqtt_message_t message,
+                            uint32_t timeout) {
+  return lwmqtt_track_error(client, lwmqtt_do_publish(client, topic, message, timeout));
+}
+
+static lwmqtt_err_t lwmqtt_await_batch_acks(lwmqtt_client_t *client, int count, lwmqtt_message_t *messages,
+                                            uint16_t *packet_ids, uint64_t *sent, lwmqtt_err_t *results,
+                                            int pending) {
+  // prepare counter
+  size_t read = 0;
+
+  // record the latency of each message from its own send time
+  client->batch_acks = true;
+
+  // cycle until all acks have been received or the timeout has been reached
+  lwmqtt_err_t err = LWMQTT_SUCCESS;
+  while (pending > 0 && client->timer_get(client->command_timer) > 0) {
+    // do one cycle
+    lwmqtt_packet_type_t packet_type = LWMQTT_NO_PACKET;
+    err = lwmqtt_cycle(client, &read, &packet_type);
+    if (err == LWMQTT_WOULD_BLOCK) {
+      // keep waiting while a blocked reply is retried
+      err = LWMQTT_SUCCESS;
+    } else if (err != LWMQTT_SUCCESS) {
+      break;
+    }
+
+    // skip packets that are not final acks
+    if (packet_type != LWMQTT_PUBACK_PACKET && packet_type != LWMQTT_PUBCOMP_PACKET) {
+      continue;
+    }
+
+    // decode ack packet
+    bool dup;
+    uint16_t packet_id;
+    err = lwmqtt_decode_ack(client->read_buf, client->read_buf_size, packet_type, &dup, &packet_id);
+    if (err != LWMQTT_SUCCESS) {
+      break;
+    }
+
+    // find and complete the matching message
+    lwmqtt_qos_t qos = packet_type == LWMQTT_PUBACK_PACKET ? LWMQTT_QOS1 : LWMQTT_QOS2;
+    for (int i = 0; i < count; i++) {
+      if (packet_ids[i] == packet_id && messages[i].qos == qos) {
+        // record round-trip time
+        if (client->latency != NULL) {
+          lwmqtt_histogram_t *histogram =
+              qos == LWMQTT_QOS1 ? &client->latency->publish_qos1 : &client->latency->publish_qos2;
+          lwmqtt_record_rtt(client, histogram, sent[i]);
+        }
+
+        // complete message
+        packet_ids[i] = 0;
+        pending--;
+        break;
+      }
+    }
+  }
+
+  // let acks of later commands use the shared send time again
+  client->batch_acks = false;
+
+  // treat missing acks as an error
+  if (err == LWMQTT_SUCCESS && pending > 0) {
+    err = LWMQTT_MISSING_OR_WRONG_PACKET;
+  }
+
+  // fail messages that have not been acknowledged
+  for (int i = 0; i < count && err != LWMQTT_SUCCESS; i++) {
+    if (packet_ids[i] != 0) {
+      results[i] = err;
+    }
+  }
+
+  return err;
+}
+
+static lwmqtt_err_t lwmqtt_do_publish_batch(lwmqtt_client_t *client, int count, lwmqtt_string_t *topics,
+                                            lwmqtt_message_t *messages, lwmqtt_err_t *results, uint32_t timeout) {
   // set command timer
   client->timer_set(client->command_timer, timeout);
 
+  // return immediately if there is nothing to publish
+  if (count <= 0) {
+    return LWMQTT_SUCCESS;
+  }
+
+  // finish a partially written packet, the command is rejected if it would block
+  lwmqtt_err_t err = lwmqtt_prepare_command(client);
+  if (err != LWMQTT_SUCCESS) {
+    for (int i = 0; i < count; i++) {
+      results[i] = err;
+    }
+
+    return err;
+  }
+
+  // prepare packet ids and send times of messages awaiting an ack
+  uint16_t packet_ids[count];
+  uint64_t sent[count];
+
+  // publish chunks until all messages have been handled
+  int next = 0;
+  while (next < count) {
+    // prepare chunk
+    int first = next;
+    size_t offset = 0;
+    int pending = 0;
+    lwmqtt_message_t *direct = NULL;
+
+    // encode as many publish packets as fit into the write buffer
+    while (next < count) {
+      // add packet id if at least qos 1, it is only taken once the message is encoded
+      uint16_t packet_id = 0;
+      if (messages[next].qos == LWMQTT_QOS1 || messages[next].qos == LWMQTT_QOS2) {
+        packet_id = lwmqtt_peek_next_packet_id(client);
+      }
+
+      // encode publish packet or only its header behind the previous ones
+      size_t len = 0;
+      lwmqtt_err_t err;
+      if (lwmqtt_use_direct_payload(client, messages[next])) {
+        err = lwmqtt_encode_publish_header(client->write_buf + offset, client->write_buf_size - offset, &len, 0,
+                                           packet_id, topics[next], messages[next]);
+      } else {
+        err = lwmqtt_encode_publish_transformed(client->write_buf + offset, client->write_buf_size - offset, &len, 0,
+                                                packet_id, topics[next], messages[next], client->transform_encode,
+                                                client->transform_ref);
+      }
+      if (err == LWMQTT_BUFFER_TOO_SHORT && offset > 0) {
+        // send current chunk and retry message in the next one
+        break;
+      } else if (err != LWMQTT_SUCCESS) {
+        // skip message that cannot be encoded at all
+        packet_ids[next] = 0;
+        results[next] = err;
+        next++;
+        continue;
+      }
+
+      // track message
+      packet_ids[next] = packet_id;
+      results[next] = LWMQTT_SUCCESS;
+      if (packet_id != 0) {
+        lwmqtt_get_next_packet_id(client);
+        pending++;
+      }
+
+      // advance
+      offset += len;
+      next++;
+
+      // end the chunk with a directly written payload
+      if (lwmqtt_use_direct_payload(client, messages[next - 1])) {
+        direct = &messages[next - 1];
+        break;
+      }
+    }
+
+    // continue if nothing has been encoded
+    if (offset == 0) {
+      continue;
+    }
+
+    // remember when the messages of the chunk are handed to the network
+    if (client->latency != NULL) {
+      uint64_t now = client->clock_get(client->clock_ref);
+      for (int i = first; i < next; i++) {
+        sent[i] = now;
+      }
+    }
+
+    // send all packets of the chunk at once, a blocked write still accepts the chunk
+    if (direct != NULL) {
+      err = lwmqtt_send_packet_with_payload(client, offset, direct->payload, direct->payload_len);
+    } else {
+      err = lwmqtt_send_packet_in_buffer(client, offset);
+    }
+    if (err == LWMQTT_WOULD_BLOCK) {
+      // mark the accepted messages of the chunk as pending
+      for (int i = first; i < next; i++) {
+        if (results[i] == LWMQTT_SUCCESS) {
+          results[i] = LWMQTT_WOULD_BLOCK;
+        }
+      }
+
+      // reject the remaining messages without sending them
+      for (int i = next; i < count; i++) {
+        results[i] = LWMQTT_BUSY;
+      }
+
+      return LWMQTT_WOULD_BLOCK;
+    } else if (err != LWMQTT_SUCCESS) {
+      // fail all sent messages of the chunk
+      for (int i = first; i < next; i++) {
+        if (results[i] == LWMQTT_SUCCESS) {
+          results[i] = err;
+        }
+      }
+    } else if (pending > 0 && client->output_buf == NULL) {
+      // wait for the acks of the chunk
+      err = lwmqtt_await_batch_acks(client, next - first, messages + first, packet_ids + first, sent + first,
+                                    results + first, pending);
+    }
+
+    // fail all remaining messages on error
+    if (err != LWMQTT_SUCCESS) {
+      for (int i = next; i < count; i++) {
+        results[i] = err;
+      }
+
+      return err;
+    }
+  }
+
+  return LWMQTT_SUCCESS;
+}
+
+lwmqtt_err_t lwmqtt_publish_batch(lwmqtt_client_t *client, int count, lwmqtt_string_t *topics,
+                                  lwmqtt_message_t *messages, lwmqtt_err_t *results, uint32_t timeout) {
+  // publish messages
+  lwmqtt_err_t err = lwmqtt_do_publish_batch(client, count, topics, messages, results, timeout);
+
+  // count errors of skipped messages that are not covered by the returned error
+  for (int i = 0; i < count; i++) {
+    if (results[i] != err) {
+      lwmqtt_track_error(client, results[i]);
+    }
+  }
+
+  return lwmqtt_track_error(client, err);
+}
+
+static lwmqtt_err_t lwmqtt_do_disconnect(lwmqtt_client_t *client, uint32_t timeout) {
+  // set command timer
+  client->timer_set(client->command_timer, timeout);
+
+  // finish a partially written packet, the command is rejected if it would block
+  lwmqtt_err_t err = lwmqtt_prepare_command(client);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
   // encode disconnect packet
   size_t len;
-  lwmqtt_err_t err = lwmqtt_encode_zero(client->write_buf, client->write_buf_size, &len, LWMQTT_DISCONNECT_PACKET);
+  err = lwmqtt_encode_zero(client->write_buf, client->write_buf_size, &len, LWMQTT_DISCONNECT_PACKET);
   if (err != LWMQTT_SUCCESS) {
     return err;
   }
@@ -635,10 +1913,26 @@ lwmqtt_err_t lwmqtt_disconnect(lwmqtt_client_t *client, uint32_t timeout) {
   return LWMQTT_SUCCESS;
 }
 
-lwmqtt_err_t lwmqtt_keep_alive(lwmqtt_client_t *client, uint32_t timeout) {
+lwmqtt_err_t lwmqtt_disconnect(lwmqtt_client_t *client, uint32_t timeout) {
+  return lwmqtt_track_error(client, lwmqtt_do_disconnect(client, timeout));
+}
+
+static lwmqtt_err_t lwmqtt_do_keep_alive(lwmqtt_client_t *client, uint32_t timeout) {
   // set command timer
   client->timer_set(client->command_timer, timeout);
 
+  // finish a partially written packet, the command is rejected if it would block
+  lwmqtt_err_t err = lwmqtt_prepare_command(client);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // flush lingering packets if their deadline has been reached
+  err = lwmqtt_check_linger_deadline(client);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
   // return immediately if keep alive interval is zero
   if (client->keep_alive_interval == 0) {
     return LWMQTT_SUCCESS;
@@ -658,19 +1952,23 @@ lwmqtt_err_t lwmqtt_keep_alive(lwmqtt_client_t *client, uint32_t timeout) {
 
   // encode pingreq packet
   size_t len;
-  lwmqtt_err_t err = lwmqtt_encode_zero(client->write_buf, client->write_buf_size, &len, LWMQTT_PINGREQ_PACKET);
+  err = lwmqtt_encode_zero(client->write_buf, client->write_buf_size, &len, LWMQTT_PINGREQ_PACKET);
   if (err != LWMQTT_SUCCESS) {
     return err;
   }
 
   // send packet
   err = lwmqtt_send_packet_in_buffer(client, len);
-  if (err != LWMQTT_SUCCESS) {
+  if (err != LWMQTT_SUCCESS && err != LWMQTT_WOULD_BLOCK) {
     return err;
   }
 
   // set flag
   client->pong_pending = true;
 
-  return LWMQTT_SUCCESS;
+  return err;
+}
+
+lwmqtt_err_t lwmqtt_keep_alive(lwmqtt_client_t *client, uint32_t timeout) {
+  return lwmqtt_track_error(client, lwmqtt_do_keep_alive(client, timeout));
 }
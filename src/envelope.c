@@ -0,0 +1,118 @@
+#include <lwmqtt/envelope.h>
+
+#include "helpers.h"
+
+void lwmqtt_envelope_packer_init(lwmqtt_envelope_packer_t *packer, uint8_t *buf, size_t buf_size, size_t flush_size,
+                                 void *timer, lwmqtt_timer_set_t set, lwmqtt_timer_get_t get, uint32_t flush_time) {
+  packer->buf = buf;
+  packer->buf_size = buf_size;
+  packer->len = 0;
+  packer->count = 0;
+
+  packer->flush_size = flush_size;
+  packer->flush_time = flush_time;
+
+  packer->timer = timer;
+  packer->timer_set = set;
+  packer->timer_get = get;
+}
+
+lwmqtt_err_t lwmqtt_envelope_pack(lwmqtt_envelope_packer_t *packer, uint8_t *data, size_t len) {
+  // prepare pointers
+  uint8_t *buf_ptr = packer->buf + packer->len;
+  uint8_t *buf_end = packer->buf + packer->buf_size;
+
+  // write record length
+  lwmqtt_err_t err = lwmqtt_write_varnum(&buf_ptr, buf_end, (uint32_t)len);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // write record data
+  err = lwmqtt_write_data(&buf_ptr, buf_end, data, len);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // start flush timer with the first record
+  if (packer->count == 0 && packer->timer != NULL) {
+    packer->timer_set(packer->timer, packer->flush_time);
+  }
+
+  // commit record
+  packer->len = buf_ptr - packer->buf;
+  packer->count++;
+
+  return LWMQTT_SUCCESS;
+}
+
+bool lwmqtt_envelope_due(lwmqtt_envelope_packer_t *packer) {
+  // an empty envelope is never due
+  if (packer->count == 0) {
+    return false;
+  }
+
+  // check size trigger
+  if (packer->len >= packer->buf_size || (packer->flush_size > 0 && packer->len >= packer->flush_size)) {
+    return true;
+  }
+
+  // check time trigger
+  if (packer->timer != NULL && packer->timer_get(packer->timer) <= 0) {
+    return true;
+  }
+
+  return false;
+}
+
+void lwmqtt_envelope_fill(lwmqtt_envelope_packer_t *packer, lwmqtt_message_t *msg) {
+  msg->payload = packer->buf;
+  msg->payload_len = packer->len;
+}
+
+void lwmqtt_envelope_reset(lwmqtt_envelope_packer_t *packer) {
+  packer->len = 0;
+  packer->count = 0;
+}
+
+void lwmqtt_envelope_reader_init(lwmqtt_envelope_reader_t *reader, lwmqtt_message_t msg) {
+  reader->ptr = msg.payload;
+  reader->end = msg.payload + msg.payload_len;
+}
+
+lwmqtt_err_t lwmqtt_envelope_next(lwmqtt_envelope_reader_t *reader, uint8_t **data, size_t *len, bool *found) {
+  // preset result
+  *data = NULL;
+  *len = 0;
+  *found = false;
+
+  // check end of envelope
+  if (reader->ptr == reader->end) {
+    return LWMQTT_SUCCESS;
+  }
+
+  // prepare pointer
+  uint8_t *buf_ptr = reader->ptr;
+
+  // read record length
+  uint32_t record_len;
+  lwmqtt_err_t err = lwmqtt_read_varnum(&buf_ptr, reader->end, &record_len);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // read record data
+  err = lwmqtt_read_data(&buf_ptr, reader->end, data, record_len);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  // advance reader
+  reader->ptr = buf_ptr;
+
+  // set result
+  *len = record_len;
+  *found = true;
+
+  return LWMQTT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+#include <lwmqtt/latency.h>
+
+static int lwmqtt_histogram_index(uint32_t value) {
+  // values below the first power of two that is split are stored directly
+  if (value < (1u << (LWMQTT_HISTOGRAM_BITS + 1))) {
+    return (int)value;
+  }
+
+  // get position of the highest set bit
+  int msb = 31;
+  while ((value & (1u << msb)) == 0) {
+    msb--;
+  }
+
+  // calculate index from the power of two and the top bits
+  int shift = msb - LWMQTT_HISTOGRAM_BITS;
+  return (shift << LWMQTT_HISTOGRAM_BITS) + (int)(value >> shift);
+}
+
+static uint32_t lwmqtt_histogram_upper_bound(int index) {
+  // directly stored values are exact
+  if (index < (1 << (LWMQTT_HISTOGRAM_BITS + 1))) {
+    return (uint32_t)index;
+  }
+
+  // calculate the range of the bucket
+  int shift = (index >> LWMQTT_HISTOGRAM_BITS) - 1;
+  uint64_t top = (uint64_t)((index & ((1 << LWMQTT_HISTOGRAM_BITS) - 1)) | (1 << LWMQTT_HISTOGRAM_BITS));
+
+  return (uint32_t)(((top + 1) << shift) - 1);
+}
+
+void lwmqtt_histogram_reset(lwmqtt_histogram_t *histogram) {
+  // clear buckets
+  for (int i = 0; i < LWMQTT_HISTOGRAM_BUCKETS; i++) {
+    histogram->counts[i] = 0;
+  }
+
+  // clear summary
+  histogram->count = 0;
+  histogram->min = 0;
+  histogram->max = 0;
+}
+
+void lwmqtt_histogram_record(lwmqtt_histogram_t *histogram, uint32_t value) {
+  // increment bucket
+  histogram->counts[lwmqtt_histogram_index(value)]++;
+
+  // update summary
+  if (histogram->count == 0 || value < histogram->min) {
+    histogram->min = value;
+  }
+  if (histogram->count == 0 || value > histogram->max) {
+    histogram->max = value;
+  }
+  histogram->count++;
+}
+
+uint32_t lwmqtt_histogram_percentile(lwmqtt_histogram_t *histogram, double percentile) {
+  // return zero if empty
+  if (histogram->count == 0) {
+    return 0;
+  }
+
+  // calculate the rank of the percentile
+  double rank = (percentile / 100.0) * histogram->count;
+  uint64_t needed = (uint64_t)rank;
+  if ((double)needed < rank || needed == 0) {
+    needed++;
+  }
+
+  // find bucket that holds the rank
+  uint64_t seen = 0;
+  for (int i = 0; i < LWMQTT_HISTOGRAM_BUCKETS; i++) {
+    seen += histogram->counts[i];
+    if (seen >= needed) {
+      uint32_t value = lwmqtt_histogram_upper_bound(i);
+      return value < histogram->max ? value : histogram->max;
+    }
+  }
+
+  return histogram->max;
+}
+
+void lwmqtt_latency_reset(lwmqtt_latency_t *latency) {
+  // reset all histograms
+  lwmqtt_histogram_reset(&latency->publish_qos1);
+  lwmqtt_histogram_reset(&latency->publish_qos2);
+  lwmqtt_histogram_reset(&latency->subscribe);
+  lwmqtt_histogram_reset(&latency->unsubscribe);
+  lwmqtt_histogram_reset(&latency->ping);
+}
@@ -0,0 +1,337 @@
+#include <string.h>
+
+#include <lwmqtt/lz.h>
+
+#include "helpers.h"
+
+// the marker that prefixes compressed payloads
+static const uint8_t lwmqtt_lz_marker[3] = {0x00, 'L', 'Z'};
+
+// the minimum length of a match
+#define LWMQTT_LZ_MIN_MATCH 4
+
+// the distance from the end at which no new match may start
+#define LWMQTT_LZ_MATCH_LIMIT 12
+
+// the amount of bytes at the end that are always literals
+#define LWMQTT_LZ_LAST_LITERALS 5
+
+static uint32_t lwmqtt_lz_read32(const uint8_t *ptr) {
+  uint32_t value;
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+static uint32_t lwmqtt_lz_hash(uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - LWMQTT_LZ_HASH_BITS);
+}
+
+static bool lwmqtt_lz_write_length(uint8_t **op, const uint8_t *op_end, size_t len) {
+  // write additional length bytes
+  while (len >= 255) {
+    if (*op == op_end) {
+      return false;
+    }
+
+    *(*op)++ = 255;
+    len -= 255;
+  }
+
+  // write final length byte
+  if (*op == op_end) {
+    return false;
+  }
+
+  *(*op)++ = (uint8_t)len;
+
+  return true;
+}
+
+static bool lwmqtt_lz_write_sequence(uint8_t **op, const uint8_t *op_end, const uint8_t *literals, size_t lit_len,
+                                     size_t offset, size_t match_len) {
+  // check space for token and literals
+  if ((size_t)(op_end - *op) < 1 + lit_len) {
+    return false;
+  }
+
+  // prepare token
+  uint8_t *token = (*op)++;
+  *token = (uint8_t)((lit_len < 15 ? lit_len : 15) << 4);
+
+  // write literal length
+  if (lit_len >= 15 && !lwmqtt_lz_write_length(op, op_end, lit_len - 15)) {
+    return false;
+  }
+
+  // write literals
+  if ((size_t)(op_end - *op) < lit_len) {
+    return false;
+  }
+
+  memcpy(*op, literals, lit_len);
+  *op += lit_len;
+
+  // return if this is the last sequence
+  if (match_len == 0) {
+    return true;
+  }
+
+  // write offset
+  if (op_end - *op < 2) {
+    return false;
+  }
+
+  *(*op)++ = (uint8_t)(offset & 0xFF);
+  *(*op)++ = (uint8_t)(offset >> 8);
+
+  // write match length
+  match_len -= LWMQTT_LZ_MIN_MATCH;
+  *token |= (uint8_t)(match_len < 15 ? match_len : 15);
+  if (match_len >= 15 && !lwmqtt_lz_write_length(op, op_end, match_len - 15)) {
+    return false;
+  }
+
+  return true;
+}
+
+static bool lwmqtt_lz_compress_block(uint32_t *table, const uint8_t *in, size_t in_len, uint8_t **op,
+                                     const uint8_t *op_end) {
+  // prepare pointers
+  const uint8_t *ip = in;
+  const uint8_t *anchor = in;
+  const uint8_t *in_end = in + in_len;
+
+  // find matches if the input is long enough
+  if (in_len > LWMQTT_LZ_MATCH_LIMIT) {
+    const uint8_t *ip_limit = in_end - LWMQTT_LZ_MATCH_LIMIT;
+    const uint8_t *match_end = in_end - LWMQTT_LZ_LAST_LITERALS;
+
+    while (ip < ip_limit) {
+      // look up and update candidate
+      uint32_t sequence = lwmqtt_lz_read32(ip);
+      uint32_t hash = lwmqtt_lz_hash(sequence);
+      size_t pos = (size_t)(ip - in);
+      size_t candidate = table[hash];
+      table[hash] = (uint32_t)pos;
+
+      // skip ahead faster the longer no match has been found
+      if (candidate >= pos || pos - candidate > 65535 || lwmqtt_lz_read32(in + candidate) != sequence) {
+        ip += 1 + ((size_t)(ip - anchor) >> 6);
+        continue;
+      }
+
+      // extend match
+      const uint8_t *ref = in + candidate;
+      const uint8_t *mp = ip + LWMQTT_LZ_MIN_MATCH;
+      const uint8_t *rp = ref + LWMQTT_LZ_MIN_MATCH;
+      while (mp + 4 <= match_end && lwmqtt_lz_read32(mp) == lwmqtt_lz_read32(rp)) {
+        mp += 4;
+        rp += 4;
+      }
+      while (mp < match_end && *mp == *rp) {
+        mp++;
+        rp++;
+      }
+
+      // write sequence
+      if (!lwmqtt_lz_write_sequence(op, op_end, anchor, (size_t)(ip - anchor), (size_t)(ip - ref),
+                                    (size_t)(mp - ip))) {
+        return false;
+      }
+
+      // advance
+      ip = mp;
+      anchor = ip;
+    }
+  }
+
+  // write last literals
+  return lwmqtt_lz_write_sequence(op, op_end, anchor, (size_t)(in_end - anchor), 0, 0);
+}
+
+lwmqtt_err_t lwmqtt_lz_compress(void *ref, uint8_t *in, size_t in_len, uint8_t *out, size_t out_size, size_t *out_len,
+                                bool *transformed) {
+  // get state
+  lwmqtt_lz_state_t *state = (lwmqtt_lz_state_t *)ref;
+
+  // preset result
+  *out_len = 0;
+  *transformed = false;
+
+  // check if the payload must be wrapped to stay unambiguous
+  bool marked = in_len >= sizeof(lwmqtt_lz_marker) && memcmp(in, lwmqtt_lz_marker, sizeof(lwmqtt_lz_marker)) == 0;
+
+  // limit output to the input length unless wrapping is required
+  size_t limit = out_size;
+  if (!marked) {
+    if (in_len <= 1) {
+      return LWMQTT_SUCCESS;
+    } else if (limit > in_len - 1) {
+      limit = in_len - 1;
+    }
+  }
+
+  // prepare pointers
+  uint8_t *op = out;
+  uint8_t *op_end = out + limit;
+
+  // write marker and uncompressed length
+  lwmqtt_err_t err = lwmqtt_write_data(&op, op_end, (uint8_t *)lwmqtt_lz_marker, sizeof(lwmqtt_lz_marker));
+  if (err == LWMQTT_SUCCESS) {
+    err = in_len > 268435455 ? LWMQTT_VARNUM_OVERFLOW : lwmqtt_write_varnum(&op, op_end, (uint32_t)in_len);
+  }
+
+  // compress block
+  if (err == LWMQTT_SUCCESS && !lwmqtt_lz_compress_block(state->table, in, in_len, &op, op_end)) {
+    err = LWMQTT_BUFFER_TOO_SHORT;
+  }
+
+  // handle errors
+  if (err != LWMQTT_SUCCESS) {
+    // keep payload untouched if possible
+    if (!marked && err == LWMQTT_BUFFER_TOO_SHORT) {
+      return LWMQTT_SUCCESS;
+    }
+
+    return err;
+  }
+
+  // set result
+  *out_len = (size_t)(op - out);
+  *transformed = true;
+
+  return LWMQTT_SUCCESS;
+}
+
+static lwmqtt_err_t lwmqtt_lz_read_length(uint8_t **ip, const uint8_t *ip_end, size_t *len) {
+  // read additional length bytes
+  uint8_t byte;
+  do {
+    lwmqtt_err_t err = lwmqtt_read_byte(ip, ip_end, &byte);
+    if (err != LWMQTT_SUCCESS) {
+      return LWMQTT_MALFORMED_PAYLOAD;
+    }
+
+    *len += byte;
+  } while (byte == 255);
+
+  return LWMQTT_SUCCESS;
+}
+
+lwmqtt_err_t lwmqtt_lz_decompress(void *ref, uint8_t *in, size_t in_len, uint8_t *out, size_t out_size,
+                                  size_t *out_len, bool *transformed) {
+  // preset result
+  *out_len = 0;
+  *transformed = false;
+
+  // leave unmarked payloads untouched
+  if (in_len < sizeof(lwmqtt_lz_marker) || memcmp(in, lwmqtt_lz_marker, sizeof(lwmqtt_lz_marker)) != 0) {
+    return LWMQTT_SUCCESS;
+  }
+
+  // prepare pointers
+  uint8_t *ip = in + sizeof(lwmqtt_lz_marker);
+  uint8_t *ip_end = in + in_len;
+
+  // read uncompressed length
+  uint32_t raw_len;
+  lwmqtt_err_t err = lwmqtt_read_varnum(&ip, ip_end, &raw_len);
+  if (err != LWMQTT_SUCCESS) {
+    return LWMQTT_MALFORMED_PAYLOAD;
+  }
+
+  // check output capacity
+  if (raw_len > out_size) {
+    return LWMQTT_BUFFER_TOO_SHORT;
+  }
+
+  // prepare output pointers
+  uint8_t *op = out;
+  uint8_t *op_end = out + raw_len;
+
+  // decode sequences
+  for (;;) {
+    // read token
+    uint8_t token;
+    err = lwmqtt_read_byte(&ip, ip_end, &token);
+    if (err != LWMQTT_SUCCESS) {
+      return LWMQTT_MALFORMED_PAYLOAD;
+    }
+
+    // read literal length
+    size_t lit_len = token >> 4;
+    if (lit_len == 15) {
+      err = lwmqtt_lz_read_length(&ip, ip_end, &lit_len);
+      if (err != LWMQTT_SUCCESS) {
+        return err;
+      }
+    }
+
+    // copy literals
+    if ((size_t)(ip_end - ip) < lit_len || (size_t)(op_end - op) < lit_len) {
+      return LWMQTT_MALFORMED_PAYLOAD;
+    }
+
+    memcpy(op, ip, lit_len);
+    ip += lit_len;
+    op += lit_len;
+
+    // finish after the last sequence
+    if (ip == ip_end) {
+      break;
+    }
+
+    // read offset
+    uint16_t offset;
+    if (ip_end - ip < 2) {
+      return LWMQTT_MALFORMED_PAYLOAD;
+    }
+
+    offset = (uint16_t)(ip[0] | (ip[1] << 8));
+    ip += 2;
+
+    // check offset
+    if (offset == 0 || offset > (size_t)(op - out)) {
+      return LWMQTT_MALFORMED_PAYLOAD;
+    }
+
+    // read match length
+    size_t match_len = token & 0x0Fu;
+    if (match_len == 15) {
+      err = lwmqtt_lz_read_length(&ip, ip_end, &match_len);
+      if (err != LWMQTT_SUCCESS) {
+        return err;
+      }
+    }
+
+    match_len += LWMQTT_LZ_MIN_MATCH;
+
+    // check match length
+    if ((size_t)(op_end - op) < match_len) {
+      return LWMQTT_MALFORMED_PAYLOAD;
+    }
+
+    // copy match at once or byte by byte if it overlaps
+    const uint8_t *mp = op - offset;
+    if (offset >= match_len) {
+      memcpy(op, mp, match_len);
+    } else {
+      for (size_t i = 0; i < match_len; i++) {
+        op[i] = mp[i];
+      }
+    }
+
+    op += match_len;
+  }
+
+  // check uncompressed length
+  if (op != op_end) {
+    return LWMQTT_MALFORMED_PAYLOAD;
+  }
+
+  // set result
+  *out_len = raw_len;
+  *transformed = true;
+
+  return LWMQTT_SUCCESS;
+}
@@ -0,0 +1,285 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <lwmqtt/capture.h>
+#include <lwmqtt/unix.h>
+
+// the header that starts every capture file
+static const uint8_t lwmqtt_capture_header[5] = {'L', 'W', 'C', 'P', 1};
+
+static size_t lwmqtt_capture_write_varint(uint8_t *buf, uint64_t value) {
+  // write seven bits at a time
+  size_t len = 0;
+  do {
+    uint8_t byte = (uint8_t)(value & 0x7F);
+    value >>= 7;
+    buf[len++] = (uint8_t)(byte | (value > 0 ? 0x80 : 0));
+  } while (value > 0);
+
+  return len;
+}
+
+static bool lwmqtt_capture_read_varint(lwmqtt_replay_t *replay, uint64_t *value) {
+  // read seven bits at a time
+  *value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (replay->offset >= replay->size) {
+      return false;
+    }
+
+    uint8_t byte = replay->data[replay->offset++];
+    *value |= (uint64_t)(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+lwmqtt_err_t lwmqtt_capture_open(lwmqtt_capture_t *capture, const char *path, void *ref,
+                                 lwmqtt_network_read_t network_read, lwmqtt_network_write_t network_write) {
+  // set wrapped network
+  capture->ref = ref;
+  capture->read = network_read;
+  capture->write = network_write;
+  capture->last = lwmqtt_unix_clock_get(NULL);
+
+  // create file
+  capture->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (capture->fd < 0) {
+    return LWMQTT_NETWORK_FAILED_WRITE;
+  }
+
+  // write header
+  if (write(capture->fd, lwmqtt_capture_header, sizeof(lwmqtt_capture_header)) !=
+      (ssize_t)sizeof(lwmqtt_capture_header)) {
+    lwmqtt_capture_close(capture);
+    return LWMQTT_NETWORK_FAILED_WRITE;
+  }
+
+  return LWMQTT_SUCCESS;
+}
+
+void lwmqtt_capture_close(lwmqtt_capture_t *capture) {
+  // close file if open
+  if (capture->fd >= 0) {
+    close(capture->fd);
+    capture->fd = -1;
+  }
+}
+
+static lwmqtt_err_t lwmqtt_capture_record(lwmqtt_capture_t *capture, uint8_t direction, uint8_t *buf, size_t len) {
+  // get time since the last record
+  uint64_t now = lwmqtt_unix_clock_get(NULL);
+  uint64_t delta = now - capture->last;
+  capture->last = now;
+
+  // encode record header
+  uint8_t header[21];
+  header[0] = direction;
+  size_t header_len = 1;
+  header_len += lwmqtt_capture_write_varint(header + header_len, delta);
+  header_len += lwmqtt_capture_write_varint(header + header_len, len);
+
+  // write header and data at once
+  struct iovec parts[2] = {{header, header_len}, {buf, len}};
+  if (writev(capture->fd, parts, 2) != (ssize_t)(header_len + len)) {
+    return LWMQTT_NETWORK_FAILED_WRITE;
+  }
+
+  return LWMQTT_SUCCESS;
+}
+
+lwmqtt_err_t lwmqtt_capture_read(void *ref, uint8_t *buf, size_t len, size_t *read, uint32_t timeout) {
+  // cast capture reference
+  lwmqtt_capture_t *c = (lwmqtt_capture_t *)ref;
+
+  // read from wrapped network
+  size_t offset = *read;
+  lwmqtt_err_t err = c->read(c->ref, buf, len, read, timeout);
+  if (err != LWMQTT_SUCCESS || *read == offset) {
+    return err;
+  }
+
+  // record data
+  err = lwmqtt_capture_record(c, LWMQTT_CAPTURE_IN, buf, *read - offset);
+  if (err != LWMQTT_SUCCESS) {
+    return LWMQTT_NETWORK_FAILED_READ;
+  }
+
+  return LWMQTT_SUCCESS;
+}
+
+lwmqtt_err_t lwmqtt_capture_write(void *ref, uint8_t *buf, size_t len, size_t *sent, uint32_t timeout) {
+  // cast capture reference
+  lwmqtt_capture_t *c = (lwmqtt_capture_t *)ref;
+
+  // write to wrapped network
+  size_t offset = *sent;
+  lwmqtt_err_t err = c->write(c->ref, buf, len, sent, timeout);
+  if (*sent == offset) {
+    return err;
+  }
+
+  // record data, also if the network stopped early with an error
+  lwmqtt_err_t rec = lwmqtt_capture_record(c, LWMQTT_CAPTURE_OUT, buf, *sent - offset);
+  if (rec != LWMQTT_SUCCESS) {
+    return rec;
+  }
+
+  return err;
+}
+
+static lwmqtt_err_t lwmqtt_replay_next(lwmqtt_replay_t *replay) {
+  // find the next incoming record
+  while (replay->chunk_len == 0 && replay->offset < replay->size) {
+    // read record header
+    uint8_t direction = replay->data[replay->offset++];
+    uint64_t delta, len;
+    if (!lwmqtt_capture_read_varint(replay, &delta) || !lwmqtt_capture_read_varint(replay, &len) ||
+        len > replay->size - replay->offset) {
+      return LWMQTT_NETWORK_FAILED_READ;
+    }
+
+    // advance time and data
+    replay->time += delta;
+    if (direction == LWMQTT_CAPTURE_IN) {
+      replay->chunk = replay->data + replay->offset;
+      replay->chunk_len = (size_t)len;
+    }
+    replay->offset += (size_t)len;
+  }
+
+  return LWMQTT_SUCCESS;
+}
+
+lwmqtt_err_t lwmqtt_replay_open(lwmqtt_replay_t *replay, const char *path, bool paced) {
+  // reset object
+  memset(replay, 0, sizeof(lwmqtt_replay_t));
+  replay->paced = paced;
+
+  // open file
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return LWMQTT_NETWORK_FAILED_READ;
+  }
+
+  // get size
+  struct stat info;
+  if (fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(lwmqtt_capture_header)) {
+    close(fd);
+    return LWMQTT_NETWORK_FAILED_READ;
+  }
+
+  // map file
+  void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return LWMQTT_NETWORK_FAILED_READ;
+  }
+  replay->data = (uint8_t *)data;
+  replay->size = (size_t)info.st_size;
+
+  // check header
+  if (memcmp(replay->data, lwmqtt_capture_header, sizeof(lwmqtt_capture_header)) != 0) {
+    lwmqtt_replay_close(replay);
+    return LWMQTT_NETWORK_FAILED_READ;
+  }
+  replay->offset = sizeof(lwmqtt_capture_header);
+
+  // load first chunk
+  lwmqtt_err_t err = lwmqtt_replay_next(replay);
+  if (err != LWMQTT_SUCCESS) {
+    lwmqtt_replay_close(replay);
+    return err;
+  }
+
+  return LWMQTT_SUCCESS;
+}
+
+void lwmqtt_replay_close(lwmqtt_replay_t *replay) {
+  // unmap file if mapped
+  if (replay->data != NULL) {
+    munmap(replay->data, replay->size);
+    replay->data = NULL;
+  }
+}
+
+static int64_t lwmqtt_replay_wait(lwmqtt_replay_t *replay) {
+  // start pacing at the first chunk
+  uint64_t now = lwmqtt_unix_clock_get(NULL);
+  if (replay->start == 0) {
+    replay->start = now - replay->time;
+  }
+
+  // get time until the current chunk is due
+  return (int64_t)(replay->start + replay->time - now);
+}
+
+size_t lwmqtt_replay_available(lwmqtt_replay_t *replay) {
+  // check if the current chunk is due
+  if (replay->paced && replay->chunk_len > 0 && lwmqtt_replay_wait(replay) > 0) {
+    return 0;
+  }
+
+  return replay->chunk_len;
+}
+
+bool lwmqtt_replay_done(lwmqtt_replay_t *replay) { return replay->chunk_len == 0; }
+
+lwmqtt_err_t lwmqtt_replay_read(void *ref, uint8_t *buf, size_t len, size_t *read, uint32_t timeout) {
+  // cast replay reference
+  lwmqtt_replay_t *r = (lwmqtt_replay_t *)ref;
+
+  // behave like an idle connection when done
+  if (r->chunk_len == 0) {
+    return LWMQTT_SUCCESS;
+  }
+
+  // wait until the chunk is due or the timeout has been reached
+  if (r->paced) {
+    int64_t wait = lwmqtt_replay_wait(r);
+    if (wait > 0) {
+      if (wait > (int64_t)timeout * 1000) {
+        wait = (int64_t)timeout * 1000;
+      }
+      struct timespec ts = {(time_t)(wait / 1000000), (long)(wait % 1000000) * 1000};
+      nanosleep(&ts, NULL);
+      if (lwmqtt_replay_wait(r) > 0) {
+        return LWMQTT_SUCCESS;
+      }
+    }
+  }
+
+  // copy data
+  if (len > r->chunk_len) {
+    len = r->chunk_len;
+  }
+  memcpy(buf, r->chunk, len);
+  r->chunk += len;
+  r->chunk_len -= len;
+  r->bytes_in += len;
+
+  // increment counter
+  *read += len;
+
+  // load next chunk
+  return lwmqtt_replay_next(r);
+}
+
+lwmqtt_err_t lwmqtt_replay_write(void *ref, uint8_t *buf, size_t len, size_t *sent, uint32_t timeout) {
+  // cast replay reference
+  lwmqtt_replay_t *r = (lwmqtt_replay_t *)ref;
+
+  // discard data
+  r->bytes_out += len;
+  *sent += len;
+
+  return LWMQTT_SUCCESS;
+}
@@ -0,0 +1,192 @@
+#include <string.h>
+
+#include <lwmqtt/pipe.h>
+
+void lwmqtt_pipe_clock_advance(lwmqtt_pipe_clock_t *clock, uint64_t duration) { clock->now += duration; }
+
+uint64_t lwmqtt_pipe_clock_get(void *ref) {
+  // cast clock reference
+  lwmqtt_pipe_clock_t *c = (lwmqtt_pipe_clock_t *)ref;
+
+  return c->now;
+}
+
+void lwmqtt_pipe_timer_init(lwmqtt_pipe_timer_t *timer, lwmqtt_pipe_clock_t *clock) {
+  timer->clock = clock;
+  timer->end = clock->now;
+}
+
+void lwmqtt_pipe_timer_set(void *ref, uint32_t timeout) {
+  // cast timer reference
+  lwmqtt_pipe_timer_t *t = (lwmqtt_pipe_timer_t *)ref;
+
+  // set future end time
+  t->end = t->clock->now + (uint64_t)timeout * 1000;
+}
+
+int32_t lwmqtt_pipe_timer_get(void *ref) {
+  // cast timer reference
+  lwmqtt_pipe_timer_t *t = (lwmqtt_pipe_timer_t *)ref;
+
+  // get difference to end time
+  if (t->end >= t->clock->now) {
+    return (int32_t)((t->end - t->clock->now) / 1000);
+  }
+
+  return -(int32_t)((t->clock->now - t->end + 999) / 1000);
+}
+
+static void lwmqtt_pipe_ring_init(lwmqtt_pipe_ring_t *ring, uint8_t *buf, size_t size) {
+  // reset ring
+  memset(ring, 0, sizeof(lwmqtt_pipe_ring_t));
+  ring->options = (lwmqtt_pipe_options_t)lwmqtt_pipe_default_options;
+  ring->buf = buf;
+  ring->size = size;
+}
+
+void lwmqtt_pipe_init(lwmqtt_pipe_t *pipe, lwmqtt_pipe_clock_t *clock, uint8_t *buf, size_t buf_size) {
+  // prepare rings
+  lwmqtt_pipe_ring_init(&pipe->rings[0], buf, buf_size / 2);
+  lwmqtt_pipe_ring_init(&pipe->rings[1], buf + buf_size / 2, buf_size / 2);
+
+  // connect ends
+  pipe->a = (lwmqtt_pipe_end_t){&pipe->rings[1], &pipe->rings[0], clock};
+  pipe->b = (lwmqtt_pipe_end_t){&pipe->rings[0], &pipe->rings[1], clock};
+}
+
+static size_t lwmqtt_pipe_deliverable(lwmqtt_pipe_ring_t *ring, uint64_t now) {
+  // find the end of the last released segment
+  uint64_t end = ring->head;
+  for (size_t i = 0; i < ring->segment_count; i++) {
+    size_t index = (ring->first_segment + i) % LWMQTT_PIPE_SEGMENTS;
+    if (ring->segments[index].release > now) {
+      break;
+    }
+    end = ring->segments[index].end;
+  }
+
+  return (size_t)(end - ring->head);
+}
+
+size_t lwmqtt_pipe_available(lwmqtt_pipe_end_t *end) { return lwmqtt_pipe_deliverable(end->in, end->clock->now); }
+
+lwmqtt_err_t lwmqtt_pipe_read(void *ref, uint8_t *buf, size_t len, size_t *read, uint32_t timeout) {
+  // cast end reference
+  lwmqtt_pipe_end_t *e = (lwmqtt_pipe_end_t *)ref;
+  lwmqtt_pipe_ring_t *ring = e->in;
+
+  // check fault
+  if (ring->head >= ring->options.fail_after) {
+    return LWMQTT_NETWORK_FAILED_READ;
+  }
+
+  // wait for the next delivery or the timeout
+  size_t available = lwmqtt_pipe_deliverable(ring, e->clock->now);
+  if (available == 0) {
+    uint64_t deadline = e->clock->now + (uint64_t)timeout * 1000;
+    uint64_t release = ring->segment_count > 0 ? ring->segments[ring->first_segment].release : UINT64_MAX;
+    if (release > deadline) {
+      e->clock->now = deadline;
+      return LWMQTT_SUCCESS;
+    }
+
+    // advance to the delivery
+    if (release > e->clock->now) {
+      e->clock->now = release;
+    }
+    available = lwmqtt_pipe_deliverable(ring, e->clock->now);
+  }
+
+  // limit length
+  if (len > available) {
+    len = available;
+  }
+  if (ring->options.max_read > 0 && len > ring->options.max_read) {
+    len = ring->options.max_read;
+  }
+  if (len > ring->options.fail_after - ring->head) {
+    len = (size_t)(ring->options.fail_after - ring->head);
+  }
+
+  // copy bytes in up to two parts
+  size_t offset = (size_t)(ring->head % ring->size);
+  size_t first = len < ring->size - offset ? len : ring->size - offset;
+  memcpy(buf, ring->buf + offset, first);
+  memcpy(buf + first, ring->buf, len - first);
+  ring->head += len;
+
+  // remove consumed segments
+  while (ring->segment_count > 0 && ring->segments[ring->first_segment].end <= ring->head) {
+    ring->first_segment = (ring->first_segment + 1) % LWMQTT_PIPE_SEGMENTS;
+    ring->segment_count--;
+  }
+
+  // increment counter
+  *read += len;
+
+  return LWMQTT_SUCCESS;
+}
+
+lwmqtt_err_t lwmqtt_pipe_write(void *ref, uint8_t *buf, size_t len, size_t *sent, uint32_t timeout) {
+  // cast end reference
+  lwmqtt_pipe_end_t *e = (lwmqtt_pipe_end_t *)ref;
+  lwmqtt_pipe_ring_t *ring = e->out;
+
+  // check fault
+  if (ring->tail >= ring->options.fail_after) {
+    return LWMQTT_NETWORK_FAILED_WRITE;
+  }
+
+  // limit length
+  size_t space = ring->size - (size_t)(ring->tail - ring->head);
+  if (len > space) {
+    len = space;
+  }
+  if (ring->options.max_write > 0 && len > ring->options.max_write) {
+    len = ring->options.max_write;
+  }
+  if (len > ring->options.fail_after - ring->tail) {
+    len = (size_t)(ring->options.fail_after - ring->tail);
+  }
+
+  // wait for the timeout if the ring is full
+  if (len == 0) {
+    if (ring->options.nonblocking) {
+      return LWMQTT_WOULD_BLOCK;
+    }
+    e->clock->now += (uint64_t)timeout * 1000;
+    return LWMQTT_SUCCESS;
+  }
+
+  // copy bytes in up to two parts
+  size_t offset = (size_t)(ring->tail % ring->size);
+  size_t first = len < ring->size - offset ? len : ring->size - offset;
+  memcpy(ring->buf + offset, buf, first);
+  memcpy(ring->buf, buf + first, len - first);
+  ring->tail += len;
+
+  // calculate the transmission end after previous transmissions
+  uint64_t start = ring->busy > e->clock->now ? ring->busy : e->clock->now;
+  ring->busy = start;
+  if (ring->options.bandwidth > 0) {
+    ring->busy += ((uint64_t)len * 1000000 + ring->options.bandwidth - 1) / ring->options.bandwidth;
+  }
+  uint64_t release = ring->busy + ring->options.latency;
+
+  // append segment or merge with the last if full
+  if (ring->segment_count == LWMQTT_PIPE_SEGMENTS) {
+    size_t last = (ring->first_segment + ring->segment_count - 1) % LWMQTT_PIPE_SEGMENTS;
+    ring->segments[last].end = ring->tail;
+    ring->segments[last].release = release;
+  } else {
+    size_t next = (ring->first_segment + ring->segment_count) % LWMQTT_PIPE_SEGMENTS;
+    ring->segments[next].end = ring->tail;
+    ring->segments[next].release = release;
+    ring->segment_count++;
+  }
+
+  // increment counter
+  *sent += len;
+
+  return LWMQTT_SUCCESS;
+}
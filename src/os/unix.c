@@ -1,11 +1,24 @@
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <memory.h>
 #include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <sys/ioctl.h>
+#include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
+
 #include <lwmqtt/unix.h>
 
 void lwmqtt_unix_timer_set(void *ref, uint32_t timeout) {
@@ -39,69 +52,527 @@ int32_t lwmqtt_unix_timer_get(void *ref) {
   return (int32_t)((res.tv_sec * 1000) + (res.tv_usec / 1000));
 }
 
-lwmqtt_err_t lwmqtt_unix_network_connect(lwmqtt_unix_network_t *network, char *host, int port) {
-  // close any open socket
-  lwmqtt_unix_network_disconnect(network);
+uint64_t lwmqtt_unix_clock_get(void *ref) {
+  // get monotonic time
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+static void lwmqtt_unix_order_addresses(struct addrinfo *result, lwmqtt_unix_addresses_t *addresses) {
+  // interleave address families starting with the family of the first result
+  addresses->count = 0;
+  int family = result->ai_family;
+  struct addrinfo *preferred = result;
+  struct addrinfo *other = result;
+  while (addresses->count < LWMQTT_UNIX_CONNECT_CANDIDATES) {
+    // find next result of the preferred and other family
+    while (preferred != NULL && preferred->ai_family != family) {
+      preferred = preferred->ai_next;
+    }
+    while (other != NULL && other->ai_family == family) {
+      other = other->ai_next;
+    }
+
+    // stop if both lists are exhausted
+    if (preferred == NULL && other == NULL) {
+      break;
+    }
+
+    // add preferred and other result
+    struct addrinfo *next[2] = {preferred, other};
+    for (int i = 0; i < 2; i++) {
+      if (next[i] != NULL && addresses->count < LWMQTT_UNIX_CONNECT_CANDIDATES &&
+          next[i]->ai_addrlen <= sizeof(struct sockaddr_storage)) {
+        memcpy(&addresses->addrs[addresses->count], next[i]->ai_addr, next[i]->ai_addrlen);
+        addresses->lens[addresses->count] = next[i]->ai_addrlen;
+        addresses->count++;
+      }
+    }
+
+    // advance lists
+    if (preferred != NULL) {
+      preferred = preferred->ai_next;
+    }
+    if (other != NULL) {
+      other = other->ai_next;
+    }
+  }
+}
+
+static lwmqtt_err_t lwmqtt_unix_resolve_local(const char *path, lwmqtt_unix_addresses_t *addresses) {
+  // check path length, abstract names start with a zero byte instead of the "@" and are not terminated
+  size_t len = strlen(path);
+  struct sockaddr_un *addr = (struct sockaddr_un *)&addresses->addrs[0];
+  if (len == 0 || len >= sizeof(addr->sun_path)) {
+    return LWMQTT_NETWORK_FAILED_CONNECT;
+  }
+
+  // set address
+  memset(addr, 0, sizeof(struct sockaddr_un));
+  addr->sun_family = AF_UNIX;
+  memcpy(addr->sun_path, path, len);
+  if (path[0] == '@') {
+    addr->sun_path[0] = '\0';
+    addresses->lens[0] = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + len);
+  } else {
+    addresses->lens[0] = (socklen_t)sizeof(struct sockaddr_un);
+  }
+  addresses->count = 1;
+
+  return LWMQTT_SUCCESS;
+}
 
+static lwmqtt_err_t lwmqtt_unix_resolve_uncached(const char *host, int port, lwmqtt_unix_addresses_t *addresses) {
   // prepare resolver hints
   struct addrinfo hints;
   memset(&hints, 0, sizeof(hints));
   hints.ai_family = PF_UNSPEC;
-  hints.ai_flags = AI_ADDRCONFIG;
+  hints.ai_flags = AI_ADDRCONFIG | AI_NUMERICSERV;
   hints.ai_socktype = SOCK_STREAM;
 
-  // resolve address
+  // resolve addresses
+  char service[8];
+  snprintf(service, sizeof(service), "%d", port);
   struct addrinfo *result = NULL;
-  int rc = getaddrinfo(host, NULL, &hints, &result);
-  if (rc < 0) {
+  int rc = getaddrinfo(host, service, &hints, &result);
+  if (rc != 0 || result == NULL) {
     return LWMQTT_NETWORK_FAILED_CONNECT;
   }
 
-  // prepare selected result
-  struct addrinfo *current = result;
-  struct addrinfo *selected = NULL;
+  // order addresses
+  lwmqtt_unix_order_addresses(result, addresses);
 
-  // traverse list and select first found ipv4 address
-  while (current) {
-    // check if ipv4 address
-    if (current->ai_family == AF_INET) {
-      selected = current;
-      break;
+  // free result
+  freeaddrinfo(result);
+
+  return addresses->count > 0 ? LWMQTT_SUCCESS : LWMQTT_NETWORK_FAILED_CONNECT;
+}
+
+void lwmqtt_unix_resolver_init(lwmqtt_unix_resolver_t *resolver, lwmqtt_unix_resolver_entry_t *entries, size_t size,
+                               uint32_t ttl) {
+  // initialize resolver
+  pthread_mutex_init(&resolver->mutex, NULL);
+  resolver->entries = entries;
+  resolver->size = size;
+  resolver->ttl = ttl;
+  resolver->hits = 0;
+  resolver->misses = 0;
+
+  // clear entries
+  memset(entries, 0, size * sizeof(lwmqtt_unix_resolver_entry_t));
+}
+
+void lwmqtt_unix_resolver_destroy(lwmqtt_unix_resolver_t *resolver) { pthread_mutex_destroy(&resolver->mutex); }
+
+static lwmqtt_unix_resolver_entry_t *lwmqtt_unix_resolver_find(lwmqtt_unix_resolver_t *resolver, const char *host,
+                                                               int port) {
+  // find matching entry
+  for (size_t i = 0; i < resolver->size; i++) {
+    lwmqtt_unix_resolver_entry_t *entry = &resolver->entries[i];
+    if (entry->port == port && strcmp(entry->host, host) == 0) {
+      return entry;
     }
+  }
+
+  return NULL;
+}
 
-    // move one to next
-    current = current->ai_next;
+lwmqtt_err_t lwmqtt_unix_resolve(lwmqtt_unix_resolver_t *resolver, const char *host, int port,
+                                 lwmqtt_unix_addresses_t *addresses) {
+  // use local endpoints as is
+  if (strncmp(host, LWMQTT_UNIX_LOCAL_PREFIX, strlen(LWMQTT_UNIX_LOCAL_PREFIX)) == 0) {
+    return lwmqtt_unix_resolve_local(host + strlen(LWMQTT_UNIX_LOCAL_PREFIX), addresses);
   }
 
-  // return error if none found
-  if (selected == NULL) {
-    return LWMQTT_NETWORK_FAILED_CONNECT;
+  // resolve directly if there is no cache or the host does not fit
+  if (resolver == NULL || resolver->size == 0 || strlen(host) >= LWMQTT_UNIX_HOST_SIZE) {
+    return lwmqtt_unix_resolve_uncached(host, port, addresses);
   }
 
-  // populate address struct
-  struct sockaddr_in address;
-  address.sin_port = htons(port);
-  address.sin_family = AF_INET;
-  address.sin_addr = ((struct sockaddr_in *)(selected->ai_addr))->sin_addr;
+  // look up entry
+  pthread_mutex_lock(&resolver->mutex);
+  uint64_t now = lwmqtt_unix_clock_get(NULL);
+  lwmqtt_unix_resolver_entry_t *entry = lwmqtt_unix_resolver_find(resolver, host, port);
+
+  // use fresh entries and stale entries that are being refreshed by another caller
+  if (entry != NULL && (entry->expires > now || entry->refreshing)) {
+    *addresses = entry->addresses;
+    resolver->hits++;
+    pthread_mutex_unlock(&resolver->mutex);
+    return LWMQTT_SUCCESS;
+  }
 
-  // free result
-  freeaddrinfo(result);
+  // mark entry as being refreshed
+  if (entry != NULL) {
+    entry->refreshing = true;
+  }
+  resolver->misses++;
+  pthread_mutex_unlock(&resolver->mutex);
+
+  // resolve without holding the lock
+  lwmqtt_err_t err = lwmqtt_unix_resolve_uncached(host, port, addresses);
+
+  // store result
+  pthread_mutex_lock(&resolver->mutex);
+  entry = lwmqtt_unix_resolver_find(resolver, host, port);
+  if (err == LWMQTT_SUCCESS) {
+    // replace the entry that expires first if the host is not cached, skipping entries that are being refreshed
+    if (entry == NULL) {
+      for (size_t i = 0; i < resolver->size; i++) {
+        lwmqtt_unix_resolver_entry_t *candidate = &resolver->entries[i];
+        if (!candidate->refreshing && (entry == NULL || candidate->expires < entry->expires)) {
+          entry = candidate;
+        }
+      }
+      if (entry != NULL) {
+        strcpy(entry->host, host);
+        entry->port = port;
+      }
+    }
+
+    // update entry unless all entries are being refreshed
+    if (entry != NULL) {
+      entry->addresses = *addresses;
+      entry->expires = lwmqtt_unix_clock_get(NULL) + (uint64_t)resolver->ttl * 1000;
+      entry->refreshing = false;
+    }
+  } else if (entry != NULL) {
+    // keep serving the stale addresses
+    *addresses = entry->addresses;
+    entry->refreshing = false;
+    err = LWMQTT_SUCCESS;
+  }
+  pthread_mutex_unlock(&resolver->mutex);
+
+  return err;
+}
+
+static int lwmqtt_unix_set_option(int fd, int level, int name, int value) {
+  return setsockopt(fd, level, name, &value, sizeof(value));
+}
+
+static int lwmqtt_unix_apply_options(int fd, int family, const lwmqtt_unix_options_t *o) {
+  // apply buffer sizes
+  int rc = 0;
+  if (o->send_buffer > 0) {
+    rc |= lwmqtt_unix_set_option(fd, SOL_SOCKET, SO_SNDBUF, o->send_buffer);
+  }
+  if (o->receive_buffer > 0) {
+    rc |= lwmqtt_unix_set_option(fd, SOL_SOCKET, SO_RCVBUF, o->receive_buffer);
+  }
+
+  // skip TCP options for local sockets
+  if (family == AF_UNIX) {
+    return rc;
+  }
+
+  // apply generic TCP options
+  if (o->no_delay) {
+    rc |= lwmqtt_unix_set_option(fd, IPPROTO_TCP, TCP_NODELAY, 1);
+  }
+  if (o->keep_alive_idle > 0) {
+    rc |= lwmqtt_unix_set_option(fd, SOL_SOCKET, SO_KEEPALIVE, 1);
+  }
+
+  // apply platform specific options
+#ifdef TCP_NOTSENT_LOWAT
+  if (o->not_sent_lowat > 0) {
+    rc |= lwmqtt_unix_set_option(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, o->not_sent_lowat);
+  }
+#endif
+#ifdef TCP_USER_TIMEOUT
+  if (o->user_timeout > 0) {
+    rc |= lwmqtt_unix_set_option(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, (int)o->user_timeout);
+  }
+#endif
+#ifdef TCP_KEEPIDLE
+  if (o->keep_alive_idle > 0) {
+    rc |= lwmqtt_unix_set_option(fd, IPPROTO_TCP, TCP_KEEPIDLE, o->keep_alive_idle);
+  }
+#endif
+#ifdef TCP_KEEPINTVL
+  if (o->keep_alive_interval > 0) {
+    rc |= lwmqtt_unix_set_option(fd, IPPROTO_TCP, TCP_KEEPINTVL, o->keep_alive_interval);
+  }
+#endif
+#ifdef TCP_KEEPCNT
+  if (o->keep_alive_count > 0) {
+    rc |= lwmqtt_unix_set_option(fd, IPPROTO_TCP, TCP_KEEPCNT, o->keep_alive_count);
+  }
+#endif
+#ifdef SO_BUSY_POLL
+  if (o->busy_poll > 0) {
+    rc |= lwmqtt_unix_set_option(fd, SOL_SOCKET, SO_BUSY_POLL, o->busy_poll);
+  }
+#endif
+
+  return rc;
+}
+
+static int lwmqtt_unix_connect_start(struct sockaddr_storage *addr, socklen_t len,
+                                     const lwmqtt_unix_options_t *options) {
+  // create non-blocking socket
+  int fd = socket(addr->ss_family, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  // apply options before connecting to affect the handshake
+  if (options != NULL && lwmqtt_unix_apply_options(fd, addr->ss_family, options) != 0) {
+    close(fd);
+    return -1;
+  }
+
+  // defer the handshake to the first write to send its data with the SYN, kernels without support ignore it
+#ifdef TCP_FASTOPEN_CONNECT
+  if (options != NULL && options->fast_open && addr->ss_family != AF_UNIX) {
+    lwmqtt_unix_set_option(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1);
+  }
+#endif
+
+  // start connect
+  int rc = connect(fd, (struct sockaddr *)addr, len);
+  if (rc < 0 && errno != EINPROGRESS) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+lwmqtt_err_t lwmqtt_unix_network_connect(lwmqtt_unix_network_t *network, char *host, int port) {
+  return lwmqtt_unix_network_connect_timeout(network, host, port, 0);
+}
+
+lwmqtt_err_t lwmqtt_unix_network_connect_timeout(lwmqtt_unix_network_t *network, char *host, int port,
+                                                 uint32_t timeout) {
+  return lwmqtt_unix_network_connect_options(network, host, port, timeout, NULL);
+}
+
+lwmqtt_err_t lwmqtt_unix_network_connect_options(lwmqtt_unix_network_t *network, char *host, int port,
+                                                 uint32_t timeout, const lwmqtt_unix_options_t *options) {
+  // close any open socket
+  lwmqtt_unix_network_disconnect(network);
+
+  // resolve addresses
+  lwmqtt_unix_addresses_t addresses;
+  lwmqtt_err_t err = lwmqtt_unix_resolve(options != NULL ? options->resolver : NULL, host, port, &addresses);
+  if (err != LWMQTT_SUCCESS) {
+    return err;
+  }
+
+  return lwmqtt_unix_network_connect_addresses(network, &addresses, timeout, options);
+}
+
+lwmqtt_err_t lwmqtt_unix_network_connect_addresses(lwmqtt_unix_network_t *network, lwmqtt_unix_addresses_t *addresses,
+                                                   uint32_t timeout, const lwmqtt_unix_options_t *options) {
+  // close any open socket
+  lwmqtt_unix_network_disconnect(network);
+
+  // get candidates
+  size_t count = addresses->count;
+
+  // prepare attempts
+  struct pollfd attempts[LWMQTT_UNIX_CONNECT_CANDIDATES];
+  size_t started = 0;
+  size_t active = 0;
+  int winner = -1;
+
+  // prepare times
+  uint64_t now = lwmqtt_unix_clock_get(NULL);
+  uint64_t deadline = timeout > 0 ? now + (uint64_t)timeout * 1000 : UINT64_MAX;
+  uint64_t next_start = now;
+  lwmqtt_err_t err = LWMQTT_NETWORK_FAILED_CONNECT;
+
+  // fast open attempts complete without a handshake, racing them would always pick the first address
+  bool race = true;
+#ifdef TCP_FASTOPEN_CONNECT
+  race = options == NULL || !options->fast_open;
+#endif
+
+  // run attempts until one succeeds, all failed or the deadline has been reached
+  for (;;) {
+    // start next attempt if due or if no other attempt is active
+    now = lwmqtt_unix_clock_get(NULL);
+    if (started < count && (now >= next_start || active == 0)) {
+      attempts[started].fd =
+          lwmqtt_unix_connect_start(&addresses->addrs[started], addresses->lens[started], options);
+      attempts[started].events = POLLOUT;
+      attempts[started].revents = 0;
+      if (attempts[started].fd >= 0) {
+        active++;
+        next_start = race ? now + LWMQTT_UNIX_CONNECT_DELAY * 1000 : UINT64_MAX;
+      }
+      started++;
+      continue;
+    }
+
+    // stop if all attempts failed
+    if (active == 0) {
+      break;
+    }
+
+    // stop if the deadline has been reached
+    if (now >= deadline) {
+      err = LWMQTT_NETWORK_TIMEOUT;
+      break;
+    }
 
-  // create new socket
-  network->socket = socket(AF_INET, SOCK_STREAM, 0);
-  if (network->socket < 0) {
+    // wait until an attempt completes, the next attempt is due or the deadline has been reached
+    uint64_t until = deadline;
+    if (started < count && next_start < until) {
+      until = next_start;
+    }
+    int wait = until == UINT64_MAX ? -1 : (int)((until - now + 999) / 1000);
+    int rc = poll(attempts, (nfds_t)started, wait);
+    if (rc < 0 && errno != EINTR) {
+      break;
+    }
+
+    // check completed attempts
+    for (size_t i = 0; i < started && rc > 0; i++) {
+      if (attempts[i].fd < 0 || attempts[i].revents == 0) {
+        continue;
+      }
+
+      // get result
+      int error = 0;
+      socklen_t error_len = sizeof(error);
+      if (getsockopt(attempts[i].fd, SOL_SOCKET, SO_ERROR, &error, &error_len) == 0 && error == 0 &&
+          (attempts[i].revents & POLLOUT) != 0) {
+        winner = (int)i;
+        break;
+      }
+
+      // close failed attempt
+      close(attempts[i].fd);
+      attempts[i].fd = -1;
+      active--;
+    }
+
+    // stop if an attempt succeeded
+    if (winner >= 0) {
+      break;
+    }
+  }
+
+  // close all other attempts
+  for (size_t i = 0; i < started; i++) {
+    if (attempts[i].fd >= 0 && (int)i != winner) {
+      close(attempts[i].fd);
+    }
+  }
+
+  // return error if no attempt succeeded
+  if (winner < 0) {
+    return err;
+  }
+
+  // make socket blocking again unless requested otherwise
+  int fd = attempts[winner].fd;
+  bool nonblocking = options != NULL && options->nonblocking;
+  if (!nonblocking && fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK) < 0) {
+    close(fd);
     return LWMQTT_NETWORK_FAILED_CONNECT;
   }
 
-  // connect socket
-  rc = connect(network->socket, (struct sockaddr *)&address, sizeof(address));
-  if (rc < 0) {
+  // request immediate acks on the established connection
+#ifdef TCP_QUICKACK
+  if (options != NULL && options->quick_ack && addresses->addrs[winner].ss_family != AF_UNIX &&
+      lwmqtt_unix_set_option(fd, IPPROTO_TCP, TCP_QUICKACK, 1) < 0) {
+    close(fd);
     return LWMQTT_NETWORK_FAILED_CONNECT;
   }
+#endif
+
+  // enable zero copy sends if supported
+  network->zerocopy = 0;
+  network->zerocopy_sends = 0;
+  network->zerocopy_completions = 0;
+  network->zerocopy_copies = 0;
+#if defined(SO_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+  if (options != NULL && options->zerocopy > 0 && lwmqtt_unix_set_option(fd, SOL_SOCKET, SO_ZEROCOPY, 1) == 0) {
+    network->zerocopy = options->zerocopy;
+  }
+#endif
+
+  // set socket and spin time
+  network->socket = fd;
+  network->nonblocking = nonblocking;
+  network->spin = options != NULL ? options->spin : 0;
+  network->spin_hits = 0;
+  network->spin_fallbacks = 0;
 
   return LWMQTT_SUCCESS;
 }
 
+static lwmqtt_err_t lwmqtt_unix_reap_zerocopy(lwmqtt_unix_network_t *network) {
+#if defined(SO_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+  // read all queued notifications
+  for (;;) {
+    char control[128];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(network->socket, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      return errno == EAGAIN ? LWMQTT_SUCCESS : LWMQTT_NETWORK_FAILED_READ;
+    }
+
+    // count completed sends, each notification covers a range of send ids
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      // skip messages that do not carry an extended error
+      if ((cmsg->cmsg_level != SOL_IP || cmsg->cmsg_type != IP_RECVERR) &&
+          (cmsg->cmsg_level != SOL_IPV6 || cmsg->cmsg_type != IPV6_RECVERR)) {
+        continue;
+      }
+
+      // skip errors that are not zero copy notifications
+      struct sock_extended_err *err = (struct sock_extended_err *)CMSG_DATA(cmsg);
+      if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY || err->ee_errno != 0) {
+        continue;
+      }
+      uint32_t count = err->ee_data - err->ee_info + 1;
+      network->zerocopy_completions += count;
+      if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+        network->zerocopy_copies += count;
+      }
+    }
+  }
+#else
+  return LWMQTT_SUCCESS;
+#endif
+}
+
+lwmqtt_err_t lwmqtt_unix_network_await_zerocopy(lwmqtt_unix_network_t *network, uint32_t timeout) {
+  // process completions until all sends have been completed or the timeout has been reached
+  uint64_t deadline = lwmqtt_unix_clock_get(NULL) + (uint64_t)timeout * 1000;
+  for (;;) {
+    lwmqtt_err_t err = lwmqtt_unix_reap_zerocopy(network);
+    if (err != LWMQTT_SUCCESS) {
+      return err;
+    } else if (network->zerocopy_completions == network->zerocopy_sends) {
+      return LWMQTT_SUCCESS;
+    }
+
+    // wait for the next notification, which is reported as an error condition
+    uint64_t now = lwmqtt_unix_clock_get(NULL);
+    if (now >= deadline) {
+      return LWMQTT_NETWORK_TIMEOUT;
+    }
+    struct pollfd fd = {network->socket, 0, 0};
+    if (poll(&fd, 1, (int)((deadline - now + 999) / 1000)) < 0 && errno != EINTR) {
+      return LWMQTT_NETWORK_FAILED_READ;
+    }
+  }
+}
+
 void lwmqtt_unix_network_disconnect(lwmqtt_unix_network_t *network) {
   // close socket if present
   if (network->socket) {
@@ -120,7 +591,46 @@ lwmqtt_err_t lwmqtt_unix_network_peek(lwmqtt_unix_network_t *network, size_t *av
   return LWMQTT_SUCCESS;
 }
 
+static ssize_t lwmqtt_unix_spin(lwmqtt_unix_network_t *network, uint8_t *buffer, size_t len, int flags,
+                                uint32_t timeout) {
+  // limit the spin time to the timeout
+  uint64_t spin = network->spin;
+  if (spin > (uint64_t)timeout * 1000) {
+    spin = (uint64_t)timeout * 1000;
+  }
+
+  // retry non-blocking receives until data arrives, an error occurs or the spin time has passed
+  uint64_t end = lwmqtt_unix_clock_get(NULL) + spin;
+  do {
+    ssize_t bytes = recv(network->socket, buffer, len, flags | MSG_DONTWAIT);
+    if (bytes >= 0) {
+      network->spin_hits++;
+      return bytes;
+    } else if (errno != EAGAIN && errno != EINTR) {
+      return -1;
+    }
+  } while (lwmqtt_unix_clock_get(NULL) < end);
+
+  // count fallback
+  network->spin_fallbacks++;
+  errno = EAGAIN;
+
+  return -1;
+}
+
 lwmqtt_err_t lwmqtt_unix_network_select(lwmqtt_unix_network_t *network, bool *available, uint32_t timeout) {
+  // spin before waiting
+  if (network->spin > 0) {
+    uint8_t byte;
+    ssize_t bytes = lwmqtt_unix_spin(network, &byte, 1, MSG_PEEK, timeout);
+    if (bytes < 0 && errno != EAGAIN) {
+      return LWMQTT_NETWORK_FAILED_READ;
+    } else if (bytes >= 0) {
+      *available = true;
+      return LWMQTT_SUCCESS;
+    }
+  }
+
   // prepare set
   fd_set set;
   FD_ZERO(&set);
@@ -143,6 +653,25 @@ lwmqtt_err_t lwmqtt_unix_network_read(void *ref, uint8_t *buffer, size_t len, si
   // cast network reference
   lwmqtt_unix_network_t *n = (lwmqtt_unix_network_t *)ref;
 
+  // spin before blocking
+  if (n->spin > 0) {
+    ssize_t bytes = lwmqtt_unix_spin(n, buffer, len, 0, timeout);
+    if (bytes < 0 && errno != EAGAIN) {
+      return LWMQTT_NETWORK_FAILED_READ;
+    } else if (bytes >= 0) {
+      *read += (size_t)bytes;
+      return LWMQTT_SUCCESS;
+    }
+  }
+
+  // wait for data on a non-blocking socket, the receive timeout only applies to blocking sockets
+  if (n->nonblocking) {
+    struct pollfd fd = {n->socket, POLLIN, 0};
+    if (poll(&fd, 1, (int)timeout) < 0 && errno != EINTR) {
+      return LWMQTT_NETWORK_FAILED_READ;
+    }
+  }
+
   // set timeout
   struct timeval t = {.tv_sec = timeout / 1000, .tv_usec = (timeout % 1000) * 1000};
   int rc = setsockopt(n->socket, SOL_SOCKET, SO_RCVTIMEO, (char *)&t, sizeof(t));
@@ -167,10 +696,8 @@ lwmqtt_err_t lwmqtt_unix_network_read(void *ref, uint8_t *buffer, size_t len, si
   return LWMQTT_SUCCESS;
 }
 
-lwmqtt_err_t lwmqtt_unix_network_write(void *ref, uint8_t *buffer, size_t len, size_t *sent, uint32_t timeout) {
-  // cast network reference
-  lwmqtt_unix_network_t *n = (lwmqtt_unix_network_t *)ref;
-
+static lwmqtt_err_t lwmqtt_unix_send(lwmqtt_unix_network_t *n, uint8_t *buffer, size_t len, size_t *sent,
+                                     uint32_t timeout, bool zerocopy) {
   // set timeout
   struct timeval t = {.tv_sec = timeout / 1000, .tv_usec = (timeout % 1000) * 1000};
   int rc = setsockopt(n->socket, SOL_SOCKET, SO_SNDTIMEO, (char *)&t, sizeof(t));
@@ -178,14 +705,33 @@ lwmqtt_err_t lwmqtt_unix_network_write(void *ref, uint8_t *buffer, size_t len, s
     return LWMQTT_NETWORK_FAILED_WRITE;
   }
 
-  // write to socket
-  int bytes = (int)send(n->socket, buffer, len, 0);
-  if (bytes < 0 && errno != EAGAIN) {
+  // write to socket, large payloads without a copy
+  int bytes;
+#if defined(SO_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+  if (zerocopy && n->zerocopy > 0 && len >= n->zerocopy) {
+    bytes = (int)send(n->socket, buffer, len, MSG_ZEROCOPY);
+    if (bytes >= 0) {
+      n->zerocopy_sends++;
+    } else if (errno == ENOBUFS) {
+      // fall back to a copy if the notification cannot be allocated
+      bytes = (int)send(n->socket, buffer, len, 0);
+    }
+  } else {
+    bytes = (int)send(n->socket, buffer, len, 0);
+  }
+#else
+  (void)zerocopy;
+  bytes = (int)send(n->socket, buffer, len, 0);
+#endif
+  if (bytes < 0 && errno != EAGAIN && errno != EINPROGRESS) {
     return LWMQTT_NETWORK_FAILED_WRITE;
   }
 
-  // prevent counting down if error is EAGAIN
-  if (bytes < 0) {
+  // report a full send buffer or a deferred fast open handshake that is still in progress of a non-blocking socket,
+  // a blocking socket has reached the timeout
+  if (bytes < 0 && n->nonblocking) {
+    return LWMQTT_WOULD_BLOCK;
+  } else if (bytes < 0) {
     bytes = 0;
   }
 
@@ -194,3 +740,13 @@ lwmqtt_err_t lwmqtt_unix_network_write(void *ref, uint8_t *buffer, size_t len, s
 
   return LWMQTT_SUCCESS;
 }
+
+lwmqtt_err_t lwmqtt_unix_network_write(void *ref, uint8_t *buffer, size_t len, size_t *sent, uint32_t timeout) {
+  // write with a copy, the buffer may be reused right away
+  return lwmqtt_unix_send((lwmqtt_unix_network_t *)ref, buffer, len, sent, timeout, false);
+}
+
+lwmqtt_err_t lwmqtt_unix_network_write_direct(void *ref, uint8_t *buffer, size_t len, size_t *sent, uint32_t timeout) {
+  // write caller owned payloads without a copy if large enough
+  return lwmqtt_unix_send((lwmqtt_unix_network_t *)ref, buffer, len, sent, timeout, true);
+}
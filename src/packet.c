@@ -1,5 +1,64 @@
+#include <string.h>
+
 #include "packet.h"
 
+static void lwmqtt_write_byte_unchecked(uint8_t **buf, uint8_t byte) {
+  // write byte
+  (*buf)[0] = byte;
+
+  // adjust pointer
+  *buf += 1;
+}
+
+static void lwmqtt_write_num_unchecked(uint8_t **buf, uint16_t num) {
+  // write bytes
+  (*buf)[0] = (uint8_t)(num / 256);
+  (*buf)[1] = (uint8_t)(num % 256);
+
+  // adjust pointer
+  *buf += 2;
+}
+
+static void lwmqtt_write_data_unchecked(uint8_t **buf, uint8_t *data, size_t len) {
+  // check zero length
+  if (len == 0) {
+    return;
+  }
+
+  // write data
+  memcpy(*buf, data, len);
+
+  // advance pointer
+  *buf += len;
+}
+
+static void lwmqtt_write_string_unchecked(uint8_t **buf, lwmqtt_string_t str) {
+  // write string length
+  lwmqtt_write_num_unchecked(buf, str.len);
+
+  // write data
+  lwmqtt_write_data_unchecked(buf, (uint8_t *)str.data, str.len);
+}
+
+static void lwmqtt_write_varnum_unchecked(uint8_t **buf, uint32_t varnum) {
+  // encode variadic number
+  do {
+    // calculate current byte
+    uint8_t byte = (uint8_t)(varnum % 128);
+
+    // change remaining length
+    varnum /= 128;
+
+    // set the top bit of this byte if there are more to encode
+    if (varnum > 0) {
+      byte |= 0x80u;
+    }
+
+    // write byte
+    *(*buf)++ = byte;
+  } while (varnum > 0);
+}
+
 lwmqtt_err_t lwmqtt_detect_packet_type(uint8_t *buf, size_t buf_len, lwmqtt_packet_type_t *packet_type) {
   // set default packet type
   *packet_type = LWMQTT_NO_PACKET;
@@ -57,9 +116,8 @@ lwmqtt_err_t lwmqtt_detect_remaining_length(uint8_t *buf, size_t buf_len, uint32
 
 lwmqtt_err_t lwmqtt_encode_connect(uint8_t *buf, size_t buf_len, size_t *len, lwmqtt_options_t options,
                                    lwmqtt_will_t *will) {
-  // prepare pointers
+  // prepare pointer
   uint8_t *buf_ptr = buf;
-  uint8_t *buf_end = buf + buf_len;
 
   // fixed header is 10
   uint32_t rem_len = 10;
@@ -89,33 +147,26 @@ lwmqtt_err_t lwmqtt_encode_connect(uint8_t *buf, size_t buf_len, size_t *len, lw
     return LWMQTT_REMAINING_LENGTH_OVERFLOW;
   }
 
+  // check buffer capacity once for the whole packet
+  if (buf_len < 1 + (size_t)rem_len_len + rem_len) {
+    return LWMQTT_BUFFER_TOO_SHORT;
+  }
+
   // prepare header
   uint8_t header = 0;
   lwmqtt_write_bits(&header, LWMQTT_CONNECT_PACKET, 4, 4);
 
   // write header
-  err = lwmqtt_write_byte(&buf_ptr, buf_end, header);
-  if (err != LWMQTT_SUCCESS) {
-    return err;
-  }
+  lwmqtt_write_byte_unchecked(&buf_ptr, header);
 
   // write remaining length
-  err = lwmqtt_write_varnum(&buf_ptr, buf_end, rem_len);
-  if (err != LWMQTT_SUCCESS) {
-    return err;
-  }
+  lwmqtt_write_varnum_unchecked(&buf_ptr, rem_len);
 
   // write version string
-  err = lwmqtt_write_string(&buf_ptr, buf_end, lwmqtt_string("MQTT"));
-  if (err != LWMQTT_SUCCESS) {
-    return err;
-  }
+  lwmqtt_write_string_unchecked(&buf_ptr, lwmqtt_string("MQTT"));
 
   // write version number
-  err = lwmqtt_write_byte(&buf_ptr, buf_end, 4);
-  if (err != LWMQTT_SUCCESS) {
-    return err;
-  }
+  lwmqtt_write_byte_unchecked(&buf_ptr, 4);
 
   // prepare flags
   uint8_t flags = 0;
@@ -141,58 +192,34 @@ lwmqtt_err_t lwmqtt_encode_connect(uint8_t *buf, size_t buf_len, size_t *len, lw
   }
 
   // write flags
-  err = lwmqtt_write_byte(&buf_ptr, buf_end, flags);
-  if (err != LWMQTT_SUCCESS) {
-    return err;
-  }
+  lwmqtt_write_byte_unchecked(&buf_ptr, flags);
 
   // write keep alive
-  err = lwmqtt_write_num(&buf_ptr, buf_end, options.keep_alive);
-  if (err != LWMQTT_SUCCESS) {
-    return err;
-  }
+  lwmqtt_write_num_unchecked(&buf_ptr, options.keep_alive);
 
   // write client id
-  err = lwmqtt_write_string(&buf_ptr, buf_end, options.client_id);
-  if (err != LWMQTT_SUCCESS) {
-    return err;
-  }
+  lwmqtt_write_string_unchecked(&buf_ptr, options.client_id);
 
   // write will if present
   if (will != NULL) {
     // write topic
-    err = lwmqtt_write_string(&buf_ptr, buf_end, will->topic);
-    if (err != LWMQTT_SUCCESS) {
-      return err;
-    }
+    lwmqtt_write_string_unchecked(&buf_ptr, will->topic);
 
     // write payload length
-    err = lwmqtt_write_num(&buf_ptr, buf_end, (uint16_t)will->payload.len);
-    if (err != LWMQTT_SUCCESS) {
-      return err;
-    }
+    lwmqtt_write_num_unchecked(&buf_ptr, (uint16_t)will->payload.len);
 
     // write payload
-    err = lwmqtt_write_data(&buf_ptr, buf_end, (uint8_t *)will->payload.data, will->payload.len);
-    if (err != LWMQTT_SUCCESS) {
-      return err;
-    }
+    lwmqtt_write_data_unchecked(&buf_ptr, (uint8_t *)will->payload.data, will->payload.len);
   }
 
   // write username if present
   if (options.username.len > 0) {
-    err = lwmqtt_write_string(&buf_ptr, buf_end, options.username);
-    if (err != LWMQTT_SUCCESS) {
-      return err;
-    }
+    lwmqtt_write_string_unchecked(&buf_ptr, options.username);
   }
 
   // write password if present
   if (options.username.len > 0 && options.password.len > 0) {
-    err = lwmqtt_write_string(&buf_ptr, buf_end, options.password);
-    if (err != LWMQTT_SUCCESS) {
-      return err;
-    }
+    lwmqtt_write_string_unchecked(&buf_ptr, options.password);
   }
 
   // set written length
@@ -472,11 +499,42 @@ lwmqtt_err_t lwmqtt_decode_publish(uint8_t *buf, size_t buf_len, bool *dup, uint
   return LWMQTT_SUCCESS;
 }
 
+static void lwmqtt_write_publish_header(uint8_t **buf_ptr, bool dup, uint16_t packet_id, lwmqtt_string_t topic,
+                                       lwmqtt_message_t msg, uint32_t rem_len) {
+  // prepare header
+  uint8_t header = 0;
+
+  // set packet type
+  lwmqtt_write_bits(&header, LWMQTT_PUBLISH_PACKET, 4, 4);
+
+  // set dup
+  lwmqtt_write_bits(&header, (uint8_t)(dup), 3, 1);
+
+  // set qos
+  lwmqtt_write_bits(&header, msg.qos, 1, 2);
+
+  // set retained
+  lwmqtt_write_bits(&header, (uint8_t)(msg.retained), 0, 1);
+
+  // write header
+  lwmqtt_write_byte_unchecked(buf_ptr, header);
+
+  // write remaining length
+  lwmqtt_write_varnum_unchecked(buf_ptr, rem_len);
+
+  // write topic
+  lwmqtt_write_string_unchecked(buf_ptr, topic);
+
+  // write packet id if qos is at least 1
+  if (msg.qos > 0) {
+    lwmqtt_write_num_unchecked(buf_ptr, packet_id);
+  }
+}
+
 lwmqtt_err_t lwmqtt_encode_publish(uint8_t *buf, size_t buf_len, size_t *len, bool dup, uint16_t packet_id,
                                    lwmqtt_string_t topic, lwmqtt_message_t msg) {
   // prepare pointer
   uint8_t *buf_ptr = buf;
-  uint8_t *buf_end = buf + buf_len;
 
   // calculate remaining length
   uint32_t rem_len = 2 + topic.len + (uint32_t)msg.payload_len;
@@ -491,55 +549,124 @@ lwmqtt_err_t lwmqtt_encode_publish(uint8_t *buf, size_t buf_len, size_t *len, bo
     return LWMQTT_REMAINING_LENGTH_OVERFLOW;
   }
 
-  // prepare header
-  uint8_t header = 0;
+  // check buffer capacity once for the whole packet
+  if (buf_len < 1 + (size_t)rem_len_len + rem_len) {
+    return LWMQTT_BUFFER_TOO_SHORT;
+  }
 
-  // set packet type
-  lwmqtt_write_bits(&header, LWMQTT_PUBLISH_PACKET, 4, 4);
+  // write fixed and variable header
+  lwmqtt_write_publish_header(&buf_ptr, dup, packet_id, topic, msg, rem_len);
 
-  // set dup
-  lwmqtt_write_bits(&header, (uint8_t)(dup), 3, 1);
+  // write payload
+  lwmqtt_write_data_unchecked(&buf_ptr, msg.payload, msg.payload_len);
 
-  // set qos
-  lwmqtt_write_bits(&header, msg.qos, 1, 2);
+  // set length
+  *len = buf_ptr - buf;
 
-  // set retained
-  lwmqtt_write_bits(&header, (uint8_t)(msg.retained), 0, 1);
+  return LWMQTT_SUCCESS;
+}
 
-  // write header
-  err = lwmqtt_write_byte(&buf_ptr, buf_end, header);
-  if (err != LWMQTT_SUCCESS) {
-    return err;
+lwmqtt_err_t lwmqtt_encode_publish_header(uint8_t *buf, size_t buf_len, size_t *len, bool dup, uint16_t packet_id,
+                                          lwmqtt_string_t topic, lwmqtt_message_t msg) {
+  // prepare pointer
+  uint8_t *buf_ptr = buf;
+
+  // calculate variable header length
+  uint32_t header_len = 2 + topic.len;
+  if (msg.qos > 0) {
+    header_len += 2;
   }
 
-  // write remaining length
-  err = lwmqtt_write_varnum(&buf_ptr, buf_end, rem_len);
-  if (err != LWMQTT_SUCCESS) {
-    return err;
+  // check remaining length length
+  uint32_t rem_len = header_len + (uint32_t)msg.payload_len;
+  int rem_len_len;
+  lwmqtt_err_t err = lwmqtt_varnum_length(rem_len, &rem_len_len);
+  if (err == LWMQTT_VARNUM_OVERFLOW) {
+    return LWMQTT_REMAINING_LENGTH_OVERFLOW;
   }
 
-  // write topic
-  err = lwmqtt_write_string(&buf_ptr, buf_end, topic);
-  if (err != LWMQTT_SUCCESS) {
-    return err;
+  // check buffer capacity for the header only
+  if (buf_len < 1 + (size_t)rem_len_len + header_len) {
+    return LWMQTT_BUFFER_TOO_SHORT;
   }
 
-  // write packet id if qos is at least 1
+  // write fixed and variable header
+  lwmqtt_write_publish_header(&buf_ptr, dup, packet_id, topic, msg, rem_len);
+
+  // set length
+  *len = buf_ptr - buf;
+
+  return LWMQTT_SUCCESS;
+}
+
+lwmqtt_err_t lwmqtt_encode_publish_transformed(uint8_t *buf, size_t buf_len, size_t *len, bool dup,
+                                               uint16_t packet_id, lwmqtt_string_t topic, lwmqtt_message_t msg,
+                                               lwmqtt_transform_t transform, void *ref) {
+  // encode regularly if no transform is set
+  if (transform == NULL) {
+    return lwmqtt_encode_publish(buf, buf_len, len, dup, packet_id, topic, msg);
+  }
+
+  // calculate variable header length
+  uint32_t header_len = 2 + topic.len;
   if (msg.qos > 0) {
-    err = lwmqtt_write_num(&buf_ptr, buf_end, packet_id);
-    if (err != LWMQTT_SUCCESS) {
-      return err;
-    }
+    header_len += 2;
   }
 
-  // write payload
-  err = lwmqtt_write_data(&buf_ptr, buf_end, msg.payload, msg.payload_len);
+  // estimate remaining length length using the untransformed payload
+  int rem_len_len;
+  lwmqtt_err_t err = lwmqtt_varnum_length(header_len + (uint32_t)msg.payload_len, &rem_len_len);
+  if (err == LWMQTT_VARNUM_OVERFLOW) {
+    rem_len_len = 4;
+  }
+
+  // check buffer capacity
+  size_t offset = 1 + rem_len_len + header_len;
+  if (buf_len < offset) {
+    return LWMQTT_BUFFER_TOO_SHORT;
+  }
+
+  // transform payload directly into the buffer
+  size_t payload_len = 0;
+  bool transformed = false;
+  err = transform(ref, msg.payload, msg.payload_len, buf + offset, buf_len - offset, &payload_len, &transformed);
   if (err != LWMQTT_SUCCESS) {
     return err;
   }
 
+  // encode regularly if the payload has not been transformed
+  if (!transformed) {
+    return lwmqtt_encode_publish(buf, buf_len, len, dup, packet_id, topic, msg);
+  }
+
+  // calculate actual remaining length
+  uint32_t rem_len = header_len + (uint32_t)payload_len;
+
+  // check actual remaining length length
+  int actual_rem_len_len;
+  err = lwmqtt_varnum_length(rem_len, &actual_rem_len_len);
+  if (err == LWMQTT_VARNUM_OVERFLOW) {
+    return LWMQTT_REMAINING_LENGTH_OVERFLOW;
+  }
+
+  // move payload if the estimate was wrong
+  if (actual_rem_len_len != rem_len_len) {
+    size_t actual_offset = 1 + actual_rem_len_len + header_len;
+    if (actual_offset > buf_len || buf_len - actual_offset < payload_len) {
+      return LWMQTT_BUFFER_TOO_SHORT;
+    }
+
+    memmove(buf + actual_offset, buf + offset, payload_len);
+  }
+
+  // prepare pointer
+  uint8_t *buf_ptr = buf;
+
+  // write fixed and variable header in front of the payload
+  lwmqtt_write_publish_header(&buf_ptr, dup, packet_id, topic, msg, rem_len);
+
   // set length
-  *len = buf_ptr - buf;
+  *len = (buf_ptr - buf) + payload_len;
 
   return LWMQTT_SUCCESS;
 }
@@ -548,7 +675,6 @@ lwmqtt_err_t lwmqtt_encode_subscribe(uint8_t *buf, size_t buf_len, size_t *len,
                                      lwmqtt_string_t *topic_filters, lwmqtt_qos_t *qos_levels) {
   // prepare pointer
   uint8_t *buf_ptr = buf;
-  uint8_t *buf_end = buf + buf_len;
 
   // calculate remaining length
   uint32_t rem_len = 2;
@@ -563,6 +689,11 @@ lwmqtt_err_t lwmqtt_encode_subscribe(uint8_t *buf, size_t buf_len, size_t *len,
     return LWMQTT_REMAINING_LENGTH_OVERFLOW;
   }
 
+  // check buffer capacity once for the whole packet
+  if (buf_len < 1 + (size_t)rem_len_len + rem_len) {
+    return LWMQTT_BUFFER_TOO_SHORT;
+  }
+
   // prepare header
   uint8_t header = 0;
 
@@ -573,36 +704,21 @@ lwmqtt_err_t lwmqtt_encode_subscribe(uint8_t *buf, size_t buf_len, size_t *len,
   lwmqtt_write_bits(&header, LWMQTT_QOS1, 1, 2);
 
   // write header
-  err = lwmqtt_write_byte(&buf_ptr, buf_end, header);
-  if (err != LWMQTT_SUCCESS) {
-    return err;
-  }
+  lwmqtt_write_byte_unchecked(&buf_ptr, header);
 
   // write remaining length
-  err = lwmqtt_write_varnum(&buf_ptr, buf_end, rem_len);
-  if (err != LWMQTT_SUCCESS) {
-    return err;
-  }
+  lwmqtt_write_varnum_unchecked(&buf_ptr, rem_len);
 
   // write packet id
-  err = lwmqtt_write_num(&buf_ptr, buf_end, packet_id);
-  if (err != LWMQTT_SUCCESS) {
-    return err;
-  }
+  lwmqtt_write_num_unchecked(&buf_ptr, packet_id);
 
   // write all subscriptions
   for (int i = 0; i < count; i++) {
     // write topic
-    err = lwmqtt_write_string(&buf_ptr, buf_end, topic_filters[i]);
-    if (err != LWMQTT_SUCCESS) {
-      return err;
-    }
+    lwmqtt_write_string_unchecked(&buf_ptr, topic_filters[i]);
 
     // write qos level
-    err = lwmqtt_write_byte(&buf_ptr, buf_end, (uint8_t)qos_levels[i]);
-    if (err != LWMQTT_SUCCESS) {
-      return err;
-    }
+    lwmqtt_write_byte_unchecked(&buf_ptr, (uint8_t)qos_levels[i]);
   }
 
   // set length
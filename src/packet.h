@@ -3,27 +3,6 @@
 
 #include "helpers.h"
 
-/**
- * The available packet types.
- */
-typedef enum {
-  LWMQTT_NO_PACKET = 0,
-  LWMQTT_CONNECT_PACKET = 1,
-  LWMQTT_CONNACK_PACKET,
-  LWMQTT_PUBLISH_PACKET,
-  LWMQTT_PUBACK_PACKET,
-  LWMQTT_PUBREC_PACKET,
-  LWMQTT_PUBREL_PACKET,
-  LWMQTT_PUBCOMP_PACKET,
-  LWMQTT_SUBSCRIBE_PACKET,
-  LWMQTT_SUBACK_PACKET,
-  LWMQTT_UNSUBSCRIBE_PACKET,
-  LWMQTT_UNSUBACK_PACKET,
-  LWMQTT_PINGREQ_PACKET,
-  LWMQTT_PINGRESP_PACKET,
-  LWMQTT_DISCONNECT_PACKET
-} lwmqtt_packet_type_t;
-
 /**
  * Will detect the packet type from the at least one byte long buffer.
  *
@@ -139,6 +118,43 @@ lwmqtt_err_t lwmqtt_decode_publish(uint8_t *buf, size_t buf_len, bool *dup, uint
 lwmqtt_err_t lwmqtt_encode_publish(uint8_t *buf, size_t buf_len, size_t *len, bool dup, uint16_t packet_id,
                                    lwmqtt_string_t topic, lwmqtt_message_t msg);
 
+/**
+ * Encodes the fixed and variable header of a publish packet into the supplied buffer. The remaining length includes
+ * the payload, which must be written right after the header.
+ *
+ * @param buf - The buffer into which the header will be encoded.
+ * @param buf_len - The length of the specified buffer.
+ * @param len - The encoded length of the header.
+ * @param dup - The dup flag.
+ * @param packet_id  - The packet id.
+ * @param topic - The topic.
+ * @param msg - The message.
+ * @return An error value.
+ */
+lwmqtt_err_t lwmqtt_encode_publish_header(uint8_t *buf, size_t buf_len, size_t *len, bool dup, uint16_t packet_id,
+                                          lwmqtt_string_t topic, lwmqtt_message_t msg);
+
+/**
+ * Encodes a publish packet into the supplied buffer while transforming the payload directly into the buffer.
+ *
+ * If no transform is given or the transform leaves the payload untouched, the packet is encoded like with
+ * lwmqtt_encode_publish().
+ *
+ * @param buf - The buffer into which the packet will be encoded.
+ * @param buf_len - The length of the specified buffer.
+ * @param len - The encoded length of the packet.
+ * @param dup - The dup flag.
+ * @param packet_id  - The packet id.
+ * @param topic - The topic.
+ * @param msg - The message.
+ * @param transform - The payload transform.
+ * @param ref - The reference passed to the transform.
+ * @return An error value.
+ */
+lwmqtt_err_t lwmqtt_encode_publish_transformed(uint8_t *buf, size_t buf_len, size_t *len, bool dup,
+                                               uint16_t packet_id, lwmqtt_string_t topic, lwmqtt_message_t msg,
+                                               lwmqtt_transform_t transform, void *ref);
+
 /**
  * Encodes a subscribe packet into the supplied buffer.
  *
@@ -0,0 +1,60 @@
+#ifndef LWMQTT_PROBES_H
+#define LWMQTT_PROBES_H
+
+/**
+ * Static tracepoints that can be attached to with tools like bpftrace, perf or SystemTap. The probes are only compiled
+ * in if LWMQTT_USDT is defined, which requires <sys/sdt.h> from the SystemTap development headers. Otherwise they
+ * expand to nothing.
+ *
+ * Probes of the "lwmqtt" provider:
+ *
+ * - packet__received(int type, size_t len)
+ * - packet__sent(int type, size_t len)
+ * - callback__entry(uint16_t topic_len, size_t payload_len)
+ * - callback__return()
+ * - network__read__begin(size_t len)
+ * - network__read__end(int err, size_t read)
+ * - network__write__begin(size_t len)
+ * - network__write__end(int err, size_t sent)
+ * - timeout(int write)
+ *
+ * Example: bpftrace -e 'usdt:./app:lwmqtt:packet__received { @[arg0] = hist(arg1); }'
+ *
+ * Every probe has a semaphore that tracers increment while they are attached. LWMQTT_PROBE_ENABLED() checks it to
+ * skip work that is only needed for a probe. This header must only be included by a single translation unit, as it
+ * defines the semaphores.
+ */
+
+#ifdef LWMQTT_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define LWMQTT_PROBE_SEMAPHORE(name) \
+  __extension__ unsigned short lwmqtt_##name##_semaphore __attribute__((unused, section(".probes")))
+
+LWMQTT_PROBE_SEMAPHORE(packet__received);
+LWMQTT_PROBE_SEMAPHORE(packet__sent);
+LWMQTT_PROBE_SEMAPHORE(callback__entry);
+LWMQTT_PROBE_SEMAPHORE(callback__return);
+LWMQTT_PROBE_SEMAPHORE(network__read__begin);
+LWMQTT_PROBE_SEMAPHORE(network__read__end);
+LWMQTT_PROBE_SEMAPHORE(network__write__begin);
+LWMQTT_PROBE_SEMAPHORE(network__write__end);
+LWMQTT_PROBE_SEMAPHORE(timeout);
+
+#define LWMQTT_PROBE(name) DTRACE_PROBE(lwmqtt, name)
+#define LWMQTT_PROBE1(name, a) DTRACE_PROBE1(lwmqtt, name, a)
+#define LWMQTT_PROBE2(name, a, b) DTRACE_PROBE2(lwmqtt, name, a, b)
+#define LWMQTT_PROBE_ENABLED(name) __builtin_expect(lwmqtt_##name##_semaphore != 0, 0)
+
+#else
+
+#define LWMQTT_PROBE(name) ((void)0)
+#define LWMQTT_PROBE1(name, a) ((void)(a))
+#define LWMQTT_PROBE2(name, a, b) ((void)(a), (void)(b))
+#define LWMQTT_PROBE_ENABLED(name) 0
+
+#endif
+
+#endif  // LWMQTT_PROBES_H
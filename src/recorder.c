@@ -0,0 +1,53 @@
+#include <stdio.h>
+
+#include <lwmqtt/recorder.h>
+
+static const char *lwmqtt_packet_type_names[16] = {
+    "NONE",     "CONNECT", "CONNACK",   "PUBLISH",  "PUBACK",  "PUBREC",   "PUBREL",     "PUBCOMP",
+    "SUBSCRIBE", "SUBACK", "UNSUBSCRIBE", "UNSUBACK", "PINGREQ", "PINGRESP", "DISCONNECT", "RESERVED"};
+
+void lwmqtt_recorder_init(lwmqtt_recorder_t *recorder, lwmqtt_event_t *events, uint32_t size, void *ref,
+                          lwmqtt_clock_get_t get) {
+  recorder->events = events;
+  recorder->mask = size - 1;
+  recorder->head = 0;
+  recorder->last_type = 0;
+  recorder->clock_ref = ref;
+  recorder->clock_get = get;
+}
+
+uint32_t lwmqtt_recorder_dump(lwmqtt_recorder_t *recorder, lwmqtt_event_t *events, uint32_t count) {
+  // get number of written events
+#if defined(__GNUC__)
+  uint32_t head = __atomic_load_n(&recorder->head, __ATOMIC_ACQUIRE);
+#else
+  uint32_t head = recorder->head;
+#endif
+
+  // calculate number of available events
+  uint32_t available = head < recorder->mask + 1 ? head : recorder->mask + 1;
+  if (count > available) {
+    count = available;
+  }
+
+  // copy most recent events
+  for (uint32_t i = 0; i < count; i++) {
+    events[i] = recorder->events[(head - count + i) & recorder->mask];
+  }
+
+  return count;
+}
+
+int lwmqtt_event_format(lwmqtt_event_t *event, char *buf, size_t size) {
+  // format error events
+  if (event->direction == LWMQTT_EVENT_ERROR) {
+    return snprintf(buf, size, "%10lu err %d after %s", (unsigned long)event->time, (int)event->err,
+                    lwmqtt_packet_type_names[event->packet_type & 0x0F]);
+  }
+
+  // format packet events
+  return snprintf(buf, size, "%10lu %s %s id=%u len=%lu", (unsigned long)event->time,
+                  event->direction == LWMQTT_EVENT_IN ? "in " : "out",
+                  lwmqtt_packet_type_names[event->packet_type & 0x0F], (unsigned)event->packet_id,
+                  (unsigned long)event->len);
+}
@@ -0,0 +1,826 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "broker.h"
+
+typedef struct mock_packet_t {
+  struct mock_packet_t *next;
+  uint64_t release;
+  size_t len, sent;
+  uint8_t data[];
+} mock_packet_t;
+
+typedef struct {
+  char *filter;
+  uint8_t qos;
+} mock_subscription_t;
+
+typedef struct {
+  char *topic;
+  uint8_t *payload;
+  size_t payload_len;
+  uint8_t qos;
+  bool retain;
+} mock_message_t;
+
+typedef struct {
+  int fd;
+  bool connected, closed;
+  char *client_id;
+  uint16_t next_id;
+
+  uint8_t *in;
+  size_t in_len, in_cap;
+
+  mock_packet_t *out_head, *out_tail;
+
+  mock_subscription_t *subs;
+  int sub_count;
+
+  bool has_will;
+  mock_message_t will;
+} mock_conn_t;
+
+struct mock_broker_t {
+  mock_broker_options_t options;
+  int port;
+  int listener;
+  int wake[2];
+  pthread_t thread;
+
+  mock_conn_t **conns;
+  int conn_count, conn_cap;
+
+  mock_message_t *retained;
+  int retained_count;
+};
+
+static uint64_t mock_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static bool mock_match(const char *filter, const char *topic) {
+  // match levels
+  while (*filter != '\0') {
+    // multi level wildcard matches the rest
+    if (filter[0] == '#') {
+      return true;
+    }
+
+    // single level wildcard matches one level
+    if (filter[0] == '+') {
+      while (*topic != '\0' && *topic != '/') {
+        topic++;
+      }
+      filter++;
+    } else {
+      // compare level
+      while (*filter != '\0' && *filter != '/') {
+        if (*filter++ != *topic++) {
+          return false;
+        }
+      }
+      if (*topic != '\0' && *topic != '/') {
+        return false;
+      }
+    }
+
+    // both must end or continue together
+    if (*filter == '\0' || *topic == '\0') {
+      // a trailing "/#" also matches the parent level
+      return *filter == *topic || strcmp(filter, "/#") == 0;
+    }
+
+    // skip separators
+    filter++;
+    topic++;
+  }
+
+  return *topic == '\0';
+}
+
+static void mock_queue(mock_broker_t *broker, mock_conn_t *conn, uint8_t header, const uint8_t *head, size_t head_len,
+                       const uint8_t *body, size_t body_len) {
+  // encode remaining length
+  uint8_t rem_len[4];
+  size_t rem_len_len = 0;
+  size_t len = head_len + body_len;
+  do {
+    rem_len[rem_len_len] = (uint8_t)(len % 128);
+    len /= 128;
+    if (len > 0) {
+      rem_len[rem_len_len] |= 0x80;
+    }
+    rem_len_len++;
+  } while (len > 0);
+
+  // allocate packet
+  size_t total = 1 + rem_len_len + head_len + body_len;
+  mock_packet_t *packet = malloc(sizeof(mock_packet_t) + total);
+  packet->next = NULL;
+  packet->release = mock_now() + broker->options.latency;
+  packet->len = total;
+  packet->sent = 0;
+
+  // write packet
+  packet->data[0] = header;
+  memcpy(packet->data + 1, rem_len, rem_len_len);
+  if (head_len > 0) {
+    memcpy(packet->data + 1 + rem_len_len, head, head_len);
+  }
+  if (body_len > 0) {
+    memcpy(packet->data + 1 + rem_len_len + head_len, body, body_len);
+  }
+
+  // append packet
+  if (conn->out_tail != NULL) {
+    conn->out_tail->next = packet;
+  } else {
+    conn->out_head = packet;
+  }
+  conn->out_tail = packet;
+}
+
+static void mock_queue_ack(mock_broker_t *broker, mock_conn_t *conn, uint8_t header, uint16_t packet_id) {
+  uint8_t id[2] = {(uint8_t)(packet_id >> 8), (uint8_t)(packet_id & 0xFF)};
+  mock_queue(broker, conn, header, id, 2, NULL, 0);
+}
+
+static void mock_deliver(mock_broker_t *broker, mock_conn_t *conn, mock_message_t *msg, uint8_t qos, bool retain) {
+  // prepare variable header
+  size_t topic_len = strlen(msg->topic);
+  uint8_t *head = malloc(topic_len + 4);
+  head[0] = (uint8_t)(topic_len >> 8);
+  head[1] = (uint8_t)(topic_len & 0xFF);
+  memcpy(head + 2, msg->topic, topic_len);
+  size_t head_len = 2 + topic_len;
+
+  // add packet id
+  if (qos > 0) {
+    conn->next_id = conn->next_id == 65535 ? 1 : conn->next_id + 1;
+    head[head_len++] = (uint8_t)(conn->next_id >> 8);
+    head[head_len++] = (uint8_t)(conn->next_id & 0xFF);
+  }
+
+  // queue packet
+  uint8_t header = (uint8_t)(0x30 | (qos << 1) | (retain ? 1 : 0));
+  mock_queue(broker, conn, header, head, head_len, msg->payload, msg->payload_len);
+  free(head);
+}
+
+static void mock_free_message(mock_message_t *msg) {
+  free(msg->topic);
+  free(msg->payload);
+}
+
+static void mock_retain(mock_broker_t *broker, mock_message_t *msg) {
+  // find existing message
+  int i = 0;
+  while (i < broker->retained_count && strcmp(broker->retained[i].topic, msg->topic) != 0) {
+    i++;
+  }
+
+  // remove existing message
+  if (i < broker->retained_count) {
+    mock_free_message(&broker->retained[i]);
+    broker->retained[i] = broker->retained[--broker->retained_count];
+  }
+
+  // empty payloads only clear the retained message
+  if (msg->payload_len == 0) {
+    return;
+  }
+
+  // store copy
+  broker->retained = realloc(broker->retained, sizeof(mock_message_t) * (size_t)(broker->retained_count + 1));
+  mock_message_t *copy = &broker->retained[broker->retained_count++];
+  copy->topic = strdup(msg->topic);
+  copy->payload = malloc(msg->payload_len);
+  memcpy(copy->payload, msg->payload, msg->payload_len);
+  copy->payload_len = msg->payload_len;
+  copy->qos = msg->qos;
+  copy->retain = true;
+}
+
+static void mock_route(mock_broker_t *broker, mock_message_t *msg) {
+  // store retained message
+  if (msg->retain) {
+    mock_retain(broker, msg);
+  }
+
+  // deliver to all matching connections once with the highest granted qos
+  for (int i = 0; i < broker->conn_count; i++) {
+    mock_conn_t *conn = broker->conns[i];
+    if (!conn->connected || conn->closed) {
+      continue;
+    }
+
+    int qos = -1;
+    for (int j = 0; j < conn->sub_count; j++) {
+      if (conn->subs[j].qos > qos && mock_match(conn->subs[j].filter, msg->topic)) {
+        qos = conn->subs[j].qos;
+      }
+    }
+
+    if (qos >= 0) {
+      mock_deliver(broker, conn, msg, msg->qos < qos ? msg->qos : (uint8_t)qos, false);
+    }
+  }
+}
+
+static bool mock_read_string(uint8_t **ptr, uint8_t *end, char **str, size_t *str_len) {
+  // read length
+  if (end - *ptr < 2) {
+    return false;
+  }
+  size_t len = (size_t)(((*ptr)[0] << 8) | (*ptr)[1]);
+  *ptr += 2;
+
+  // read data
+  if ((size_t)(end - *ptr) < len) {
+    return false;
+  }
+  *str = malloc(len + 1);
+  memcpy(*str, *ptr, len);
+  (*str)[len] = '\0';
+  *ptr += len;
+
+  // set length if requested
+  if (str_len != NULL) {
+    *str_len = len;
+  }
+
+  return true;
+}
+
+static void mock_close(mock_broker_t *broker, mock_conn_t *conn, bool graceful) {
+  // ignore already closed connections
+  if (conn->closed) {
+    return;
+  }
+
+  // mark closed
+  conn->closed = true;
+
+  // publish will on ungraceful close
+  if (conn->has_will && !graceful) {
+    mock_route(broker, &conn->will);
+  }
+}
+
+static bool mock_handle_connect(mock_broker_t *broker, mock_conn_t *conn, uint8_t *ptr, uint8_t *end) {
+  // read protocol name
+  char *protocol = NULL;
+  if (!mock_read_string(&ptr, end, &protocol, NULL)) {
+    return false;
+  }
+  free(protocol);
+
+  // read level, flags and keep alive
+  if (end - ptr < 4) {
+    return false;
+  }
+  uint8_t flags = ptr[1];
+  ptr += 4;
+
+  // read client id
+  if (!mock_read_string(&ptr, end, &conn->client_id, NULL)) {
+    return false;
+  }
+
+  // read will
+  if (flags & 0x04) {
+    char *payload = NULL;
+    if (!mock_read_string(&ptr, end, &conn->will.topic, NULL) ||
+        !mock_read_string(&ptr, end, &payload, &conn->will.payload_len)) {
+      return false;
+    }
+    conn->will.payload = (uint8_t *)payload;
+    conn->will.qos = (uint8_t)((flags >> 3) & 3);
+    conn->will.retain = (flags & 0x20) != 0;
+    conn->has_will = true;
+  }
+
+  // take over existing connections with the same client id
+  for (int i = 0; i < broker->conn_count; i++) {
+    mock_conn_t *other = broker->conns[i];
+    if (other != conn && other->connected && other->client_id != NULL &&
+        strcmp(other->client_id, conn->client_id) == 0) {
+      mock_close(broker, other, false);
+    }
+  }
+
+  // accept connection
+  conn->connected = true;
+  uint8_t connack[2] = {0, 0};
+  mock_queue(broker, conn, 0x20, connack, 2, NULL, 0);
+
+  return true;
+}
+
+static bool mock_handle_publish(mock_broker_t *broker, mock_conn_t *conn, uint8_t header, uint8_t *ptr, uint8_t *end) {
+  // prepare message
+  mock_message_t msg;
+  msg.qos = (uint8_t)((header >> 1) & 3);
+  msg.retain = (header & 1) != 0;
+
+  // read topic
+  if (!mock_read_string(&ptr, end, &msg.topic, NULL)) {
+    return false;
+  }
+
+  // read packet id
+  uint16_t packet_id = 0;
+  if (msg.qos > 0) {
+    if (end - ptr < 2) {
+      free(msg.topic);
+      return false;
+    }
+    packet_id = (uint16_t)((ptr[0] << 8) | ptr[1]);
+    ptr += 2;
+  }
+
+  // drop message on simulated loss
+  if (broker->options.loss > 0 && (double)rand_r(&broker->options.seed) / RAND_MAX < broker->options.loss) {
+    free(msg.topic);
+    return true;
+  }
+
+  // acknowledge message
+  if (msg.qos == 1) {
+    mock_queue_ack(broker, conn, 0x40, packet_id);
+  } else if (msg.qos == 2) {
+    mock_queue_ack(broker, conn, 0x50, packet_id);
+  }
+
+  // route message
+  msg.payload = ptr;
+  msg.payload_len = (size_t)(end - ptr);
+  mock_route(broker, &msg);
+  free(msg.topic);
+
+  return true;
+}
+
+static bool mock_handle_subscribe(mock_broker_t *broker, mock_conn_t *conn, uint8_t *ptr, uint8_t *end) {
+  // read packet id
+  if (end - ptr < 2) {
+    return false;
+  }
+  uint8_t *packet_id = ptr;
+  ptr += 2;
+
+  // prepare return codes and indexes of the subscriptions
+  uint8_t *codes = malloc((size_t)(end - ptr));
+  int *indexes = malloc(sizeof(int) * (size_t)(end - ptr));
+  size_t count = 0;
+
+  // read subscriptions
+  while (ptr < end) {
+    char *filter = NULL;
+    if (!mock_read_string(&ptr, end, &filter, NULL) || ptr == end) {
+      free(filter);
+      free(codes);
+      free(indexes);
+      return false;
+    }
+    uint8_t qos = *ptr++ & 3;
+    if (qos > 2) {
+      qos = 2;
+    }
+
+    // replace or add subscription
+    int i = 0;
+    while (i < conn->sub_count && strcmp(conn->subs[i].filter, filter) != 0) {
+      i++;
+    }
+    if (i < conn->sub_count) {
+      free(conn->subs[i].filter);
+    } else {
+      conn->subs = realloc(conn->subs, sizeof(mock_subscription_t) * (size_t)(conn->sub_count + 1));
+      conn->sub_count++;
+    }
+    conn->subs[i].filter = filter;
+    conn->subs[i].qos = qos;
+    indexes[count] = i;
+    codes[count++] = qos;
+  }
+
+  // queue suback
+  mock_queue(broker, conn, 0x90, packet_id, 2, codes, count);
+
+  // deliver retained messages that match the new subscriptions
+  for (size_t i = 0; i < count; i++) {
+    mock_subscription_t *sub = &conn->subs[indexes[i]];
+    for (int j = 0; j < broker->retained_count; j++) {
+      mock_message_t *msg = &broker->retained[j];
+      if (mock_match(sub->filter, msg->topic)) {
+        mock_deliver(broker, conn, msg, msg->qos < sub->qos ? msg->qos : sub->qos, true);
+      }
+    }
+  }
+
+  free(codes);
+  free(indexes);
+
+  return true;
+}
+
+static bool mock_handle_unsubscribe(mock_broker_t *broker, mock_conn_t *conn, uint8_t *ptr, uint8_t *end) {
+  // read packet id
+  if (end - ptr < 2) {
+    return false;
+  }
+  uint16_t packet_id = (uint16_t)((ptr[0] << 8) | ptr[1]);
+  ptr += 2;
+
+  // remove subscriptions
+  while (ptr < end) {
+    char *filter = NULL;
+    if (!mock_read_string(&ptr, end, &filter, NULL)) {
+      return false;
+    }
+    for (int i = 0; i < conn->sub_count; i++) {
+      if (strcmp(conn->subs[i].filter, filter) == 0) {
+        free(conn->subs[i].filter);
+        conn->subs[i] = conn->subs[--conn->sub_count];
+        break;
+      }
+    }
+    free(filter);
+  }
+
+  // queue unsuback
+  mock_queue_ack(broker, conn, 0xB0, packet_id);
+
+  return true;
+}
+
+static bool mock_handle(mock_broker_t *broker, mock_conn_t *conn, uint8_t header, uint8_t *ptr, uint8_t *end) {
+  // require connect first
+  uint8_t type = header >> 4;
+  if (!conn->connected && type != 1) {
+    return false;
+  }
+
+  // get packet id of acks
+  uint16_t packet_id = end - ptr >= 2 ? (uint16_t)((ptr[0] << 8) | ptr[1]) : 0;
+
+  switch (type) {
+    case 1:
+      return !conn->connected && mock_handle_connect(broker, conn, ptr, end);
+    case 3:
+      return mock_handle_publish(broker, conn, header, ptr, end);
+    case 4:
+    case 7:
+      return true;
+    case 5:
+      mock_queue_ack(broker, conn, 0x62, packet_id);
+      return true;
+    case 6:
+      mock_queue_ack(broker, conn, 0x70, packet_id);
+      return true;
+    case 8:
+      return mock_handle_subscribe(broker, conn, ptr, end);
+    case 10:
+      return mock_handle_unsubscribe(broker, conn, ptr, end);
+    case 12:
+      mock_queue(broker, conn, 0xD0, NULL, 0, NULL, 0);
+      return true;
+    case 14:
+      mock_close(broker, conn, true);
+      return true;
+    default:
+      return false;
+  }
+}
+
+static void mock_read(mock_broker_t *broker, mock_conn_t *conn) {
+  // grow buffer
+  if (conn->in_cap - conn->in_len < 4096) {
+    conn->in_cap = conn->in_cap * 2 + 4096;
+    conn->in = realloc(conn->in, conn->in_cap);
+  }
+
+  // read available data
+  ssize_t n = recv(conn->fd, conn->in + conn->in_len, conn->in_cap - conn->in_len, 0);
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+    mock_close(broker, conn, false);
+    return;
+  } else if (n < 0) {
+    return;
+  }
+  conn->in_len += (size_t)n;
+
+  // handle all complete packets
+  size_t offset = 0;
+  while (!conn->closed && conn->in_len - offset >= 2) {
+    // decode remaining length
+    size_t rem_len = 0;
+    size_t pos = offset + 1;
+    size_t multiplier = 1;
+    bool complete = false;
+    while (pos < conn->in_len && pos - offset <= 4) {
+      uint8_t byte = conn->in[pos++];
+      rem_len += (byte & 127u) * multiplier;
+      multiplier *= 128;
+      if ((byte & 128u) == 0) {
+        complete = true;
+        break;
+      }
+    }
+    if (!complete) {
+      if (pos - offset > 4) {
+        mock_close(broker, conn, false);
+      }
+      break;
+    }
+
+    // wait for the full packet
+    if (conn->in_len - pos < rem_len) {
+      break;
+    }
+
+    // handle packet
+    if (!mock_handle(broker, conn, conn->in[offset], conn->in + pos, conn->in + pos + rem_len)) {
+      mock_close(broker, conn, false);
+    }
+    offset = pos + rem_len;
+  }
+
+  // remove handled data
+  memmove(conn->in, conn->in + offset, conn->in_len - offset);
+  conn->in_len -= offset;
+}
+
+static void mock_write(mock_broker_t *broker, mock_conn_t *conn, uint64_t now) {
+  // write released packets
+  while (conn->out_head != NULL && conn->out_head->release <= now) {
+    mock_packet_t *packet = conn->out_head;
+    ssize_t n = send(conn->fd, packet->data + packet->sent, packet->len - packet->sent, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        mock_close(broker, conn, false);
+      }
+      return;
+    }
+
+    // advance or remove packet
+    packet->sent += (size_t)n;
+    if (packet->sent < packet->len) {
+      return;
+    }
+    conn->out_head = packet->next;
+    if (conn->out_head == NULL) {
+      conn->out_tail = NULL;
+    }
+    free(packet);
+  }
+}
+
+static void mock_free_conn(mock_conn_t *conn) {
+  close(conn->fd);
+  free(conn->client_id);
+  free(conn->in);
+  while (conn->out_head != NULL) {
+    mock_packet_t *next = conn->out_head->next;
+    free(conn->out_head);
+    conn->out_head = next;
+  }
+  for (int i = 0; i < conn->sub_count; i++) {
+    free(conn->subs[i].filter);
+  }
+  free(conn->subs);
+  if (conn->has_will) {
+    mock_free_message(&conn->will);
+  }
+  free(conn);
+}
+
+static void mock_accept(mock_broker_t *broker) {
+  // accept connection
+  int fd = accept(broker->listener, NULL, NULL);
+  if (fd < 0) {
+    return;
+  }
+
+  // configure socket
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+  // add connection
+  if (broker->conn_count == broker->conn_cap) {
+    broker->conn_cap = broker->conn_cap * 2 + 16;
+    broker->conns = realloc(broker->conns, sizeof(mock_conn_t *) * (size_t)broker->conn_cap);
+  }
+  mock_conn_t *conn = calloc(1, sizeof(mock_conn_t));
+  conn->fd = fd;
+  broker->conns[broker->conn_count++] = conn;
+}
+
+static void *mock_run(void *ref) {
+  mock_broker_t *broker = (mock_broker_t *)ref;
+
+  struct pollfd *fds = NULL;
+  int fds_cap = 0;
+
+  for (;;) {
+    // prepare poll set
+    if (fds_cap < broker->conn_count + 2) {
+      fds_cap = broker->conn_count * 2 + 16;
+      fds = realloc(fds, sizeof(struct pollfd) * (size_t)fds_cap);
+    }
+    fds[0].fd = broker->wake[0];
+    fds[0].events = POLLIN;
+    fds[1].fd = broker->listener;
+    fds[1].events = POLLIN;
+
+    // add connections and calculate timeout until the next delayed packet
+    uint64_t now = mock_now();
+    int timeout = -1;
+    for (int i = 0; i < broker->conn_count; i++) {
+      mock_conn_t *conn = broker->conns[i];
+      fds[i + 2].fd = conn->fd;
+      fds[i + 2].events = POLLIN;
+      if (conn->out_head != NULL) {
+        if (conn->out_head->release <= now) {
+          fds[i + 2].events |= POLLOUT;
+        } else if (timeout < 0 || conn->out_head->release - now < (uint64_t)timeout) {
+          timeout = (int)(conn->out_head->release - now);
+        }
+      }
+    }
+
+    // wait for events
+    int count = broker->conn_count;
+    if (poll(fds, (nfds_t)(count + 2), timeout) < 0 && errno != EINTR) {
+      break;
+    }
+
+    // stop if woken
+    if (fds[0].revents & POLLIN) {
+      break;
+    }
+
+    // handle connections
+    now = mock_now();
+    for (int i = 0; i < count; i++) {
+      mock_conn_t *conn = broker->conns[i];
+      if (!conn->closed && (fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR))) {
+        mock_read(broker, conn);
+      }
+    }
+    for (int i = 0; i < broker->conn_count; i++) {
+      if (!broker->conns[i]->closed) {
+        mock_write(broker, broker->conns[i], now);
+      }
+    }
+
+    // accept new connections
+    if (fds[1].revents & POLLIN) {
+      mock_accept(broker);
+    }
+
+    // remove closed connections
+    for (int i = 0; i < broker->conn_count;) {
+      if (broker->conns[i]->closed) {
+        mock_free_conn(broker->conns[i]);
+        broker->conns[i] = broker->conns[--broker->conn_count];
+      } else {
+        i++;
+      }
+    }
+  }
+
+  free(fds);
+
+  return NULL;
+}
+
+static int mock_listen_local(const char *path) {
+  // prepare address, abstract names start with a zero byte instead of the "@"
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  size_t len = strlen(path);
+  if (len == 0 || len >= sizeof(addr.sun_path)) {
+    return -1;
+  }
+  memcpy(addr.sun_path, path, len);
+  socklen_t addr_len = (socklen_t)sizeof(addr);
+  if (path[0] == '@') {
+    addr.sun_path[0] = '\0';
+    addr_len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + len);
+  } else {
+    unlink(path);
+  }
+
+  // create listener
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  if (bind(fd, (struct sockaddr *)&addr, addr_len) < 0 || listen(fd, 1024) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+static int mock_listen_tcp(int *port) {
+  // create listener
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 1024) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  // get port
+  socklen_t addr_len = sizeof(addr);
+  getsockname(fd, (struct sockaddr *)&addr, &addr_len);
+  *port = ntohs(addr.sin_port);
+
+  return fd;
+}
+
+mock_broker_t *mock_broker_start(mock_broker_options_t options) {
+  // allocate broker
+  mock_broker_t *broker = calloc(1, sizeof(mock_broker_t));
+  broker->options = options;
+
+  // create listener
+  broker->listener = options.path != NULL ? mock_listen_local(options.path) : mock_listen_tcp(&broker->port);
+  if (broker->listener < 0) {
+    free(broker);
+    return NULL;
+  }
+
+  // create wake pipe and start thread
+  if (pipe(broker->wake) < 0 || pthread_create(&broker->thread, NULL, mock_run, broker) != 0) {
+    close(broker->listener);
+    free(broker);
+    return NULL;
+  }
+
+  return broker;
+}
+
+int mock_broker_port(mock_broker_t *broker) { return broker->port; }
+
+void mock_broker_stop(mock_broker_t *broker) {
+  // stop thread
+  if (write(broker->wake[1], "x", 1) < 0) {
+    return;
+  }
+  pthread_join(broker->thread, NULL);
+
+  // free connections
+  for (int i = 0; i < broker->conn_count; i++) {
+    mock_free_conn(broker->conns[i]);
+  }
+  free(broker->conns);
+
+  // free retained messages
+  for (int i = 0; i < broker->retained_count; i++) {
+    mock_free_message(&broker->retained[i]);
+  }
+  free(broker->retained);
+
+  // close sockets
+  close(broker->wake[0]);
+  close(broker->wake[1]);
+  close(broker->listener);
+
+  // remove socket file
+  if (broker->options.path != NULL && broker->options.path[0] != '@') {
+    unlink(broker->options.path);
+  }
+
+  free(broker);
+}
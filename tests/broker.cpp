@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <lwmqtt.h>
+#include <lwmqtt/unix.h>
+
+#include "broker.h"
+}
+
+#define COMMAND_TIMEOUT 5000
+
+typedef struct {
+  lwmqtt_unix_network_t network;
+  lwmqtt_unix_timer_t timer1, timer2;
+  lwmqtt_client_t client;
+  uint8_t write_buf[512], read_buf[512];
+  std::vector<std::pair<std::string, bool>> received;
+} test_client_t;
+
+static void test_message_arrived(lwmqtt_client_t *c, void *ref, lwmqtt_string_t t, lwmqtt_message_t m) {
+  auto *tc = (test_client_t *)ref;
+  tc->received.emplace_back(std::string(t.data, t.len), m.retained);
+}
+
+static void test_connect(mock_broker_t *b, test_client_t *tc, const char *id, lwmqtt_will_t *will) {
+  lwmqtt_init(&tc->client, tc->write_buf, sizeof(tc->write_buf), tc->read_buf, sizeof(tc->read_buf));
+  lwmqtt_set_network(&tc->client, &tc->network, lwmqtt_unix_network_read, lwmqtt_unix_network_write);
+  lwmqtt_set_timers(&tc->client, &tc->timer1, &tc->timer2, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get);
+  lwmqtt_set_callback(&tc->client, tc, test_message_arrived);
+
+  lwmqtt_err_t err = lwmqtt_unix_network_connect(&tc->network, (char *)"127.0.0.1", mock_broker_port(b));
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  lwmqtt_options_t options = lwmqtt_default_options;
+  options.client_id = lwmqtt_string(id);
+
+  lwmqtt_return_code_t return_code;
+  err = lwmqtt_connect(&tc->client, options, will, &return_code, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+}
+
+static void test_receive(test_client_t *tc, size_t count) {
+  while (tc->received.size() < count) {
+    lwmqtt_err_t err = lwmqtt_yield(&tc->client, 0, COMMAND_TIMEOUT);
+    ASSERT_EQ(err, LWMQTT_SUCCESS);
+  }
+}
+
+static void test_publish(test_client_t *tc, const char *topic, const char *payload, lwmqtt_qos_t qos, bool retained) {
+  lwmqtt_message_t msg = lwmqtt_default_message;
+  msg.qos = qos;
+  msg.retained = retained;
+  msg.payload = (uint8_t *)payload;
+  msg.payload_len = strlen(payload);
+
+  lwmqtt_err_t err = lwmqtt_publish(&tc->client, lwmqtt_string(topic), msg, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+}
+
+TEST(Broker, Wildcards) {
+  mock_broker_t *b = mock_broker_start(mock_broker_default_options);
+  ASSERT_NE(b, nullptr);
+
+  test_client_t tc;
+  test_connect(b, &tc, "wildcards", nullptr);
+
+  lwmqtt_string_t filters[3] = {lwmqtt_string("a/+/c"), lwmqtt_string("b/#"), lwmqtt_string("c")};
+  lwmqtt_qos_t qos[3] = {LWMQTT_QOS0, LWMQTT_QOS1, LWMQTT_QOS2};
+  lwmqtt_err_t err = lwmqtt_subscribe(&tc.client, 3, filters, qos, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  const char *topics[] = {"a/b/c", "a/b/d", "a/b/c/d", "b", "b/c/d", "c", "c/d", "x"};
+  for (const char *topic : topics) {
+    test_publish(&tc, topic, "hello", LWMQTT_QOS1, false);
+  }
+
+  test_receive(&tc, 4);
+  ASSERT_EQ(tc.received.size(), 4u);
+  EXPECT_EQ(tc.received[0].first, "a/b/c");
+  EXPECT_EQ(tc.received[1].first, "b");
+  EXPECT_EQ(tc.received[2].first, "b/c/d");
+  EXPECT_EQ(tc.received[3].first, "c");
+
+  lwmqtt_unix_network_disconnect(&tc.network);
+  mock_broker_stop(b);
+}
+
+TEST(Broker, Retained) {
+  mock_broker_t *b = mock_broker_start(mock_broker_default_options);
+  ASSERT_NE(b, nullptr);
+
+  test_client_t tc1;
+  test_connect(b, &tc1, "retained1", nullptr);
+  test_publish(&tc1, "r/1", "one", LWMQTT_QOS1, true);
+  test_publish(&tc1, "r/2", "two", LWMQTT_QOS2, true);
+  test_publish(&tc1, "r/2", "", LWMQTT_QOS1, true);
+
+  test_client_t tc2;
+  test_connect(b, &tc2, "retained2", nullptr);
+  lwmqtt_err_t err = lwmqtt_subscribe_one(&tc2.client, lwmqtt_string("r/#"), LWMQTT_QOS2, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  test_receive(&tc2, 1);
+  ASSERT_EQ(tc2.received.size(), 1u);
+  EXPECT_EQ(tc2.received[0].first, "r/1");
+  EXPECT_TRUE(tc2.received[0].second);
+
+  lwmqtt_unix_network_disconnect(&tc1.network);
+  lwmqtt_unix_network_disconnect(&tc2.network);
+  mock_broker_stop(b);
+}
+
+TEST(Broker, Will) {
+  mock_broker_t *b = mock_broker_start(mock_broker_default_options);
+  ASSERT_NE(b, nullptr);
+
+  test_client_t tc1;
+  test_connect(b, &tc1, "will1", nullptr);
+  lwmqtt_err_t err = lwmqtt_subscribe_one(&tc1.client, lwmqtt_string("will"), LWMQTT_QOS1, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  lwmqtt_will_t will = lwmqtt_default_will;
+  will.topic = lwmqtt_string("will");
+  will.payload = lwmqtt_string("gone");
+  will.qos = LWMQTT_QOS1;
+
+  test_client_t tc2;
+  test_connect(b, &tc2, "will2", &will);
+  lwmqtt_unix_network_disconnect(&tc2.network);
+
+  test_receive(&tc1, 1);
+  EXPECT_EQ(tc1.received[0].first, "will");
+
+  lwmqtt_unix_network_disconnect(&tc1.network);
+  mock_broker_stop(b);
+}
+
+TEST(Broker, Latency) {
+  mock_broker_options_t options = mock_broker_default_options;
+  options.latency = 50;
+  mock_broker_t *b = mock_broker_start(options);
+  ASSERT_NE(b, nullptr);
+
+  test_client_t tc;
+  test_connect(b, &tc, "latency", nullptr);
+
+  uint64_t start = lwmqtt_unix_clock_get(nullptr);
+  test_publish(&tc, "latency", "hello", LWMQTT_QOS1, false);
+  EXPECT_GE(lwmqtt_unix_clock_get(nullptr) - start, 50000u);
+
+  lwmqtt_unix_network_disconnect(&tc.network);
+  mock_broker_stop(b);
+}
+
+TEST(Broker, Loss) {
+  mock_broker_options_t options = mock_broker_default_options;
+  options.loss = 1;
+  mock_broker_t *b = mock_broker_start(options);
+  ASSERT_NE(b, nullptr);
+
+  test_client_t tc;
+  test_connect(b, &tc, "loss", nullptr);
+
+  lwmqtt_message_t msg = lwmqtt_default_message;
+  msg.qos = LWMQTT_QOS1;
+
+  lwmqtt_err_t err = lwmqtt_publish(&tc.client, lwmqtt_string("loss"), msg, 100);
+  EXPECT_EQ(err, LWMQTT_MISSING_OR_WRONG_PACKET);
+
+  lwmqtt_unix_network_disconnect(&tc.network);
+  mock_broker_stop(b);
+}
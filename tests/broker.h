@@ -0,0 +1,57 @@
+#ifndef LWMQTT_TESTS_BROKER_H
+#define LWMQTT_TESTS_BROKER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * The options of the mock broker.
+ */
+typedef struct {
+  uint32_t latency;
+  double loss;
+  unsigned seed;
+  const char *path;
+} mock_broker_options_t;
+
+/**
+ * The default initializer for the options object.
+ */
+#define mock_broker_default_options \
+  { 0, 0, 1, NULL }
+
+/**
+ * The mock broker object.
+ *
+ * The broker is a minimal MQTT 3.1.1 server that listens on loopback. It supports QOS 0, 1 and 2 flows, wildcard
+ * subscriptions, retained messages and last wills, but no persistent sessions. Every packet sent by the broker is
+ * delayed by the configured latency in milliseconds and incoming publish packets are silently dropped with the
+ * configured loss probability. If a path is set, the broker listens on a UNIX domain socket at that path instead,
+ * where a path starting with "@" names a socket in the abstract namespace.
+ */
+typedef struct mock_broker_t mock_broker_t;
+
+/**
+ * Will start a broker on a random loopback port or the configured path in a background thread.
+ *
+ * @param options - The options.
+ * @return The broker or NULL if it could not be started.
+ */
+mock_broker_t *mock_broker_start(mock_broker_options_t options);
+
+/**
+ * Will return the port the broker is listening on.
+ *
+ * @param broker - The broker.
+ * @return The port or zero if the broker listens on a path.
+ */
+int mock_broker_port(mock_broker_t *broker);
+
+/**
+ * Will stop the broker, close all connections and free all resources.
+ *
+ * @param broker - The broker.
+ */
+void mock_broker_stop(mock_broker_t *broker);
+
+#endif  // LWMQTT_TESTS_BROKER_H
@@ -0,0 +1,149 @@
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+extern "C" {
+#include <lwmqtt/capture.h>
+#include <lwmqtt/pipe.h>
+#include <lwmqtt/unix.h>
+}
+
+static int arrived = 0;
+
+static void message_arrived(lwmqtt_client_t *client, void *ref, lwmqtt_string_t topic, lwmqtt_message_t msg) {
+  ASSERT_EQ(lwmqtt_strcmp(topic, "a"), 0);
+  ASSERT_EQ(msg.payload_len, 5u);
+  ASSERT_EQ(memcmp(msg.payload, "hello", 5), 0);
+  arrived++;
+}
+
+static void record(const char *path) {
+  lwmqtt_pipe_clock_t clock = {0};
+  uint8_t buf[256];
+  lwmqtt_pipe_t pipe;
+  lwmqtt_pipe_init(&pipe, &clock, buf, sizeof(buf));
+
+  lwmqtt_pipe_timer_t timer1, timer2;
+  lwmqtt_pipe_timer_init(&timer1, &clock);
+  lwmqtt_pipe_timer_init(&timer2, &clock);
+
+  lwmqtt_capture_t capture;
+  ASSERT_EQ(lwmqtt_capture_open(&capture, path, &pipe.a, lwmqtt_pipe_read, lwmqtt_pipe_write), LWMQTT_SUCCESS);
+
+  uint8_t write_buf[64], read_buf[64];
+  lwmqtt_client_t client;
+  lwmqtt_init(&client, write_buf, sizeof(write_buf), read_buf, sizeof(read_buf));
+  lwmqtt_set_network(&client, &capture, lwmqtt_capture_read, lwmqtt_capture_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_pipe_timer_set, lwmqtt_pipe_timer_get);
+  lwmqtt_set_callback(&client, nullptr, message_arrived);
+
+  uint8_t connack[4] = {0x20, 2, 0, 0};
+  size_t sent = 0;
+  ASSERT_EQ(lwmqtt_pipe_write(&pipe.b, connack, sizeof(connack), &sent, 0), LWMQTT_SUCCESS);
+
+  lwmqtt_return_code_t return_code;
+  ASSERT_EQ(lwmqtt_connect(&client, lwmqtt_default_options, nullptr, &return_code, 1000), LWMQTT_SUCCESS);
+
+  uint8_t publish[10] = {0x30, 8, 0, 1, 'a', 'h', 'e', 'l', 'l', 'o'};
+  for (int i = 0; i < 2; i++) {
+    usleep(20000);
+    ASSERT_EQ(lwmqtt_pipe_write(&pipe.b, publish, sizeof(publish), &sent, 0), LWMQTT_SUCCESS);
+    ASSERT_EQ(lwmqtt_yield(&client, sizeof(publish), 1000), LWMQTT_SUCCESS);
+  }
+
+  lwmqtt_capture_close(&capture);
+}
+
+static void replay(const char *path, bool paced) {
+  lwmqtt_replay_t replay;
+  ASSERT_EQ(lwmqtt_replay_open(&replay, path, paced), LWMQTT_SUCCESS);
+
+  lwmqtt_unix_timer_t timer1, timer2;
+  uint8_t write_buf[64], read_buf[64];
+  lwmqtt_client_t client;
+  lwmqtt_init(&client, write_buf, sizeof(write_buf), read_buf, sizeof(read_buf));
+  lwmqtt_set_network(&client, &replay, lwmqtt_replay_read, lwmqtt_replay_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get);
+  lwmqtt_set_callback(&client, nullptr, message_arrived);
+
+  while (!lwmqtt_replay_done(&replay)) {
+    ASSERT_EQ(lwmqtt_yield(&client, lwmqtt_replay_available(&replay), 100), LWMQTT_SUCCESS);
+  }
+
+  EXPECT_EQ(replay.bytes_in, 24u);
+  EXPECT_EQ(replay.bytes_out, 0u);
+
+  lwmqtt_replay_close(&replay);
+}
+
+TEST(Capture, Replay) {
+  char path[] = "/tmp/lwmqtt-capture-XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+
+  arrived = 0;
+  record(path);
+  EXPECT_EQ(arrived, 2);
+
+  arrived = 0;
+  uint64_t start = lwmqtt_unix_clock_get(nullptr);
+  replay(path, false);
+  EXPECT_EQ(arrived, 2);
+  EXPECT_LT(lwmqtt_unix_clock_get(nullptr) - start, 20000u);
+
+  arrived = 0;
+  start = lwmqtt_unix_clock_get(nullptr);
+  replay(path, true);
+  EXPECT_EQ(arrived, 2);
+  EXPECT_GE(lwmqtt_unix_clock_get(nullptr) - start, 20000u);
+
+  unlink(path);
+}
+
+static lwmqtt_err_t partial_write(void *ref, uint8_t *buf, size_t len, size_t *sent, uint32_t timeout) {
+  *sent += 3;
+  return LWMQTT_WOULD_BLOCK;
+}
+
+TEST(Capture, PartialWrite) {
+  char path[] = "/tmp/lwmqtt-capture-XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+
+  lwmqtt_capture_t capture;
+  ASSERT_EQ(lwmqtt_capture_open(&capture, path, nullptr, nullptr, partial_write), LWMQTT_SUCCESS);
+  uint8_t publish[10] = {0x30, 8, 0, 1, 'a', 'h', 'e', 'l', 'l', 'o'};
+  size_t sent = 0;
+  EXPECT_EQ(lwmqtt_capture_write(&capture, publish, sizeof(publish), &sent, 0), LWMQTT_WOULD_BLOCK);
+  EXPECT_EQ(sent, 3u);
+  lwmqtt_capture_close(&capture);
+
+  // the written bytes must be recorded
+  uint8_t data[32];
+  fd = open(path, O_RDONLY);
+  ASSERT_GE(fd, 0);
+  ssize_t size = read(fd, data, sizeof(data));
+  close(fd);
+  ASSERT_GE(size, 10);
+  EXPECT_EQ(data[5], LWMQTT_CAPTURE_OUT);
+  EXPECT_EQ(data[size - 4], 3);
+  EXPECT_EQ(memcmp(data + size - 3, publish, 3), 0);
+
+  unlink(path);
+}
+
+TEST(Capture, Invalid) {
+  char path[] = "/tmp/lwmqtt-capture-XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(write(fd, "LWXX\x01", 5), 5);
+  close(fd);
+
+  lwmqtt_replay_t replay;
+  EXPECT_EQ(lwmqtt_replay_open(&replay, path, false), LWMQTT_NETWORK_FAILED_READ);
+  EXPECT_EQ(lwmqtt_replay_open(&replay, "/nonexistent/capture", false), LWMQTT_NETWORK_FAILED_READ);
+
+  unlink(path);
+}
@@ -2,9 +2,16 @@
 
 extern "C" {
 #include <lwmqtt.h>
+#include <lwmqtt/latency.h>
+#include <lwmqtt/lz.h>
+#include <lwmqtt/recorder.h>
 #include <lwmqtt/unix.h>
+
+#include "broker.h"
 }
 
+extern mock_broker_t *broker;
+
 #define COMMAND_TIMEOUT 5000
 
 #define PAYLOAD_LEN 256
@@ -55,7 +62,7 @@ TEST(Client, PublishSubscribeQOS0) {
   lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get);
   lwmqtt_set_callback(&client, (void *)custom_ref, message_arrived);
 
-  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"public.cloud.shiftr.io", 1883);
+  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"127.0.0.1", mock_broker_port(broker));
   ASSERT_EQ(err, LWMQTT_SUCCESS);
 
   lwmqtt_options_t data = lwmqtt_default_options;
@@ -114,7 +121,7 @@ TEST(Client, PublishSubscribeQOS1) {
   lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get);
   lwmqtt_set_callback(&client, (void *)custom_ref, message_arrived);
 
-  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"public.cloud.shiftr.io", 1883);
+  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"127.0.0.1", mock_broker_port(broker));
   ASSERT_EQ(err, LWMQTT_SUCCESS);
 
   lwmqtt_options_t options = lwmqtt_default_options;
@@ -173,7 +180,7 @@ TEST(Client, PublishSubscribeQOS2) {
   lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get);
   lwmqtt_set_callback(&client, (void *)custom_ref, message_arrived);
 
-  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"public.cloud.shiftr.io", 1883);
+  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"127.0.0.1", mock_broker_port(broker));
   ASSERT_EQ(err, LWMQTT_SUCCESS);
 
   lwmqtt_options_t options = lwmqtt_default_options;
@@ -232,7 +239,7 @@ TEST(Client, BufferOverflow) {
   lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get);
   lwmqtt_set_callback(&client, (void *)custom_ref, message_arrived);
 
-  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"public.cloud.shiftr.io", 1883);
+  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"127.0.0.1", mock_broker_port(broker));
   ASSERT_EQ(err, LWMQTT_SUCCESS);
 
   lwmqtt_options_t options = lwmqtt_default_options;
@@ -298,7 +305,7 @@ TEST(Client, OverflowDropping) {
   uint32_t dropped = 0;
   lwmqtt_drop_overflow(&client, true, &dropped);
 
-  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"public.cloud.shiftr.io", 1883);
+  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"127.0.0.1", mock_broker_port(broker));
   ASSERT_EQ(err, LWMQTT_SUCCESS);
 
   lwmqtt_options_t options = lwmqtt_default_options;
@@ -358,7 +365,7 @@ TEST(Client, BigBuffersAndPayload) {
   lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get);
   lwmqtt_set_callback(&client, (void *)custom_ref, big_message_arrived);
 
-  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"public.cloud.shiftr.io", 1883);
+  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"127.0.0.1", mock_broker_port(broker));
   ASSERT_EQ(err, LWMQTT_SUCCESS);
 
   lwmqtt_options_t options = lwmqtt_default_options;
@@ -405,6 +412,86 @@ TEST(Client, BigBuffersAndPayload) {
   lwmqtt_unix_network_disconnect(&network);
 }
 
+TEST(Client, DirectPayload) {
+  lwmqtt_unix_network_t network{};
+  lwmqtt_unix_timer_t timer1, timer2;
+
+  lwmqtt_client_t client;
+
+  lwmqtt_init(&client, (uint8_t *)malloc(512), 512, (uint8_t *)malloc(10000), 10000);
+
+  lwmqtt_set_network(&client, &network, lwmqtt_unix_network_read, lwmqtt_unix_network_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get);
+  lwmqtt_set_callback(&client, (void *)custom_ref, big_message_arrived);
+  lwmqtt_set_direct_payload(&client, 1024, lwmqtt_unix_network_write_direct);
+
+  lwmqtt_stats_t stats = {};
+  lwmqtt_set_stats(&client, &stats);
+
+  lwmqtt_unix_options_t network_options = lwmqtt_unix_default_options;
+  network_options.zerocopy = 4096;
+  lwmqtt_err_t err = lwmqtt_unix_network_connect_options(&network, (char *)"127.0.0.1", mock_broker_port(broker),
+                                                         COMMAND_TIMEOUT, &network_options);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  lwmqtt_options_t options = lwmqtt_default_options;
+  options.client_id = lwmqtt_string("lwmqtt");
+  options.username = lwmqtt_string("public");
+  options.password = lwmqtt_string("public");
+
+  lwmqtt_return_code_t return_code;
+  err = lwmqtt_connect(&client, options, nullptr, &return_code, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  err = lwmqtt_subscribe_one(&client, lwmqtt_string("lwmqtt"), LWMQTT_QOS1, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  counter = 0;
+
+  // the payload does not fit the write buffer and is written from the message
+  lwmqtt_qos_t levels[3] = {LWMQTT_QOS0, LWMQTT_QOS1, LWMQTT_QOS2};
+  for (lwmqtt_qos_t qos : levels) {
+    lwmqtt_message_t msg = lwmqtt_default_message;
+    msg.qos = qos;
+    msg.payload = big_payload;
+    msg.payload_len = BIG_PAYLOAD_LEN;
+
+    err = lwmqtt_publish(&client, lwmqtt_string("lwmqtt"), msg, COMMAND_TIMEOUT);
+    ASSERT_EQ(err, LWMQTT_SUCCESS);
+  }
+  // batched payloads end their chunk
+  lwmqtt_string_t topics[2] = {lwmqtt_string("lwmqtt"), lwmqtt_string("lwmqtt")};
+  lwmqtt_message_t messages[2] = {{LWMQTT_QOS1, false, big_payload, BIG_PAYLOAD_LEN},
+                                  {LWMQTT_QOS1, false, big_payload, BIG_PAYLOAD_LEN}};
+  lwmqtt_err_t results[2];
+  err = lwmqtt_publish_batch(&client, 2, topics, messages, results, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+  ASSERT_EQ(results[0], LWMQTT_SUCCESS);
+  ASSERT_EQ(results[1], LWMQTT_SUCCESS);
+  ASSERT_EQ(stats.packets_out[LWMQTT_PUBLISH_PACKET], 5u);
+
+  // the payload may only be modified once the kernel is done with it
+  ASSERT_EQ(lwmqtt_unix_network_await_zerocopy(&network, COMMAND_TIMEOUT), LWMQTT_SUCCESS);
+  ASSERT_EQ(network.zerocopy_completions, network.zerocopy_sends);
+  ASSERT_LE(network.zerocopy_sends, 5u);
+
+  while (counter < 5) {
+    size_t available = 0;
+    err = lwmqtt_unix_network_peek(&network, &available);
+    ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+    if (available > 0) {
+      err = lwmqtt_yield(&client, available, COMMAND_TIMEOUT);
+      ASSERT_EQ(err, LWMQTT_SUCCESS);
+    }
+  }
+
+  err = lwmqtt_disconnect(&client, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  lwmqtt_unix_network_disconnect(&network);
+}
+
 TEST(Client, MultipleSubscriptions) {
   lwmqtt_unix_network_t network;
   lwmqtt_unix_timer_t timer1, timer2;
@@ -417,7 +504,7 @@ TEST(Client, MultipleSubscriptions) {
   lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get);
   lwmqtt_set_callback(&client, (void *)custom_ref, message_arrived);
 
-  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"public.cloud.shiftr.io", 1883);
+  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"127.0.0.1", mock_broker_port(broker));
   ASSERT_EQ(err, LWMQTT_SUCCESS);
 
   lwmqtt_options_t options = lwmqtt_default_options;
@@ -466,3 +553,522 @@ TEST(Client, MultipleSubscriptions) {
 
   lwmqtt_unix_network_disconnect(&network);
 }
+
+TEST(Client, ConnectAndSubscribe) {
+  lwmqtt_unix_network_t network;
+  lwmqtt_unix_timer_t timer1, timer2;
+
+  lwmqtt_client_t client;
+
+  lwmqtt_init(&client, (uint8_t *)malloc(512), 512, (uint8_t *)malloc(512), 512);
+
+  lwmqtt_set_network(&client, &network, lwmqtt_unix_network_read, lwmqtt_unix_network_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get);
+  lwmqtt_set_callback(&client, (void *)custom_ref, message_arrived);
+
+  lwmqtt_stats_t stats = {};
+  lwmqtt_set_stats(&client, &stats);
+
+  static lwmqtt_latency_t latency;
+  lwmqtt_latency_reset(&latency);
+  lwmqtt_set_latency(&client, &latency, nullptr, lwmqtt_unix_clock_get);
+
+  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"127.0.0.1", mock_broker_port(broker));
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  lwmqtt_options_t options = lwmqtt_default_options;
+  options.client_id = lwmqtt_string("lwmqtt");
+  options.username = lwmqtt_string("public");
+  options.password = lwmqtt_string("public");
+
+  lwmqtt_string_t topic_filters[2] = {lwmqtt_string("foo"), lwmqtt_string("lwmqtt")};
+  lwmqtt_qos_t qos_levels[2] = {LWMQTT_QOS0, LWMQTT_QOS1};
+
+  lwmqtt_return_code_t return_code;
+  err = lwmqtt_connect_and_subscribe(&client, options, nullptr, &return_code, 2, topic_filters, qos_levels,
+                                     COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+  ASSERT_EQ(return_code, LWMQTT_CONNECTION_ACCEPTED);
+  ASSERT_EQ(stats.write_calls, 1u);
+  ASSERT_EQ(stats.packets_out[1], 1u);
+  ASSERT_EQ(stats.packets_out[8], 1u);
+  ASSERT_EQ(stats.packets_in[2], 1u);
+  ASSERT_EQ(stats.packets_in[9], 1u);
+
+  // the pipelined subscribe has its own send time
+  ASSERT_EQ(latency.subscribe.count, 1u);
+  ASSERT_LT(latency.subscribe.max, (uint32_t)COMMAND_TIMEOUT * 1000);
+
+  counter = 0;
+
+  lwmqtt_message_t msg = lwmqtt_default_message;
+  msg.qos = LWMQTT_QOS0;
+  msg.payload = payload;
+  msg.payload_len = PAYLOAD_LEN;
+
+  err = lwmqtt_publish(&client, lwmqtt_string("lwmqtt"), msg, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  while (counter < 1) {
+    size_t available = 0;
+    err = lwmqtt_unix_network_peek(&network, &available);
+    ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+    if (available > 0) {
+      err = lwmqtt_yield(&client, available, COMMAND_TIMEOUT);
+      ASSERT_EQ(err, LWMQTT_SUCCESS);
+    }
+  }
+
+  err = lwmqtt_disconnect(&client, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  lwmqtt_unix_network_disconnect(&network);
+}
+
+TEST(Client, PublishBatch) {
+  lwmqtt_unix_network_t network;
+  lwmqtt_unix_timer_t timer1, timer2;
+
+  lwmqtt_client_t client;
+
+  lwmqtt_init(&client, (uint8_t *)malloc(1024), 1024, (uint8_t *)malloc(512), 512);
+
+  lwmqtt_set_network(&client, &network, lwmqtt_unix_network_read, lwmqtt_unix_network_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get);
+  lwmqtt_set_callback(&client, (void *)custom_ref, message_arrived);
+
+  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"127.0.0.1", mock_broker_port(broker));
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  lwmqtt_options_t options = lwmqtt_default_options;
+  options.client_id = lwmqtt_string("lwmqtt");
+  options.username = lwmqtt_string("public");
+  options.password = lwmqtt_string("public");
+
+  lwmqtt_return_code_t return_code;
+  err = lwmqtt_connect(&client, options, nullptr, &return_code, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  err = lwmqtt_subscribe_one(&client, lwmqtt_string("lwmqtt"), LWMQTT_QOS2, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  counter = 0;
+
+  lwmqtt_string_t topics[10];
+  lwmqtt_message_t messages[10];
+  lwmqtt_err_t results[10];
+
+  for (int i = 0; i < 10; i++) {
+    topics[i] = lwmqtt_string("lwmqtt");
+    messages[i] = lwmqtt_default_message;
+    messages[i].qos = (lwmqtt_qos_t)(i % 3);
+    messages[i].payload = payload;
+    messages[i].payload_len = PAYLOAD_LEN;
+  }
+
+  messages[4].payload = big_payload;
+  messages[4].payload_len = BIG_PAYLOAD_LEN;
+
+  err = lwmqtt_publish_batch(&client, 10, topics, messages, results, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(results[i], i == 4 ? LWMQTT_BUFFER_TOO_SHORT : LWMQTT_SUCCESS);
+  }
+
+  while (counter < 9) {
+    size_t available = 0;
+    err = lwmqtt_unix_network_peek(&network, &available);
+    ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+    if (available > 0) {
+      err = lwmqtt_yield(&client, available, COMMAND_TIMEOUT);
+      ASSERT_EQ(err, LWMQTT_SUCCESS);
+    }
+  }
+
+  err = lwmqtt_unsubscribe_one(&client, lwmqtt_string("lwmqtt"), COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  err = lwmqtt_disconnect(&client, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  lwmqtt_unix_network_disconnect(&network);
+}
+
+static int writes = 0;
+
+static lwmqtt_err_t counting_network_write(void *ref, uint8_t *buf, size_t len, size_t *sent, uint32_t timeout) {
+  writes++;
+  return lwmqtt_unix_network_write(ref, buf, len, sent, timeout);
+}
+
+TEST(Client, Linger) {
+  lwmqtt_unix_network_t network;
+  lwmqtt_unix_timer_t timer1, timer2, timer3;
+
+  lwmqtt_client_t client;
+
+  lwmqtt_init(&client, (uint8_t *)malloc(512), 512, (uint8_t *)malloc(512), 512);
+
+  lwmqtt_set_network(&client, &network, lwmqtt_unix_network_read, counting_network_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get);
+  lwmqtt_set_callback(&client, (void *)custom_ref, message_arrived);
+  lwmqtt_set_linger(&client, (uint8_t *)malloc(4096), 4096, &timer3, 60000);
+
+  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"127.0.0.1", mock_broker_port(broker));
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  lwmqtt_options_t options = lwmqtt_default_options;
+  options.client_id = lwmqtt_string("lwmqtt");
+  options.username = lwmqtt_string("public");
+  options.password = lwmqtt_string("public");
+
+  lwmqtt_return_code_t return_code;
+  err = lwmqtt_connect(&client, options, nullptr, &return_code, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  err = lwmqtt_subscribe_one(&client, lwmqtt_string("lwmqtt"), LWMQTT_QOS1, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  counter = 0;
+  writes = 0;
+
+  for (int i = 0; i < 5; i++) {
+    lwmqtt_message_t msg = lwmqtt_default_message;
+    msg.qos = LWMQTT_QOS0;
+    msg.payload = payload;
+    msg.payload_len = PAYLOAD_LEN;
+
+    err = lwmqtt_publish(&client, lwmqtt_string("lwmqtt"), msg, COMMAND_TIMEOUT);
+    ASSERT_EQ(err, LWMQTT_SUCCESS);
+  }
+
+  ASSERT_EQ(writes, 0);
+
+  err = lwmqtt_flush(&client, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  ASSERT_EQ(writes, 1);
+
+  while (counter < 5) {
+    size_t available = 0;
+    err = lwmqtt_unix_network_peek(&network, &available);
+    ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+    if (available > 0) {
+      err = lwmqtt_yield(&client, available, COMMAND_TIMEOUT);
+      ASSERT_EQ(err, LWMQTT_SUCCESS);
+    }
+  }
+
+  err = lwmqtt_unsubscribe_one(&client, lwmqtt_string("lwmqtt"), COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  err = lwmqtt_disconnect(&client, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  lwmqtt_unix_network_disconnect(&network);
+}
+
+TEST(Client, PayloadTransform) {
+  lwmqtt_unix_network_t network;
+  lwmqtt_unix_timer_t timer1, timer2;
+
+  lwmqtt_client_t client;
+
+  lwmqtt_init(&client, (uint8_t *)malloc(512), 512, (uint8_t *)malloc(512), 512);
+
+  lwmqtt_set_network(&client, &network, lwmqtt_unix_network_read, lwmqtt_unix_network_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get);
+  lwmqtt_set_callback(&client, (void *)custom_ref, big_message_arrived);
+
+  static lwmqtt_lz_state_t state;
+  lwmqtt_set_payload_transform(&client, &state, lwmqtt_lz_compress, lwmqtt_lz_decompress,
+                               (uint8_t *)malloc(BIG_PAYLOAD_LEN), BIG_PAYLOAD_LEN);
+
+  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"127.0.0.1", mock_broker_port(broker));
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  lwmqtt_options_t options = lwmqtt_default_options;
+  options.client_id = lwmqtt_string("lwmqtt");
+  options.username = lwmqtt_string("public");
+  options.password = lwmqtt_string("public");
+
+  lwmqtt_return_code_t return_code;
+  err = lwmqtt_connect(&client, options, nullptr, &return_code, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  err = lwmqtt_subscribe_one(&client, lwmqtt_string("lwmqtt"), LWMQTT_QOS1, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  counter = 0;
+
+  for (int i = 0; i < 5; i++) {
+    lwmqtt_message_t msg = lwmqtt_default_message;
+    msg.qos = LWMQTT_QOS1;
+    msg.payload = big_payload;
+    msg.payload_len = BIG_PAYLOAD_LEN;
+
+    err = lwmqtt_publish(&client, lwmqtt_string("lwmqtt"), msg, COMMAND_TIMEOUT);
+    ASSERT_EQ(err, LWMQTT_SUCCESS);
+  }
+
+  while (counter < 5) {
+    size_t available = 0;
+    err = lwmqtt_unix_network_peek(&network, &available);
+    ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+    if (available > 0) {
+      err = lwmqtt_yield(&client, available, COMMAND_TIMEOUT);
+      ASSERT_EQ(err, LWMQTT_SUCCESS);
+    }
+  }
+
+  err = lwmqtt_unsubscribe_one(&client, lwmqtt_string("lwmqtt"), COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  err = lwmqtt_disconnect(&client, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  lwmqtt_unix_network_disconnect(&network);
+}
+
+TEST(Client, Stats) {
+  lwmqtt_unix_network_t network;
+  lwmqtt_unix_timer_t timer1, timer2;
+
+  lwmqtt_client_t client;
+
+  lwmqtt_init(&client, (uint8_t *)malloc(512), 512, (uint8_t *)malloc(512), 512);
+
+  lwmqtt_set_network(&client, &network, lwmqtt_unix_network_read, lwmqtt_unix_network_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get);
+  lwmqtt_set_callback(&client, (void *)custom_ref, message_arrived);
+
+  lwmqtt_stats_t stats;
+  memset(&stats, 0, sizeof(stats));
+  lwmqtt_set_stats(&client, &stats);
+
+  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"127.0.0.1", mock_broker_port(broker));
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  lwmqtt_options_t options = lwmqtt_default_options;
+  options.client_id = lwmqtt_string("lwmqtt");
+  options.username = lwmqtt_string("public");
+  options.password = lwmqtt_string("public");
+
+  lwmqtt_return_code_t return_code;
+  err = lwmqtt_connect(&client, options, nullptr, &return_code, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  err = lwmqtt_subscribe_one(&client, lwmqtt_string("lwmqtt"), LWMQTT_QOS1, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  counter = 0;
+
+  for (int i = 0; i < 5; i++) {
+    lwmqtt_message_t msg = lwmqtt_default_message;
+    msg.qos = LWMQTT_QOS1;
+    msg.payload = payload;
+    msg.payload_len = PAYLOAD_LEN;
+
+    err = lwmqtt_publish(&client, lwmqtt_string("lwmqtt"), msg, COMMAND_TIMEOUT);
+    ASSERT_EQ(err, LWMQTT_SUCCESS);
+  }
+
+  while (counter < 5) {
+    size_t available = 0;
+    err = lwmqtt_unix_network_peek(&network, &available);
+    ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+    if (available > 0) {
+      err = lwmqtt_yield(&client, available, COMMAND_TIMEOUT);
+      ASSERT_EQ(err, LWMQTT_SUCCESS);
+    }
+  }
+
+  err = lwmqtt_disconnect(&client, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  lwmqtt_unix_network_disconnect(&network);
+
+  lwmqtt_stats_t snapshot;
+  lwmqtt_stats_snapshot(&stats, &snapshot);
+
+  EXPECT_EQ(snapshot.packets_out[1], 1u);   // connect
+  EXPECT_EQ(snapshot.packets_in[2], 1u);    // connack
+  EXPECT_EQ(snapshot.packets_out[3], 5u);   // publish
+  EXPECT_EQ(snapshot.packets_in[3], 5u);    // publish
+  EXPECT_EQ(snapshot.packets_out[4], 5u);   // puback
+  EXPECT_EQ(snapshot.packets_in[4], 5u);    // puback
+  EXPECT_EQ(snapshot.packets_out[8], 1u);   // subscribe
+  EXPECT_EQ(snapshot.packets_in[9], 1u);    // suback
+  EXPECT_EQ(snapshot.packets_out[14], 1u);  // disconnect
+  EXPECT_GT(snapshot.bytes_out, 5u * PAYLOAD_LEN);
+  EXPECT_GT(snapshot.bytes_in, 5u * PAYLOAD_LEN);
+  EXPECT_GE(snapshot.write_calls, 13u);
+  EXPECT_GT(snapshot.read_calls, 0u);
+  EXPECT_EQ(snapshot.timeouts, 0u);
+
+  for (int i = 0; i < LWMQTT_STATS_ERRORS; i++) {
+    EXPECT_EQ(snapshot.errors[i], 0u) << "At error: " << -i;
+  }
+}
+
+TEST(Client, Latency) {
+  lwmqtt_unix_network_t network;
+  lwmqtt_unix_timer_t timer1, timer2;
+
+  lwmqtt_client_t client;
+
+  lwmqtt_init(&client, (uint8_t *)malloc(512), 512, (uint8_t *)malloc(512), 512);
+
+  lwmqtt_set_network(&client, &network, lwmqtt_unix_network_read, lwmqtt_unix_network_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get);
+  lwmqtt_set_callback(&client, (void *)custom_ref, message_arrived);
+
+  static lwmqtt_latency_t latency;
+  lwmqtt_latency_reset(&latency);
+  lwmqtt_set_latency(&client, &latency, nullptr, lwmqtt_unix_clock_get);
+
+  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"127.0.0.1", mock_broker_port(broker));
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  lwmqtt_options_t options = lwmqtt_default_options;
+  options.client_id = lwmqtt_string("lwmqtt");
+  options.username = lwmqtt_string("public");
+  options.password = lwmqtt_string("public");
+
+  lwmqtt_return_code_t return_code;
+  err = lwmqtt_connect(&client, options, nullptr, &return_code, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  err = lwmqtt_subscribe_one(&client, lwmqtt_string("lwmqtt"), LWMQTT_QOS2, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  counter = 0;
+
+  for (int i = 0; i < 4; i++) {
+    lwmqtt_message_t msg = lwmqtt_default_message;
+    msg.qos = i % 2 ? LWMQTT_QOS2 : LWMQTT_QOS1;
+    msg.payload = payload;
+    msg.payload_len = PAYLOAD_LEN;
+
+    err = lwmqtt_publish(&client, lwmqtt_string("lwmqtt"), msg, COMMAND_TIMEOUT);
+    ASSERT_EQ(err, LWMQTT_SUCCESS);
+  }
+
+  // batched messages are timed once each
+  lwmqtt_string_t topics[4];
+  lwmqtt_message_t messages[4];
+  lwmqtt_err_t results[4];
+  for (int i = 0; i < 4; i++) {
+    topics[i] = lwmqtt_string("lwmqtt");
+    messages[i] = {i % 2 ? LWMQTT_QOS2 : LWMQTT_QOS1, false, payload, PAYLOAD_LEN};
+  }
+  err = lwmqtt_publish_batch(&client, 4, topics, messages, results, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  while (counter < 8) {
+    size_t available = 0;
+    err = lwmqtt_unix_network_peek(&network, &available);
+    ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+    if (available > 0) {
+      err = lwmqtt_yield(&client, available, COMMAND_TIMEOUT);
+      ASSERT_EQ(err, LWMQTT_SUCCESS);
+    }
+  }
+
+  lwmqtt_unix_timer_set(&timer1, 0);
+
+  err = lwmqtt_keep_alive(&client, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  while (client.pong_pending) {
+    err = lwmqtt_yield(&client, 0, COMMAND_TIMEOUT);
+    ASSERT_EQ(err, LWMQTT_SUCCESS);
+  }
+
+  err = lwmqtt_unsubscribe_one(&client, lwmqtt_string("lwmqtt"), COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  err = lwmqtt_disconnect(&client, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  lwmqtt_unix_network_disconnect(&network);
+
+  EXPECT_EQ(latency.publish_qos1.count, 4u);
+  EXPECT_EQ(latency.publish_qos2.count, 4u);
+  EXPECT_EQ(latency.subscribe.count, 1u);
+  EXPECT_EQ(latency.unsubscribe.count, 1u);
+  EXPECT_EQ(latency.ping.count, 1u);
+  EXPECT_GT(lwmqtt_histogram_percentile(&latency.publish_qos1, 50), 0u);
+  EXPECT_LT(lwmqtt_histogram_percentile(&latency.publish_qos2, 99.9), (uint32_t)COMMAND_TIMEOUT * 1000);
+}
+
+TEST(Client, Recorder) {
+  lwmqtt_unix_network_t network;
+  lwmqtt_unix_timer_t timer1, timer2;
+
+  lwmqtt_client_t client;
+
+  lwmqtt_init(&client, (uint8_t *)malloc(512), 512, (uint8_t *)malloc(512), 512);
+
+  lwmqtt_set_network(&client, &network, lwmqtt_unix_network_read, lwmqtt_unix_network_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get);
+
+  lwmqtt_event_t events[16];
+  lwmqtt_recorder_t recorder;
+  lwmqtt_recorder_init(&recorder, events, 16, nullptr, lwmqtt_unix_clock_get);
+  lwmqtt_set_recorder(&client, &recorder);
+
+  lwmqtt_err_t err = lwmqtt_unix_network_connect(&network, (char *)"127.0.0.1", mock_broker_port(broker));
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  lwmqtt_options_t options = lwmqtt_default_options;
+  options.client_id = lwmqtt_string("lwmqtt");
+  options.username = lwmqtt_string("public");
+  options.password = lwmqtt_string("public");
+
+  lwmqtt_return_code_t return_code;
+  err = lwmqtt_connect(&client, options, nullptr, &return_code, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  lwmqtt_message_t msg = lwmqtt_default_message;
+  msg.qos = LWMQTT_QOS1;
+  msg.payload = payload;
+  msg.payload_len = PAYLOAD_LEN;
+
+  err = lwmqtt_publish(&client, lwmqtt_string("lwmqtt"), msg, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_SUCCESS);
+
+  client.pong_pending = true;
+  lwmqtt_unix_timer_set(&timer1, 0);
+
+  err = lwmqtt_keep_alive(&client, COMMAND_TIMEOUT);
+  ASSERT_EQ(err, LWMQTT_PONG_TIMEOUT);
+
+  lwmqtt_unix_network_disconnect(&network);
+
+  lwmqtt_event_t dump[16];
+  ASSERT_EQ(lwmqtt_recorder_dump(&recorder, dump, 16), 5u);
+
+  EXPECT_EQ(dump[0].direction, LWMQTT_EVENT_OUT);
+  EXPECT_EQ(dump[0].packet_type, 1);
+  EXPECT_EQ(dump[1].direction, LWMQTT_EVENT_IN);
+  EXPECT_EQ(dump[1].packet_type, 2);
+  EXPECT_EQ(dump[2].direction, LWMQTT_EVENT_OUT);
+  EXPECT_EQ(dump[2].packet_type, 3);
+  EXPECT_EQ(dump[2].len, 2u + 2u + 6u + 2u + PAYLOAD_LEN + 1u);
+  EXPECT_EQ(dump[3].direction, LWMQTT_EVENT_IN);
+  EXPECT_EQ(dump[3].packet_type, 4);
+  EXPECT_EQ(dump[3].packet_id, dump[2].packet_id);
+  EXPECT_NE(dump[3].packet_id, 0);
+  EXPECT_EQ(dump[4].direction, LWMQTT_EVENT_ERROR);
+  EXPECT_EQ(dump[4].err, LWMQTT_PONG_TIMEOUT);
+  EXPECT_EQ(dump[4].packet_type, 4);
+  EXPECT_LE(dump[0].time, dump[4].time);
+}
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <lwmqtt/envelope.h>
+#include <lwmqtt/unix.h>
+}
+
+TEST(Envelope, PackUnpack) {
+  uint8_t buf[512];
+  lwmqtt_envelope_packer_t packer;
+  lwmqtt_envelope_packer_init(&packer, buf, sizeof(buf), 0, nullptr, nullptr, nullptr, 0);
+
+  uint8_t record[200];
+  for (size_t i = 0; i < sizeof(record); i++) {
+    record[i] = (uint8_t)i;
+  }
+
+  size_t lengths[4] = {0, 1, 127, 200};
+  for (size_t len : lengths) {
+    lwmqtt_err_t err = lwmqtt_envelope_pack(&packer, record, len);
+    EXPECT_EQ(err, LWMQTT_SUCCESS);
+  }
+
+  EXPECT_EQ(packer.count, 4);
+  EXPECT_EQ(packer.len, (size_t)(1 + 0 + 1 + 1 + 1 + 127 + 2 + 200));
+  EXPECT_FALSE(lwmqtt_envelope_due(&packer));
+
+  lwmqtt_message_t msg = lwmqtt_default_message;
+  lwmqtt_envelope_fill(&packer, &msg);
+  EXPECT_EQ(msg.payload, buf);
+  EXPECT_EQ(msg.payload_len, packer.len);
+
+  lwmqtt_envelope_reader_t reader;
+  lwmqtt_envelope_reader_init(&reader, msg);
+
+  for (size_t len : lengths) {
+    uint8_t *data;
+    size_t data_len;
+    bool found;
+    lwmqtt_err_t err = lwmqtt_envelope_next(&reader, &data, &data_len, &found);
+    EXPECT_EQ(err, LWMQTT_SUCCESS);
+    EXPECT_TRUE(found);
+    EXPECT_EQ(data_len, len);
+    if (len > 0) {
+      EXPECT_GE(data, buf);
+      EXPECT_LT(data, buf + sizeof(buf));
+      EXPECT_EQ(memcmp(data, record, len), 0);
+    }
+  }
+
+  uint8_t *data;
+  size_t data_len;
+  bool found;
+  lwmqtt_err_t err = lwmqtt_envelope_next(&reader, &data, &data_len, &found);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+  EXPECT_FALSE(found);
+
+  lwmqtt_envelope_reset(&packer);
+  EXPECT_EQ(packer.count, 0);
+  EXPECT_EQ(packer.len, (size_t)0);
+}
+
+TEST(Envelope, BufferTooShort) {
+  uint8_t buf[10];
+  lwmqtt_envelope_packer_t packer;
+  lwmqtt_envelope_packer_init(&packer, buf, sizeof(buf), 0, nullptr, nullptr, nullptr, 0);
+
+  uint8_t record[8] = {0};
+  lwmqtt_err_t err = lwmqtt_envelope_pack(&packer, record, 8);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+
+  err = lwmqtt_envelope_pack(&packer, record, 0);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+  EXPECT_TRUE(lwmqtt_envelope_due(&packer));
+
+  err = lwmqtt_envelope_pack(&packer, record, 0);
+  EXPECT_EQ(err, LWMQTT_BUFFER_TOO_SHORT);
+  EXPECT_EQ(packer.count, 2);
+  EXPECT_EQ(packer.len, (size_t)10);
+}
+
+TEST(Envelope, Triggers) {
+  uint8_t buf[64];
+  lwmqtt_unix_timer_t timer;
+  lwmqtt_envelope_packer_t packer;
+  lwmqtt_envelope_packer_init(&packer, buf, sizeof(buf), 16, &timer, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get,
+                              60000);
+
+  uint8_t record[8] = {0};
+  lwmqtt_err_t err = lwmqtt_envelope_pack(&packer, record, 8);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+  EXPECT_FALSE(lwmqtt_envelope_due(&packer));
+
+  err = lwmqtt_envelope_pack(&packer, record, 8);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+  EXPECT_TRUE(lwmqtt_envelope_due(&packer));
+
+  lwmqtt_envelope_reset(&packer);
+  packer.flush_time = 0;
+
+  err = lwmqtt_envelope_pack(&packer, record, 1);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+  EXPECT_TRUE(lwmqtt_envelope_due(&packer));
+}
+
+TEST(Envelope, Truncated) {
+  uint8_t payload[3] = {5, 'a', 'b'};
+
+  lwmqtt_message_t msg = lwmqtt_default_message;
+  msg.payload = payload;
+  msg.payload_len = sizeof(payload);
+
+  lwmqtt_envelope_reader_t reader;
+  lwmqtt_envelope_reader_init(&reader, msg);
+
+  uint8_t *data;
+  size_t data_len;
+  bool found;
+  lwmqtt_err_t err = lwmqtt_envelope_next(&reader, &data, &data_len, &found);
+  EXPECT_EQ(err, LWMQTT_BUFFER_TOO_SHORT);
+  EXPECT_FALSE(found);
+}
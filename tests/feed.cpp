@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <lwmqtt.h>
+#include <lwmqtt/pipe.h>
+}
+
+static int arrived = 0;
+
+static void message_arrived(lwmqtt_client_t *client, void *ref, lwmqtt_string_t topic, lwmqtt_message_t msg) {
+  ASSERT_EQ(lwmqtt_strcmp(topic, "a"), 0);
+  ASSERT_EQ(msg.payload_len, 5u);
+  ASSERT_EQ(memcmp(msg.payload, "hello", 5), 0);
+  arrived++;
+}
+
+static lwmqtt_response_t responses[8];
+static int response_count = 0;
+static uint8_t granted[8];
+
+static void response_arrived(lwmqtt_client_t *client, void *ref, lwmqtt_response_t response) {
+  if (response.granted_count > 0) {
+    memcpy(granted, response.granted_qos, response.granted_count);
+  }
+  responses[response_count++] = response;
+}
+
+struct Feed : testing::Test {
+  lwmqtt_pipe_clock_t clock = {0};
+  lwmqtt_pipe_timer_t timer1{}, timer2{};
+  uint8_t write_buf[64]{}, read_buf[64]{}, output_buf[128]{};
+  lwmqtt_client_t client{};
+
+  void SetUp() override {
+    arrived = 0;
+    response_count = 0;
+    lwmqtt_pipe_timer_init(&timer1, &clock);
+    lwmqtt_pipe_timer_init(&timer2, &clock);
+    lwmqtt_init(&client, write_buf, sizeof(write_buf), read_buf, sizeof(read_buf));
+    lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_pipe_timer_set, lwmqtt_pipe_timer_get);
+    lwmqtt_set_callback(&client, nullptr, message_arrived);
+    lwmqtt_set_response_callback(&client, nullptr, response_arrived);
+    lwmqtt_set_output(&client, output_buf, sizeof(output_buf));
+  }
+
+  void drain(uint8_t expected) {
+    uint8_t *buf;
+    size_t len;
+    lwmqtt_pending_output(&client, &buf, &len);
+    ASSERT_GT(len, 1u);
+    ASSERT_EQ(buf[0], expected);
+    lwmqtt_consume_output(&client, 2 + buf[1]);
+  }
+};
+
+TEST_F(Feed, Connect) {
+  lwmqtt_return_code_t return_code;
+  ASSERT_EQ(lwmqtt_connect(&client, lwmqtt_default_options, nullptr, &return_code, 1000), LWMQTT_SUCCESS);
+  EXPECT_EQ(return_code, LWMQTT_UNKNOWN_RETURN_CODE);
+  drain(0x10);
+
+  uint8_t *buf;
+  size_t len;
+  lwmqtt_pending_output(&client, &buf, &len);
+  EXPECT_EQ(len, 0u);
+
+  uint8_t connack[4] = {0x20, 2, 0, 0};
+  for (uint8_t byte : connack) {
+    ASSERT_EQ(response_count, 0);
+    ASSERT_EQ(lwmqtt_feed(&client, &byte, 1), LWMQTT_SUCCESS);
+  }
+  ASSERT_EQ(response_count, 1);
+  EXPECT_EQ(responses[0].packet_type, LWMQTT_CONNACK_PACKET);
+  EXPECT_FALSE(responses[0].session_present);
+  EXPECT_EQ(responses[0].return_code, LWMQTT_CONNECTION_ACCEPTED);
+}
+
+TEST_F(Feed, Subscribe) {
+  ASSERT_EQ(lwmqtt_subscribe_one(&client, lwmqtt_string("a"), LWMQTT_QOS1, 1000), LWMQTT_SUCCESS);
+  drain(0x82);
+
+  uint8_t suback[5] = {0x90, 3, 0, 1, 1};
+  ASSERT_EQ(lwmqtt_feed(&client, suback, 2), LWMQTT_SUCCESS);
+  ASSERT_EQ(lwmqtt_feed(&client, suback + 2, 3), LWMQTT_SUCCESS);
+  ASSERT_EQ(response_count, 1);
+  EXPECT_EQ(responses[0].packet_type, LWMQTT_SUBACK_PACKET);
+  EXPECT_EQ(responses[0].packet_id, 1);
+  EXPECT_EQ(responses[0].granted_count, 1u);
+  EXPECT_EQ(granted[0], 1);
+}
+
+TEST_F(Feed, Publish) {
+  lwmqtt_message_t message = {LWMQTT_QOS1, false, (uint8_t *)"hello", 5};
+  ASSERT_EQ(lwmqtt_publish(&client, lwmqtt_string("a"), message, 1000), LWMQTT_SUCCESS);
+  ASSERT_EQ(lwmqtt_publish(&client, lwmqtt_string("a"), message, 1000), LWMQTT_SUCCESS);
+  drain(0x32);
+  drain(0x32);
+
+  uint8_t pubacks[8] = {0x40, 2, 0, 1, 0x40, 2, 0, 2};
+  ASSERT_EQ(lwmqtt_feed(&client, pubacks, sizeof(pubacks)), LWMQTT_SUCCESS);
+  ASSERT_EQ(response_count, 2);
+  EXPECT_EQ(responses[0].packet_type, LWMQTT_PUBACK_PACKET);
+  EXPECT_EQ(responses[0].packet_id, 1);
+  EXPECT_EQ(responses[1].packet_id, 2);
+}
+
+TEST_F(Feed, Receive) {
+  uint8_t publish[12] = {0x32, 10, 0, 1, 'a', 0, 7, 'h', 'e', 'l', 'l', 'o'};
+  uint8_t data[3 * sizeof(publish)];
+  for (int i = 0; i < 3; i++) {
+    memcpy(data + i * sizeof(publish), publish, sizeof(publish));
+  }
+
+  // feed in uneven chunks to mix zero-copy and assembled packets
+  size_t offset = 0;
+  size_t chunks[4] = {5, 14, 1, 16};
+  for (size_t chunk : chunks) {
+    ASSERT_EQ(lwmqtt_feed(&client, data + offset, chunk), LWMQTT_SUCCESS);
+    offset += chunk;
+  }
+  EXPECT_EQ(arrived, 3);
+  EXPECT_EQ(response_count, 0);
+
+  uint8_t *buf;
+  size_t len;
+  lwmqtt_pending_output(&client, &buf, &len);
+  ASSERT_EQ(len, 12u);
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(buf[i * 4], 0x40);
+    EXPECT_EQ(buf[i * 4 + 3], 7);
+  }
+
+  lwmqtt_consume_output(&client, 5);
+  lwmqtt_consume_output(&client, 7);
+  lwmqtt_pending_output(&client, &buf, &len);
+  EXPECT_EQ(len, 0u);
+}
+
+TEST_F(Feed, Overflow) {
+  uint8_t big[80] = {0x30, 78, 0, 1, 'a'};
+  EXPECT_EQ(lwmqtt_feed(&client, big, 10), LWMQTT_BUFFER_TOO_SHORT);
+
+  uint32_t overflows = 0;
+  lwmqtt_init(&client, write_buf, sizeof(write_buf), read_buf, sizeof(read_buf));
+  lwmqtt_set_callback(&client, nullptr, message_arrived);
+  lwmqtt_set_output(&client, output_buf, sizeof(output_buf));
+  lwmqtt_drop_overflow(&client, true, &overflows);
+
+  uint8_t publish[10] = {0x30, 8, 0, 1, 'a', 'h', 'e', 'l', 'l', 'o'};
+  ASSERT_EQ(lwmqtt_feed(&client, big, 40), LWMQTT_SUCCESS);
+  ASSERT_EQ(lwmqtt_feed(&client, big + 40, 40), LWMQTT_SUCCESS);
+  ASSERT_EQ(lwmqtt_feed(&client, publish, sizeof(publish)), LWMQTT_SUCCESS);
+  EXPECT_EQ(overflows, 1u);
+  EXPECT_EQ(arrived, 1);
+}
+
+TEST_F(Feed, OutputFull) {
+  uint8_t payload[40] = {0};
+  lwmqtt_message_t message = {LWMQTT_QOS0, false, payload, sizeof(payload)};
+  ASSERT_EQ(lwmqtt_publish(&client, lwmqtt_string("a"), message, 1000), LWMQTT_SUCCESS);
+  ASSERT_EQ(lwmqtt_publish(&client, lwmqtt_string("a"), message, 1000), LWMQTT_SUCCESS);
+  EXPECT_EQ(lwmqtt_publish(&client, lwmqtt_string("a"), message, 1000), LWMQTT_BUFFER_TOO_SHORT);
+
+  drain(0x30);
+  ASSERT_EQ(lwmqtt_publish(&client, lwmqtt_string("a"), message, 1000), LWMQTT_SUCCESS);
+}
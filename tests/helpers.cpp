@@ -118,3 +118,25 @@ TEST(VarNumMax, Valid) {
 
   EXPECT_EQ(num, (uint32_t)268435455);
 }
+
+TEST(VarNumLength, Boundaries) {
+  uint32_t nums[] = {127, 128, 16383, 16384, 2097151, 2097152, 268435455};
+  int lens[] = {1, 2, 2, 3, 3, 4, 4};
+
+  for (size_t i = 0; i < sizeof(nums) / sizeof(nums[0]); i++) {
+    int len;
+    lwmqtt_err_t err = lwmqtt_varnum_length(nums[i], &len);
+    EXPECT_EQ(err, LWMQTT_SUCCESS);
+    EXPECT_EQ(len, lens[i]) << "For number: " << nums[i];
+
+    uint8_t buf[4];
+    uint8_t *ptr = buf;
+    err = lwmqtt_write_varnum(&ptr, buf + 4, nums[i]);
+    EXPECT_EQ(err, LWMQTT_SUCCESS);
+    EXPECT_EQ(ptr - buf, lens[i]);
+  }
+
+  int len;
+  lwmqtt_err_t err = lwmqtt_varnum_length(268435456, &len);
+  EXPECT_EQ(err, LWMQTT_VARNUM_OVERFLOW);
+}
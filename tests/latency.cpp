@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <lwmqtt/latency.h>
+}
+
+TEST(Histogram, Empty) {
+  lwmqtt_histogram_t histogram;
+  lwmqtt_histogram_reset(&histogram);
+
+  EXPECT_EQ(histogram.count, 0u);
+  EXPECT_EQ(lwmqtt_histogram_percentile(&histogram, 50), 0u);
+}
+
+TEST(Histogram, Exact) {
+  lwmqtt_histogram_t histogram;
+  lwmqtt_histogram_reset(&histogram);
+
+  for (uint32_t i = 1; i <= 10; i++) {
+    lwmqtt_histogram_record(&histogram, i);
+  }
+
+  EXPECT_EQ(histogram.count, 10u);
+  EXPECT_EQ(histogram.min, 1u);
+  EXPECT_EQ(histogram.max, 10u);
+  EXPECT_EQ(lwmqtt_histogram_percentile(&histogram, 0), 1u);
+  EXPECT_EQ(lwmqtt_histogram_percentile(&histogram, 50), 5u);
+  EXPECT_EQ(lwmqtt_histogram_percentile(&histogram, 90), 9u);
+  EXPECT_EQ(lwmqtt_histogram_percentile(&histogram, 100), 10u);
+}
+
+TEST(Histogram, RelativeError) {
+  lwmqtt_histogram_t histogram;
+
+  uint32_t values[] = {16, 17, 100, 1000, 65535, 65536, 1000000, 123456789, UINT32_MAX};
+  for (uint32_t value : values) {
+    lwmqtt_histogram_reset(&histogram);
+    lwmqtt_histogram_record(&histogram, value);
+    lwmqtt_histogram_record(&histogram, UINT32_MAX);
+
+    uint32_t p50 = lwmqtt_histogram_percentile(&histogram, 50);
+    EXPECT_GE(p50, value);
+    EXPECT_LE((double)(p50 - value), (double)value / (1 << LWMQTT_HISTOGRAM_BITS)) << "For value: " << value;
+  }
+}
+
+TEST(Histogram, Percentiles) {
+  lwmqtt_histogram_t histogram;
+  lwmqtt_histogram_reset(&histogram);
+
+  for (uint32_t i = 1; i <= 100000; i++) {
+    lwmqtt_histogram_record(&histogram, i);
+  }
+
+  uint32_t p50 = lwmqtt_histogram_percentile(&histogram, 50);
+  uint32_t p99 = lwmqtt_histogram_percentile(&histogram, 99);
+  uint32_t p999 = lwmqtt_histogram_percentile(&histogram, 99.9);
+
+  EXPECT_NEAR(p50, 50000, 50000 / (1 << LWMQTT_HISTOGRAM_BITS));
+  EXPECT_NEAR(p99, 99000, 99000 / (1 << LWMQTT_HISTOGRAM_BITS));
+  EXPECT_NEAR(p999, 99900, 99900 / (1 << LWMQTT_HISTOGRAM_BITS));
+  EXPECT_LE(p999, 100000u);
+}
@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <lwmqtt/lz.h>
+#include "../src/packet.h"
+}
+
+static lwmqtt_lz_state_t state;
+
+static size_t json_payload(uint8_t *buf, size_t size) {
+  size_t len = 0;
+  for (int i = 0; len + 128 < size; i++) {
+    len += snprintf((char *)buf + len, size - len,
+                    "{\"device\":\"sensor-%03d\",\"temperature\":%d.%d,\"humidity\":%d,\"status\":\"ok\"},", i % 50,
+                    20 + i % 7, i % 10, 40 + i % 13);
+  }
+  return len;
+}
+
+TEST(LZ, RoundTrip) {
+  uint8_t in[4096];
+  size_t in_len = json_payload(in, sizeof(in));
+
+  uint8_t compressed[4096];
+  size_t compressed_len;
+  bool transformed;
+  lwmqtt_err_t err = lwmqtt_lz_compress(&state, in, in_len, compressed, sizeof(compressed), &compressed_len,
+                                        &transformed);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+  EXPECT_TRUE(transformed);
+  EXPECT_LT(compressed_len, in_len / 2);
+
+  uint8_t out[4096];
+  size_t out_len;
+  err = lwmqtt_lz_decompress(nullptr, compressed, compressed_len, out, sizeof(out), &out_len, &transformed);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+  EXPECT_TRUE(transformed);
+  EXPECT_EQ(out_len, in_len);
+  EXPECT_EQ(memcmp(in, out, in_len), 0);
+}
+
+TEST(LZ, Incompressible) {
+  uint8_t in[256];
+  uint32_t seed = 42;
+  for (unsigned char &b : in) {
+    seed = seed * 1103515245 + 12345;
+    b = (uint8_t)(seed >> 16);
+  }
+  in[0] = 1;
+
+  uint8_t compressed[512];
+  size_t compressed_len;
+  bool transformed;
+  lwmqtt_err_t err = lwmqtt_lz_compress(&state, in, sizeof(in), compressed, sizeof(compressed), &compressed_len,
+                                        &transformed);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+  EXPECT_FALSE(transformed);
+
+  uint8_t out[512];
+  size_t out_len;
+  err = lwmqtt_lz_decompress(nullptr, in, sizeof(in), out, sizeof(out), &out_len, &transformed);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+  EXPECT_FALSE(transformed);
+}
+
+TEST(LZ, MarkedInput) {
+  uint8_t in[5] = {0x00, 'L', 'Z', 1, 2};
+
+  uint8_t compressed[64];
+  size_t compressed_len;
+  bool transformed;
+  lwmqtt_err_t err = lwmqtt_lz_compress(&state, in, sizeof(in), compressed, sizeof(compressed), &compressed_len,
+                                        &transformed);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+  EXPECT_TRUE(transformed);
+  EXPECT_GT(compressed_len, sizeof(in));
+
+  uint8_t out[64];
+  size_t out_len;
+  err = lwmqtt_lz_decompress(nullptr, compressed, compressed_len, out, sizeof(out), &out_len, &transformed);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+  EXPECT_TRUE(transformed);
+  EXPECT_EQ(out_len, sizeof(in));
+  EXPECT_EQ(memcmp(in, out, sizeof(in)), 0);
+
+  err = lwmqtt_lz_compress(&state, in, sizeof(in), compressed, 4, &compressed_len, &transformed);
+  EXPECT_EQ(err, LWMQTT_BUFFER_TOO_SHORT);
+}
+
+TEST(LZ, Malformed) {
+  uint8_t in[1024];
+  size_t in_len = json_payload(in, sizeof(in));
+
+  uint8_t compressed[1024];
+  size_t compressed_len;
+  bool transformed;
+  lwmqtt_err_t err = lwmqtt_lz_compress(&state, in, in_len, compressed, sizeof(compressed), &compressed_len,
+                                        &transformed);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+  EXPECT_TRUE(transformed);
+
+  uint8_t out[1024];
+  size_t out_len;
+  for (size_t len = 3; len < compressed_len; len++) {
+    err = lwmqtt_lz_decompress(nullptr, compressed, len, out, sizeof(out), &out_len, &transformed);
+    EXPECT_NE(err, LWMQTT_SUCCESS);
+  }
+
+  err = lwmqtt_lz_decompress(nullptr, compressed, compressed_len, out, in_len - 1, &out_len, &transformed);
+  EXPECT_EQ(err, LWMQTT_BUFFER_TOO_SHORT);
+}
+
+TEST(LZ, EncodePublish) {
+  uint8_t payload[2048];
+  size_t payload_len = json_payload(payload, sizeof(payload));
+
+  lwmqtt_message_t msg = lwmqtt_default_message;
+  msg.qos = LWMQTT_QOS1;
+  msg.payload = payload;
+  msg.payload_len = payload_len;
+
+  uint8_t buf[2048];
+  size_t len;
+  lwmqtt_err_t err = lwmqtt_encode_publish_transformed(buf, sizeof(buf), &len, false, 7, lwmqtt_string("telemetry"),
+                                                       msg, lwmqtt_lz_compress, &state);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+  EXPECT_LT(len, payload_len);
+
+  bool dup;
+  uint16_t packet_id;
+  lwmqtt_string_t topic;
+  lwmqtt_message_t decoded;
+  err = lwmqtt_decode_publish(buf, len, &dup, &packet_id, &topic, &decoded);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+  EXPECT_EQ(packet_id, 7);
+  EXPECT_EQ(lwmqtt_strcmp(topic, "telemetry"), 0);
+
+  uint8_t out[2048];
+  size_t out_len;
+  bool transformed;
+  err = lwmqtt_lz_decompress(nullptr, decoded.payload, decoded.payload_len, out, sizeof(out), &out_len, &transformed);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+  EXPECT_TRUE(transformed);
+  EXPECT_EQ(out_len, payload_len);
+  EXPECT_EQ(memcmp(out, payload, payload_len), 0);
+}
+
+TEST(LZ, EncodePublishShrinkingLength) {
+  uint8_t payload[200];
+  memset(payload, 'a', sizeof(payload));
+
+  lwmqtt_message_t msg = lwmqtt_default_message;
+  msg.payload = payload;
+  msg.payload_len = sizeof(payload);
+
+  uint8_t buf[256];
+  size_t len;
+  lwmqtt_err_t err = lwmqtt_encode_publish_transformed(buf, sizeof(buf), &len, false, 0, lwmqtt_string("t"), msg,
+                                                       lwmqtt_lz_compress, &state);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+  EXPECT_EQ(buf[1], len - 2);
+
+  bool dup;
+  uint16_t packet_id;
+  lwmqtt_string_t topic;
+  lwmqtt_message_t decoded;
+  err = lwmqtt_decode_publish(buf, len, &dup, &packet_id, &topic, &decoded);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+
+  uint8_t out[256];
+  size_t out_len;
+  bool transformed;
+  err = lwmqtt_lz_decompress(nullptr, decoded.payload, decoded.payload_len, out, sizeof(out), &out_len, &transformed);
+  EXPECT_EQ(err, LWMQTT_SUCCESS);
+  EXPECT_EQ(out_len, sizeof(payload));
+  EXPECT_EQ(memcmp(out, payload, sizeof(payload)), 0);
+}
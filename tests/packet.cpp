@@ -1,5 +1,11 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
 extern "C" {
 #include <lwmqtt.h>
 #include "../src/packet.h"
@@ -765,3 +771,197 @@ TEST(UnsubscribeTest, EncodeError1) {
 
   EXPECT_EQ(err, LWMQTT_BUFFER_TOO_SHORT);
 }
+
+static void ref_write_num(std::vector<uint8_t> &out, uint16_t num) {
+  out.push_back((uint8_t)(num >> 8));
+  out.push_back((uint8_t)(num & 0xFF));
+}
+
+static void ref_write_string(std::vector<uint8_t> &out, const std::string &str) {
+  ref_write_num(out, (uint16_t)str.size());
+  out.insert(out.end(), str.begin(), str.end());
+}
+
+static std::vector<uint8_t> ref_packet(uint8_t header, const std::vector<uint8_t> &body) {
+  std::vector<uint8_t> out;
+  out.push_back(header);
+  size_t rem_len = body.size();
+  do {
+    uint8_t byte = (uint8_t)(rem_len % 128);
+    rem_len /= 128;
+    out.push_back(rem_len > 0 ? (uint8_t)(byte | 0x80) : byte);
+  } while (rem_len > 0);
+  out.insert(out.end(), body.begin(), body.end());
+  return out;
+}
+
+static std::string random_string(std::mt19937 &rng, size_t max) {
+  std::string str(rng() % (max + 1), 0);
+  for (auto &c : str) {
+    c = (char)('a' + rng() % 26);
+  }
+  return str;
+}
+
+static void expect_encoding(const std::vector<uint8_t> &ref,
+                            const std::function<lwmqtt_err_t(uint8_t *, size_t, size_t *)> &encode) {
+  std::vector<uint8_t> buf(ref.size() + 1, 0xAA);
+
+  // exact and larger buffers must yield the reference encoding
+  for (size_t buf_len : {ref.size(), ref.size() + 1}) {
+    size_t len = 0;
+    lwmqtt_err_t err = encode(buf.data(), buf_len, &len);
+    ASSERT_EQ(err, LWMQTT_SUCCESS);
+    ASSERT_EQ(len, ref.size());
+    EXPECT_ARRAY_EQ(ref, buf, len);
+  }
+
+  // any shorter buffer must be rejected without writing past its end
+  for (size_t buf_len : {(size_t)0, ref.size() / 2, ref.size() - 1}) {
+    std::fill(buf.begin(), buf.end(), 0xAA);
+    size_t len = 0;
+    lwmqtt_err_t err = encode(buf.data(), buf_len, &len);
+    ASSERT_EQ(err, LWMQTT_BUFFER_TOO_SHORT);
+    for (size_t i = buf_len; i < buf.size(); i++) {
+      ASSERT_EQ(buf[i], 0xAA);
+    }
+  }
+}
+
+TEST(ConnectTest, EncodeDifferential) {
+  std::mt19937 rng(1);
+
+  for (int i = 0; i < 200; i++) {
+    std::string client_id = random_string(rng, 64);
+    std::string username = random_string(rng, 16);
+    std::string password = random_string(rng, 16);
+    std::string will_topic = random_string(rng, 32);
+    std::string will_payload = random_string(rng, i % 2 ? 300 : 32);
+    bool has_will = rng() % 2;
+
+    lwmqtt_options_t options = lwmqtt_default_options;
+    options.client_id = lwmqtt_string(client_id.c_str());
+    options.username = lwmqtt_string(username.c_str());
+    options.password = lwmqtt_string(password.c_str());
+    options.keep_alive = (uint16_t)rng();
+    options.clean_session = rng() % 2;
+
+    lwmqtt_will_t will = lwmqtt_default_will;
+    will.topic = lwmqtt_string(will_topic.c_str());
+    will.payload = lwmqtt_string(will_payload.c_str());
+    will.qos = (lwmqtt_qos_t)(rng() % 3);
+    will.retained = rng() % 2;
+
+    std::vector<uint8_t> body;
+    ref_write_string(body, "MQTT");
+    body.push_back(4);
+    uint8_t flags = options.clean_session ? 0x02 : 0;
+    if (has_will) {
+      flags |= (uint8_t)(0x04 | (will.qos << 3) | (will.retained ? 0x20 : 0));
+    }
+    if (!username.empty()) {
+      flags |= 0x80;
+      if (!password.empty()) {
+        flags |= 0x40;
+      }
+    }
+    body.push_back(flags);
+    ref_write_num(body, options.keep_alive);
+    ref_write_string(body, client_id);
+    if (has_will) {
+      ref_write_string(body, will_topic);
+      ref_write_string(body, will_payload);
+    }
+    if (!username.empty()) {
+      ref_write_string(body, username);
+      if (!password.empty()) {
+        ref_write_string(body, password);
+      }
+    }
+
+    expect_encoding(ref_packet(0x10, body), [&](uint8_t *buf, size_t buf_len, size_t *len) {
+      return lwmqtt_encode_connect(buf, buf_len, len, options, has_will ? &will : nullptr);
+    });
+  }
+}
+
+TEST(PublishTest, EncodeDifferential) {
+  std::mt19937 rng(2);
+
+  // cover all remaining length length boundaries
+  std::vector<size_t> payload_lens = {0, 1, 100, 127, 16383, 16384, 70000};
+  for (int i = 0; i < 100; i++) {
+    payload_lens.push_back(rng() % 20000);
+  }
+
+  for (size_t payload_len : payload_lens) {
+    std::string topic = random_string(rng, 64);
+    std::vector<uint8_t> payload(payload_len);
+    for (auto &b : payload) {
+      b = (uint8_t)rng();
+    }
+
+    lwmqtt_message_t msg = lwmqtt_default_message;
+    msg.qos = (lwmqtt_qos_t)(rng() % 3);
+    msg.retained = rng() % 2;
+    msg.payload = payload.data();
+    msg.payload_len = payload.size();
+    bool dup = rng() % 2;
+    uint16_t packet_id = (uint16_t)rng();
+
+    std::vector<uint8_t> body;
+    ref_write_string(body, topic);
+    if (msg.qos > 0) {
+      ref_write_num(body, packet_id);
+    }
+    body.insert(body.end(), payload.begin(), payload.end());
+    uint8_t header = (uint8_t)(0x30 | (dup ? 0x08 : 0) | (msg.qos << 1) | (msg.retained ? 1 : 0));
+
+    expect_encoding(ref_packet(header, body), [&](uint8_t *buf, size_t buf_len, size_t *len) {
+      return lwmqtt_encode_publish(buf, buf_len, len, dup, packet_id, lwmqtt_string(topic.c_str()), msg);
+    });
+
+    // the header alone must match the packet without its payload
+    std::vector<uint8_t> ref = ref_packet(header, body);
+    std::vector<uint8_t> buf(ref.size() - payload_len);
+    size_t len = 0;
+    ASSERT_EQ(lwmqtt_encode_publish_header(buf.data(), buf.size(), &len, dup, packet_id, lwmqtt_string(topic.c_str()),
+                                           msg),
+              LWMQTT_SUCCESS);
+    ASSERT_EQ(len, buf.size());
+    EXPECT_TRUE(std::equal(buf.begin(), buf.end(), ref.begin()));
+    EXPECT_EQ(lwmqtt_encode_publish_header(buf.data(), buf.size() - 1, &len, dup, packet_id,
+                                           lwmqtt_string(topic.c_str()), msg),
+              LWMQTT_BUFFER_TOO_SHORT);
+  }
+}
+
+TEST(SubscribeTest, EncodeDifferential) {
+  std::mt19937 rng(3);
+
+  for (int i = 0; i < 200; i++) {
+    int count = 1 + (int)(rng() % (i % 10 == 0 ? 400 : 8));
+    std::vector<std::string> filters;
+    std::vector<lwmqtt_string_t> topic_filters;
+    std::vector<lwmqtt_qos_t> qos_levels;
+    for (int j = 0; j < count; j++) {
+      filters.push_back(random_string(rng, 48));
+      qos_levels.push_back((lwmqtt_qos_t)(rng() % 3));
+    }
+    for (auto &filter : filters) {
+      topic_filters.push_back(lwmqtt_string(filter.c_str()));
+    }
+    uint16_t packet_id = (uint16_t)rng();
+
+    std::vector<uint8_t> body;
+    ref_write_num(body, packet_id);
+    for (int j = 0; j < count; j++) {
+      ref_write_string(body, filters[j]);
+      body.push_back((uint8_t)qos_levels[j]);
+    }
+
+    expect_encoding(ref_packet(0x82, body), [&](uint8_t *buf, size_t buf_len, size_t *len) {
+      return lwmqtt_encode_subscribe(buf, buf_len, len, packet_id, count, topic_filters.data(), qos_levels.data());
+    });
+  }
+}
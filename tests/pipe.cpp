@@ -0,0 +1,618 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <lwmqtt/pipe.h>
+#include <lwmqtt/recorder.h>
+}
+
+TEST(Pipe, Transfer) {
+  lwmqtt_pipe_clock_t clock = {0};
+  uint8_t buf[64];
+  lwmqtt_pipe_t pipe;
+  lwmqtt_pipe_init(&pipe, &clock, buf, sizeof(buf));
+
+  size_t sent = 0;
+  ASSERT_EQ(lwmqtt_pipe_write(&pipe.a, (uint8_t *)"hello", 5, &sent, 0), LWMQTT_SUCCESS);
+  EXPECT_EQ(sent, 5u);
+  EXPECT_EQ(lwmqtt_pipe_available(&pipe.a), 0u);
+  EXPECT_EQ(lwmqtt_pipe_available(&pipe.b), 5u);
+
+  uint8_t data[8];
+  size_t read = 0;
+  ASSERT_EQ(lwmqtt_pipe_read(&pipe.b, data, sizeof(data), &read, 0), LWMQTT_SUCCESS);
+  EXPECT_EQ(read, 5u);
+  EXPECT_EQ(memcmp(data, "hello", 5), 0);
+  EXPECT_EQ(lwmqtt_pipe_available(&pipe.b), 0u);
+  EXPECT_EQ(clock.now, 0u);
+}
+
+TEST(Pipe, Wrap) {
+  lwmqtt_pipe_clock_t clock = {0};
+  uint8_t buf[16];
+  lwmqtt_pipe_t pipe;
+  lwmqtt_pipe_init(&pipe, &clock, buf, sizeof(buf));
+
+  for (int i = 0; i < 10; i++) {
+    uint8_t out[5] = {(uint8_t)i, 1, 2, 3, 4};
+    size_t sent = 0;
+    ASSERT_EQ(lwmqtt_pipe_write(&pipe.b, out, sizeof(out), &sent, 0), LWMQTT_SUCCESS);
+    ASSERT_EQ(sent, sizeof(out));
+
+    uint8_t in[5];
+    size_t read = 0;
+    ASSERT_EQ(lwmqtt_pipe_read(&pipe.a, in, sizeof(in), &read, 0), LWMQTT_SUCCESS);
+    ASSERT_EQ(read, sizeof(in));
+    EXPECT_EQ(memcmp(in, out, sizeof(out)), 0);
+  }
+}
+
+TEST(Pipe, Full) {
+  lwmqtt_pipe_clock_t clock = {0};
+  uint8_t buf[16];
+  lwmqtt_pipe_t pipe;
+  lwmqtt_pipe_init(&pipe, &clock, buf, sizeof(buf));
+
+  uint8_t data[10] = {0};
+  size_t sent = 0;
+  ASSERT_EQ(lwmqtt_pipe_write(&pipe.a, data, sizeof(data), &sent, 0), LWMQTT_SUCCESS);
+  EXPECT_EQ(sent, 8u);
+
+  ASSERT_EQ(lwmqtt_pipe_write(&pipe.a, data, sizeof(data), &sent, 100), LWMQTT_SUCCESS);
+  EXPECT_EQ(sent, 8u);
+  EXPECT_EQ(clock.now, 100000u);
+}
+
+TEST(Pipe, Latency) {
+  lwmqtt_pipe_clock_t clock = {0};
+  uint8_t buf[64];
+  lwmqtt_pipe_t pipe;
+  lwmqtt_pipe_init(&pipe, &clock, buf, sizeof(buf));
+  pipe.rings[0].options.latency = 1500;
+
+  size_t sent = 0;
+  ASSERT_EQ(lwmqtt_pipe_write(&pipe.a, (uint8_t *)"hello", 5, &sent, 0), LWMQTT_SUCCESS);
+  EXPECT_EQ(lwmqtt_pipe_available(&pipe.b), 0u);
+
+  uint8_t data[8];
+  size_t read = 0;
+  ASSERT_EQ(lwmqtt_pipe_read(&pipe.b, data, sizeof(data), &read, 1), LWMQTT_SUCCESS);
+  EXPECT_EQ(read, 0u);
+  EXPECT_EQ(clock.now, 1000u);
+
+  ASSERT_EQ(lwmqtt_pipe_read(&pipe.b, data, sizeof(data), &read, 1), LWMQTT_SUCCESS);
+  EXPECT_EQ(read, 5u);
+  EXPECT_EQ(clock.now, 1500u);
+}
+
+TEST(Pipe, Bandwidth) {
+  lwmqtt_pipe_clock_t clock = {0};
+  uint8_t buf[64];
+  lwmqtt_pipe_t pipe;
+  lwmqtt_pipe_init(&pipe, &clock, buf, sizeof(buf));
+  pipe.rings[0].options.bandwidth = 1000;
+
+  uint8_t data[10] = {0};
+  size_t sent = 0;
+  ASSERT_EQ(lwmqtt_pipe_write(&pipe.a, data, sizeof(data), &sent, 0), LWMQTT_SUCCESS);
+  ASSERT_EQ(lwmqtt_pipe_write(&pipe.a, data, sizeof(data), &sent, 0), LWMQTT_SUCCESS);
+  EXPECT_EQ(sent, 20u);
+
+  size_t read = 0;
+  ASSERT_EQ(lwmqtt_pipe_read(&pipe.b, data, sizeof(data), &read, 100), LWMQTT_SUCCESS);
+  EXPECT_EQ(read, 10u);
+  EXPECT_EQ(clock.now, 10000u);
+
+  ASSERT_EQ(lwmqtt_pipe_read(&pipe.b, data, sizeof(data), &read, 100), LWMQTT_SUCCESS);
+  EXPECT_EQ(read, 20u);
+  EXPECT_EQ(clock.now, 20000u);
+}
+
+TEST(Pipe, Faults) {
+  lwmqtt_pipe_clock_t clock = {0};
+  uint8_t buf[64];
+  lwmqtt_pipe_t pipe;
+  lwmqtt_pipe_init(&pipe, &clock, buf, sizeof(buf));
+  pipe.rings[0].options.max_write = 3;
+  pipe.rings[0].options.max_read = 2;
+  pipe.rings[0].options.fail_after = 5;
+
+  uint8_t data[8] = {0};
+  size_t sent = 0;
+  ASSERT_EQ(lwmqtt_pipe_write(&pipe.a, data, sizeof(data), &sent, 0), LWMQTT_SUCCESS);
+  EXPECT_EQ(sent, 3u);
+  ASSERT_EQ(lwmqtt_pipe_write(&pipe.a, data, sizeof(data), &sent, 0), LWMQTT_SUCCESS);
+  EXPECT_EQ(sent, 5u);
+  EXPECT_EQ(lwmqtt_pipe_write(&pipe.a, data, sizeof(data), &sent, 0), LWMQTT_NETWORK_FAILED_WRITE);
+
+  size_t read = 0;
+  for (int i = 0; i < 3; i++) {
+    ASSERT_EQ(lwmqtt_pipe_read(&pipe.b, data, sizeof(data), &read, 0), LWMQTT_SUCCESS);
+  }
+  EXPECT_EQ(read, 5u);
+  EXPECT_EQ(lwmqtt_pipe_read(&pipe.b, data, sizeof(data), &read, 0), LWMQTT_NETWORK_FAILED_READ);
+}
+
+TEST(Pipe, Timer) {
+  lwmqtt_pipe_clock_t clock = {0};
+  lwmqtt_pipe_timer_t timer;
+  lwmqtt_pipe_timer_init(&timer, &clock);
+
+  lwmqtt_pipe_timer_set(&timer, 100);
+  EXPECT_EQ(lwmqtt_pipe_timer_get(&timer), 100);
+
+  lwmqtt_pipe_clock_advance(&clock, 99500);
+  EXPECT_EQ(lwmqtt_pipe_timer_get(&timer), 0);
+
+  lwmqtt_pipe_clock_advance(&clock, 1500);
+  EXPECT_EQ(lwmqtt_pipe_timer_get(&timer), -1);
+}
+
+TEST(Pipe, KeepAlive) {
+  lwmqtt_pipe_clock_t clock = {0};
+  uint8_t buf[256];
+  lwmqtt_pipe_t pipe;
+  lwmqtt_pipe_init(&pipe, &clock, buf, sizeof(buf));
+  pipe.rings[0].options.latency = 20000;
+  pipe.rings[1].options.latency = 20000;
+
+  lwmqtt_pipe_timer_t timer1, timer2;
+  lwmqtt_pipe_timer_init(&timer1, &clock);
+  lwmqtt_pipe_timer_init(&timer2, &clock);
+
+  uint8_t write_buf[64], read_buf[64];
+  lwmqtt_client_t client;
+  lwmqtt_init(&client, write_buf, sizeof(write_buf), read_buf, sizeof(read_buf));
+  lwmqtt_set_network(&client, &pipe.a, lwmqtt_pipe_read, lwmqtt_pipe_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_pipe_timer_set, lwmqtt_pipe_timer_get);
+
+  // queue connack
+  uint8_t connack[4] = {0x20, 2, 0, 0};
+  size_t sent = 0;
+  ASSERT_EQ(lwmqtt_pipe_write(&pipe.b, connack, sizeof(connack), &sent, 0), LWMQTT_SUCCESS);
+
+  lwmqtt_options_t options = lwmqtt_default_options;
+  options.keep_alive = 60;
+  lwmqtt_return_code_t return_code;
+  ASSERT_EQ(lwmqtt_connect(&client, options, nullptr, &return_code, 1000), LWMQTT_SUCCESS);
+
+  // drain connect
+  uint8_t data[64];
+  size_t read = 0;
+  ASSERT_EQ(lwmqtt_pipe_read(&pipe.b, data, sizeof(data), &read, 1000), LWMQTT_SUCCESS);
+
+  // answer pings for a simulated day
+  int pings = 0;
+  while (clock.now < 24ull * 3600 * 1000000) {
+    lwmqtt_pipe_clock_advance(&clock, 1000000);
+    ASSERT_EQ(lwmqtt_keep_alive(&client, 1000), LWMQTT_SUCCESS);
+    if (!client.pong_pending) {
+      continue;
+    }
+
+    read = 0;
+    ASSERT_EQ(lwmqtt_pipe_read(&pipe.b, data, sizeof(data), &read, 1000), LWMQTT_SUCCESS);
+    ASSERT_EQ(read, 2u);
+    ASSERT_EQ(data[0], 0xC0);
+    pings++;
+
+    uint8_t pingresp[2] = {0xD0, 0};
+    ASSERT_EQ(lwmqtt_pipe_write(&pipe.b, pingresp, sizeof(pingresp), &sent, 0), LWMQTT_SUCCESS);
+    ASSERT_EQ(lwmqtt_yield(&client, 0, 1000), LWMQTT_SUCCESS);
+    ASSERT_FALSE(client.pong_pending);
+  }
+  EXPECT_EQ(pings, 24 * 60 - 1);
+
+  // stop answering
+  lwmqtt_err_t err = LWMQTT_SUCCESS;
+  while (err == LWMQTT_SUCCESS) {
+    lwmqtt_pipe_clock_advance(&clock, 1000000);
+    err = lwmqtt_keep_alive(&client, 1000);
+  }
+  EXPECT_EQ(err, LWMQTT_PONG_TIMEOUT);
+}
+
+TEST(Pipe, WouldBlock) {
+  lwmqtt_pipe_clock_t clock = {0};
+  uint8_t buf[64];
+  lwmqtt_pipe_t pipe;
+  lwmqtt_pipe_init(&pipe, &clock, buf, sizeof(buf));
+  pipe.rings[0].options.nonblocking = true;
+
+  lwmqtt_pipe_timer_t timer1, timer2;
+  lwmqtt_pipe_timer_init(&timer1, &clock);
+  lwmqtt_pipe_timer_init(&timer2, &clock);
+
+  uint8_t write_buf[64], read_buf[64];
+  lwmqtt_stats_t stats = {};
+  lwmqtt_client_t client;
+  lwmqtt_init(&client, write_buf, sizeof(write_buf), read_buf, sizeof(read_buf));
+  lwmqtt_set_network(&client, &pipe.a, lwmqtt_pipe_read, lwmqtt_pipe_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_pipe_timer_set, lwmqtt_pipe_timer_get);
+  lwmqtt_set_stats(&client, &stats);
+
+  // fill the ring partially with the first packet
+  uint8_t payload[19] = {0};
+  lwmqtt_message_t message = {LWMQTT_QOS0, false, payload, sizeof(payload)};
+  ASSERT_EQ(lwmqtt_publish(&client, lwmqtt_string("a"), message, 1000), LWMQTT_SUCCESS);
+  EXPECT_EQ(lwmqtt_publish(&client, lwmqtt_string("a"), message, 1000), LWMQTT_WOULD_BLOCK);
+  EXPECT_EQ(stats.blocked_writes, 1u);
+  EXPECT_EQ(stats.bytes_out, 32u);
+  EXPECT_EQ(stats.packets_out[3], 1u);
+
+  // commands are rejected without sending while the ring is still full
+  uint16_t last_packet_id = client.last_packet_id;
+  EXPECT_EQ(lwmqtt_publish(&client, lwmqtt_string("a"), message, 1000), LWMQTT_BUSY);
+  message.qos = LWMQTT_QOS1;
+  EXPECT_EQ(lwmqtt_publish(&client, lwmqtt_string("a"), message, 1000), LWMQTT_BUSY);
+  EXPECT_EQ(lwmqtt_subscribe_one(&client, lwmqtt_string("a"), LWMQTT_QOS0, 1000), LWMQTT_BUSY);
+  EXPECT_EQ(client.last_packet_id, last_packet_id);
+  message.qos = LWMQTT_QOS0;
+  EXPECT_EQ(lwmqtt_flush(&client, 1000), LWMQTT_WOULD_BLOCK);
+  EXPECT_EQ(lwmqtt_yield(&client, 0, 1000), LWMQTT_WOULD_BLOCK);
+  EXPECT_EQ(stats.bytes_out, 32u);
+  EXPECT_EQ(clock.now, 0u);
+
+  // drain the ring and complete the write
+  uint8_t data[64];
+  size_t read = 0;
+  ASSERT_EQ(lwmqtt_pipe_read(&pipe.b, data, sizeof(data), &read, 0), LWMQTT_SUCCESS);
+  ASSERT_EQ(read, 32u);
+  EXPECT_EQ(data[0], 0x30);
+  EXPECT_EQ(data[1], 22);
+  EXPECT_EQ(data[24], 0x30);
+  ASSERT_EQ(lwmqtt_flush(&client, 1000), LWMQTT_SUCCESS);
+  EXPECT_EQ(stats.bytes_out, 48u);
+  EXPECT_EQ(stats.packets_out[3], 2u);
+
+  read = 0;
+  ASSERT_EQ(lwmqtt_pipe_read(&pipe.b, data, sizeof(data), &read, 0), LWMQTT_SUCCESS);
+  ASSERT_EQ(read, 16u);
+
+  // a blocked ping is still marked as pending
+  uint8_t big_payload[26] = {0};
+  lwmqtt_message_t big_message = {LWMQTT_QOS0, false, big_payload, sizeof(big_payload)};
+  client.keep_alive_interval = 1000;
+  ASSERT_EQ(lwmqtt_publish(&client, lwmqtt_string("a"), big_message, 1000), LWMQTT_SUCCESS);
+  lwmqtt_pipe_clock_advance(&clock, 1000000);
+  EXPECT_EQ(lwmqtt_keep_alive(&client, 1000), LWMQTT_WOULD_BLOCK);
+  EXPECT_TRUE(client.pong_pending);
+
+  read = 0;
+  ASSERT_EQ(lwmqtt_pipe_read(&pipe.b, data, sizeof(data), &read, 0), LWMQTT_SUCCESS);
+  ASSERT_EQ(read, 32u);
+  EXPECT_EQ(data[31], 0xC0);
+  ASSERT_EQ(lwmqtt_flush(&client, 1000), LWMQTT_SUCCESS);
+  EXPECT_EQ(stats.packets_out[12], 1u);
+}
+
+TEST(Pipe, DirectPayload) {
+  lwmqtt_pipe_clock_t clock = {0};
+  uint8_t buf[64];
+  lwmqtt_pipe_t pipe;
+  lwmqtt_pipe_init(&pipe, &clock, buf, sizeof(buf));
+  pipe.rings[0].options.nonblocking = true;
+
+  lwmqtt_pipe_timer_t timer1, timer2;
+  lwmqtt_pipe_timer_init(&timer1, &clock);
+  lwmqtt_pipe_timer_init(&timer2, &clock);
+
+  uint8_t write_buf[16], read_buf[16];
+  lwmqtt_stats_t stats = {};
+  lwmqtt_client_t client;
+  lwmqtt_init(&client, write_buf, sizeof(write_buf), read_buf, sizeof(read_buf));
+  lwmqtt_set_network(&client, &pipe.a, lwmqtt_pipe_read, lwmqtt_pipe_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_pipe_timer_set, lwmqtt_pipe_timer_get);
+  lwmqtt_set_stats(&client, &stats);
+  lwmqtt_set_direct_payload(&client, 8, nullptr);
+
+  // fill the ring exactly with a packet that exceeds the write buffer
+  uint8_t payload[40];
+  for (size_t i = 0; i < sizeof(payload); i++) {
+    payload[i] = (uint8_t)i;
+  }
+  lwmqtt_message_t message = {LWMQTT_QOS0, false, payload, 27};
+  ASSERT_EQ(lwmqtt_publish(&client, lwmqtt_string("a"), message, 1000), LWMQTT_SUCCESS);
+  EXPECT_EQ(stats.bytes_out, 32u);
+  EXPECT_EQ(stats.packets_out[3], 1u);
+
+  // the payload waits behind the blocked header
+  message.payload_len = sizeof(payload);
+  EXPECT_EQ(lwmqtt_publish(&client, lwmqtt_string("a"), message, 1000), LWMQTT_WOULD_BLOCK);
+  EXPECT_EQ(stats.bytes_out, 32u);
+
+  uint8_t data[64];
+  size_t read = 0;
+  ASSERT_EQ(lwmqtt_pipe_read(&pipe.b, data, sizeof(data), &read, 0), LWMQTT_SUCCESS);
+  ASSERT_EQ(read, 32u);
+  EXPECT_EQ(data[1], 30);
+  EXPECT_EQ(data[31], 26);
+
+  // the header and the start of the payload fit
+  EXPECT_EQ(lwmqtt_flush(&client, 1000), LWMQTT_WOULD_BLOCK);
+  EXPECT_EQ(stats.packets_out[3], 2u);
+  read = 0;
+  ASSERT_EQ(lwmqtt_pipe_read(&pipe.b, data, sizeof(data), &read, 0), LWMQTT_SUCCESS);
+  ASSERT_EQ(read, 32u);
+  EXPECT_EQ(data[0], 0x30);
+  EXPECT_EQ(data[1], 43);
+  EXPECT_EQ(data[4], 'a');
+  EXPECT_EQ(data[5], 0);
+  EXPECT_EQ(data[31], 26);
+
+  // the rest of the payload completes the packet
+  ASSERT_EQ(lwmqtt_flush(&client, 1000), LWMQTT_SUCCESS);
+  read = 0;
+  ASSERT_EQ(lwmqtt_pipe_read(&pipe.b, data, sizeof(data), &read, 0), LWMQTT_SUCCESS);
+  ASSERT_EQ(read, 13u);
+  EXPECT_EQ(data[0], 27);
+  EXPECT_EQ(data[12], 39);
+  EXPECT_EQ(stats.bytes_out, 77u);
+  EXPECT_EQ(stats.packets_out[3], 2u);
+}
+
+TEST(Pipe, LingerReconnect) {
+  lwmqtt_pipe_clock_t clock = {0};
+  uint8_t buf[256];
+  lwmqtt_pipe_t pipe;
+  lwmqtt_pipe_init(&pipe, &clock, buf, sizeof(buf));
+
+  lwmqtt_pipe_timer_t timer1, timer2, timer3;
+  lwmqtt_pipe_timer_init(&timer1, &clock);
+  lwmqtt_pipe_timer_init(&timer2, &clock);
+  lwmqtt_pipe_timer_init(&timer3, &clock);
+
+  uint8_t write_buf[64], read_buf[64], linger_buf[64];
+  lwmqtt_client_t client;
+  lwmqtt_init(&client, write_buf, sizeof(write_buf), read_buf, sizeof(read_buf));
+  lwmqtt_set_network(&client, &pipe.a, lwmqtt_pipe_read, lwmqtt_pipe_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_pipe_timer_set, lwmqtt_pipe_timer_get);
+  lwmqtt_set_linger(&client, linger_buf, sizeof(linger_buf), &timer3, 60000);
+
+  // leave a packet of the previous connection in the linger buffer
+  uint8_t payload[5] = {0};
+  lwmqtt_message_t message = {LWMQTT_QOS0, false, payload, sizeof(payload)};
+  ASSERT_EQ(lwmqtt_publish(&client, lwmqtt_string("a"), message, 1000), LWMQTT_SUCCESS);
+  EXPECT_EQ(client.linger_len, 10u);
+
+  // connect must be the first packet of the new connection
+  uint8_t connack[4] = {0x20, 2, 0, 0};
+  size_t sent = 0;
+  ASSERT_EQ(lwmqtt_pipe_write(&pipe.b, connack, sizeof(connack), &sent, 0), LWMQTT_SUCCESS);
+  lwmqtt_return_code_t return_code;
+  ASSERT_EQ(lwmqtt_connect(&client, lwmqtt_default_options, nullptr, &return_code, 1000), LWMQTT_SUCCESS);
+  EXPECT_EQ(client.linger_len, 0u);
+
+  uint8_t data[64];
+  size_t read = 0;
+  ASSERT_EQ(lwmqtt_pipe_read(&pipe.b, data, sizeof(data), &read, 0), LWMQTT_SUCCESS);
+  ASSERT_GT(read, 2u);
+  EXPECT_EQ(data[0], 0x10);
+  EXPECT_EQ(read, 2u + data[1]);
+}
+
+TEST(Pipe, Errors) {
+  lwmqtt_pipe_clock_t clock = {0};
+  uint8_t buf[256];
+  lwmqtt_pipe_t pipe;
+  lwmqtt_pipe_init(&pipe, &clock, buf, sizeof(buf));
+
+  lwmqtt_pipe_timer_t timer1, timer2;
+  lwmqtt_pipe_timer_init(&timer1, &clock);
+  lwmqtt_pipe_timer_init(&timer2, &clock);
+
+  uint8_t write_buf[64], read_buf[64];
+  lwmqtt_client_t client;
+  lwmqtt_init(&client, write_buf, sizeof(write_buf), read_buf, sizeof(read_buf));
+  lwmqtt_set_network(&client, &pipe.a, lwmqtt_pipe_read, lwmqtt_pipe_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_pipe_timer_set, lwmqtt_pipe_timer_get);
+
+  lwmqtt_stats_t stats = {};
+  lwmqtt_set_stats(&client, &stats);
+
+  // denied connection
+  uint8_t denied[4] = {0x20, 2, 0, 5};
+  size_t sent = 0;
+  ASSERT_EQ(lwmqtt_pipe_write(&pipe.b, denied, sizeof(denied), &sent, 0), LWMQTT_SUCCESS);
+  lwmqtt_return_code_t return_code;
+  ASSERT_EQ(lwmqtt_connect(&client, lwmqtt_default_options, nullptr, &return_code, 1000), LWMQTT_CONNECTION_DENIED);
+  EXPECT_EQ(stats.errors[-LWMQTT_CONNECTION_DENIED], 1u);
+
+  // encode failure
+  char topic[80];
+  memset(topic, 'a', sizeof(topic) - 1);
+  topic[sizeof(topic) - 1] = 0;
+  ASSERT_EQ(lwmqtt_subscribe_one(&client, lwmqtt_string(topic), LWMQTT_QOS0, 1000), LWMQTT_BUFFER_TOO_SHORT);
+  EXPECT_EQ(stats.errors[-LWMQTT_BUFFER_TOO_SHORT], 1u);
+
+  // failed subscription
+  uint8_t suback[5] = {0x90, 3, 0, 1, 0x80};
+  ASSERT_EQ(lwmqtt_pipe_write(&pipe.b, suback, sizeof(suback), &sent, 0), LWMQTT_SUCCESS);
+  ASSERT_EQ(lwmqtt_subscribe_one(&client, lwmqtt_string("a"), LWMQTT_QOS0, 1000), LWMQTT_FAILED_SUBSCRIPTION);
+  EXPECT_EQ(stats.errors[-LWMQTT_FAILED_SUBSCRIPTION], 1u);
+
+  // skipped oversize message in a batch that misses an ack
+  uint8_t payload[80] = {0};
+  lwmqtt_string_t topics[2] = {lwmqtt_string("a"), lwmqtt_string("a")};
+  lwmqtt_message_t messages[2] = {{LWMQTT_QOS0, false, payload, sizeof(payload)}, {LWMQTT_QOS1, false, payload, 1}};
+  lwmqtt_err_t results[2];
+  ASSERT_EQ(lwmqtt_publish_batch(&client, 2, topics, messages, results, 1000), LWMQTT_MISSING_OR_WRONG_PACKET);
+  EXPECT_EQ(results[0], LWMQTT_BUFFER_TOO_SHORT);
+  EXPECT_EQ(results[1], LWMQTT_MISSING_OR_WRONG_PACKET);
+  EXPECT_EQ(stats.errors[-LWMQTT_BUFFER_TOO_SHORT], 2u);
+  EXPECT_EQ(stats.errors[-LWMQTT_MISSING_OR_WRONG_PACKET], 1u);
+
+  // every error is counted once
+  uint64_t total = 0;
+  for (uint64_t count : stats.errors) {
+    total += count;
+  }
+  EXPECT_EQ(total, 5u);
+}
+
+static bool block_puback = false;
+
+static lwmqtt_err_t blocking_write(void *ref, uint8_t *buf, size_t len, size_t *sent, uint32_t timeout) {
+  // block the first attempt to write a puback
+  if (block_puback && buf[0] >> 4 == LWMQTT_PUBACK_PACKET) {
+    block_puback = false;
+    return LWMQTT_WOULD_BLOCK;
+  }
+
+  return lwmqtt_pipe_write(ref, buf, len, sent, timeout);
+}
+
+TEST(Pipe, BlockedReply) {
+  lwmqtt_pipe_clock_t clock = {0};
+  uint8_t buf[256];
+  lwmqtt_pipe_t pipe;
+  lwmqtt_pipe_init(&pipe, &clock, buf, sizeof(buf));
+
+  lwmqtt_pipe_timer_t timer1, timer2;
+  lwmqtt_pipe_timer_init(&timer1, &clock);
+  lwmqtt_pipe_timer_init(&timer2, &clock);
+
+  uint8_t write_buf[64], read_buf[64];
+  lwmqtt_client_t client;
+  lwmqtt_init(&client, write_buf, sizeof(write_buf), read_buf, sizeof(read_buf));
+  lwmqtt_set_network(&client, &pipe.a, lwmqtt_pipe_read, blocking_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_pipe_timer_set, lwmqtt_pipe_timer_get);
+
+  // a qos 1 publish arrives before the suback
+  uint8_t incoming[13] = {0x32, 6, 0, 1, 'a', 0, 7, 'x', 0x90, 3, 0, 1, 0};
+  size_t sent = 0;
+  ASSERT_EQ(lwmqtt_pipe_write(&pipe.b, incoming, sizeof(incoming), &sent, 0), LWMQTT_SUCCESS);
+
+  // the blocked puback does not fail the sent subscribe
+  block_puback = true;
+  ASSERT_EQ(lwmqtt_subscribe_one(&client, lwmqtt_string("a"), LWMQTT_QOS0, 1000), LWMQTT_SUCCESS);
+  EXPECT_FALSE(block_puback);
+
+  uint8_t data[64];
+  size_t read = 0;
+  ASSERT_EQ(lwmqtt_pipe_read(&pipe.b, data, sizeof(data), &read, 0), LWMQTT_SUCCESS);
+  ASSERT_EQ(read, 8u + 4u);
+  EXPECT_EQ(data[0], 0x82);
+  EXPECT_EQ(data[8], 0x40);
+}
+
+static uint16_t acked_ids[8];
+static int acked_count = 0;
+
+static void ack_arrived(lwmqtt_client_t *, void *, lwmqtt_response_t response) {
+  if (response.packet_type == LWMQTT_PUBACK_PACKET && acked_count < 8) {
+    acked_ids[acked_count++] = response.packet_id;
+  }
+}
+
+TEST(Pipe, BatchWouldBlock) {
+  lwmqtt_pipe_clock_t clock = {0};
+  uint8_t buf[64];
+  lwmqtt_pipe_t pipe;
+  lwmqtt_pipe_init(&pipe, &clock, buf, sizeof(buf));
+  pipe.rings[0].options.nonblocking = true;
+
+  lwmqtt_pipe_timer_t timer1, timer2;
+  lwmqtt_pipe_timer_init(&timer1, &clock);
+  lwmqtt_pipe_timer_init(&timer2, &clock);
+
+  uint8_t write_buf[32], read_buf[64];
+  lwmqtt_stats_t stats = {};
+  lwmqtt_client_t client;
+  lwmqtt_init(&client, write_buf, sizeof(write_buf), read_buf, sizeof(read_buf));
+  lwmqtt_set_network(&client, &pipe.a, lwmqtt_pipe_read, lwmqtt_pipe_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_pipe_timer_set, lwmqtt_pipe_timer_get);
+  lwmqtt_set_response_callback(&client, nullptr, ack_arrived);
+  lwmqtt_set_stats(&client, &stats);
+  acked_count = 0;
+
+  // the acks of the first chunk are already available
+  uint8_t acks[8] = {0x40, 2, 0, 2, 0x40, 2, 0, 3};
+  size_t sent = 0;
+  ASSERT_EQ(lwmqtt_pipe_write(&pipe.b, acks, sizeof(acks), &sent, 0), LWMQTT_SUCCESS);
+
+  // the first chunk fills the ring and the second one blocks
+  uint8_t payload[8] = {0};
+  lwmqtt_string_t topics[6];
+  lwmqtt_message_t messages[6];
+  for (int i = 0; i < 6; i++) {
+    topics[i] = lwmqtt_string("a");
+    messages[i] = {LWMQTT_QOS1, false, payload, sizeof(payload)};
+  }
+  lwmqtt_err_t results[6];
+  ASSERT_EQ(lwmqtt_publish_batch(&client, 6, topics, messages, results, 1000), LWMQTT_WOULD_BLOCK);
+  EXPECT_EQ(results[0], LWMQTT_SUCCESS);
+  EXPECT_EQ(results[1], LWMQTT_SUCCESS);
+  EXPECT_EQ(results[2], LWMQTT_WOULD_BLOCK);
+  EXPECT_EQ(results[3], LWMQTT_WOULD_BLOCK);
+  EXPECT_EQ(results[4], LWMQTT_BUSY);
+  EXPECT_EQ(results[5], LWMQTT_BUSY);
+  EXPECT_EQ(client.last_packet_id, 5);
+  EXPECT_EQ(stats.packets_out[3], 2u);
+  ASSERT_EQ(acked_count, 2);
+  for (uint64_t count : stats.errors) {
+    EXPECT_EQ(count, 0u);
+  }
+
+  // drain the ring and complete the blocked chunk
+  uint8_t data[64];
+  size_t read = 0;
+  ASSERT_EQ(lwmqtt_pipe_read(&pipe.b, data, sizeof(data), &read, 0), LWMQTT_SUCCESS);
+  ASSERT_EQ(read, 32u);
+  ASSERT_EQ(lwmqtt_flush(&client, 1000), LWMQTT_SUCCESS);
+  EXPECT_EQ(stats.packets_out[3], 4u);
+
+  ASSERT_EQ(lwmqtt_pipe_read(&pipe.b, data + read, sizeof(data) - read, &read, 0), LWMQTT_SUCCESS);
+  ASSERT_EQ(read, 60u);
+  EXPECT_EQ(data[30], 0x32);
+  EXPECT_EQ(data[36], 4);
+  EXPECT_EQ(data[45], 0x32);
+  EXPECT_EQ(data[51], 5);
+
+  // the acks of the blocked chunk are reported to the response callback
+  uint8_t later_acks[8] = {0x40, 2, 0, 4, 0x40, 2, 0, 5};
+  ASSERT_EQ(lwmqtt_pipe_write(&pipe.b, later_acks, sizeof(later_acks), &sent, 0), LWMQTT_SUCCESS);
+  ASSERT_EQ(lwmqtt_yield(&client, sizeof(later_acks), 1000), LWMQTT_SUCCESS);
+  ASSERT_EQ(acked_count, 4);
+  EXPECT_EQ(acked_ids[2], 4);
+  EXPECT_EQ(acked_ids[3], 5);
+}
+
+TEST(Pipe, RecordPacketIds) {
+  lwmqtt_pipe_clock_t clock = {0};
+  uint8_t buf[256];
+  lwmqtt_pipe_t pipe;
+  lwmqtt_pipe_init(&pipe, &clock, buf, sizeof(buf));
+
+  lwmqtt_pipe_timer_t timer1, timer2;
+  lwmqtt_pipe_timer_init(&timer1, &clock);
+  lwmqtt_pipe_timer_init(&timer2, &clock);
+
+  uint8_t write_buf[64], read_buf[64];
+  lwmqtt_client_t client;
+  lwmqtt_init(&client, write_buf, sizeof(write_buf), read_buf, sizeof(read_buf));
+  lwmqtt_set_network(&client, &pipe.a, lwmqtt_pipe_read, lwmqtt_pipe_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_pipe_timer_set, lwmqtt_pipe_timer_get);
+
+  lwmqtt_event_t events[8];
+  lwmqtt_recorder_t recorder;
+  lwmqtt_recorder_init(&recorder, events, 8, nullptr, nullptr);
+  lwmqtt_set_recorder(&client, &recorder);
+
+  // a qos 0 publish, an ack and a qos 1 publish whose topic exceeds the packet
+  uint8_t incoming[16] = {0x30, 4, 0, 1, 'a', 'x', 0x40, 2, 0, 7, 0x32, 4, 0, 9, 'a', 0};
+  size_t sent = 0;
+  ASSERT_EQ(lwmqtt_pipe_write(&pipe.b, incoming, sizeof(incoming), &sent, 0), LWMQTT_SUCCESS);
+  ASSERT_EQ(lwmqtt_yield(&client, 6, 1000), LWMQTT_SUCCESS);
+  ASSERT_EQ(lwmqtt_yield(&client, 4, 1000), LWMQTT_SUCCESS);
+  lwmqtt_yield(&client, 6, 1000);
+
+  // only complete packet ids are recorded
+  lwmqtt_event_t dump[8];
+  ASSERT_GE(lwmqtt_recorder_dump(&recorder, dump, 8), 3u);
+  EXPECT_EQ(dump[0].packet_type, LWMQTT_PUBLISH_PACKET);
+  EXPECT_EQ(dump[0].packet_id, 0);
+  EXPECT_EQ(dump[1].packet_type, LWMQTT_PUBACK_PACKET);
+  EXPECT_EQ(dump[1].packet_id, 7);
+  EXPECT_EQ(dump[2].packet_type, LWMQTT_PUBLISH_PACKET);
+  EXPECT_EQ(dump[2].packet_id, 0);
+}
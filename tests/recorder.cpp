@@ -0,0 +1,41 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <lwmqtt/recorder.h>
+}
+
+TEST(Recorder, Dump) {
+  lwmqtt_event_t events[4];
+  lwmqtt_recorder_t recorder;
+  lwmqtt_recorder_init(&recorder, events, 4, nullptr, nullptr);
+
+  lwmqtt_event_t out[8];
+  EXPECT_EQ(lwmqtt_recorder_dump(&recorder, out, 8), 0u);
+
+  for (uint32_t i = 0; i < 6; i++) {
+    events[i & recorder.mask] = {i, i * 10, (uint16_t)i, LWMQTT_EVENT_IN, 3, LWMQTT_SUCCESS};
+    recorder.head++;
+  }
+
+  EXPECT_EQ(lwmqtt_recorder_dump(&recorder, out, 8), 4u);
+  for (uint32_t i = 0; i < 4; i++) {
+    EXPECT_EQ(out[i].time, i + 2);
+    EXPECT_EQ(out[i].len, (i + 2) * 10);
+  }
+
+  EXPECT_EQ(lwmqtt_recorder_dump(&recorder, out, 2), 2u);
+  EXPECT_EQ(out[0].time, 4u);
+  EXPECT_EQ(out[1].time, 5u);
+}
+
+TEST(Recorder, Format) {
+  char line[64];
+
+  lwmqtt_event_t packet = {42, 300, 7, LWMQTT_EVENT_OUT, 3, LWMQTT_SUCCESS};
+  lwmqtt_event_format(&packet, line, sizeof(line));
+  EXPECT_STREQ(line, "        42 out PUBLISH id=7 len=300");
+
+  lwmqtt_event_t error = {43, 0, 0, LWMQTT_EVENT_ERROR, 13, LWMQTT_PONG_TIMEOUT};
+  lwmqtt_event_format(&error, line, sizeof(line));
+  EXPECT_STREQ(line, "        43 err -13 after PINGRESP");
+}
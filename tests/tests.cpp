@@ -1,6 +1,23 @@
 #include <gtest/gtest.h>
 
+extern "C" {
+#include "broker.h"
+}
+
+mock_broker_t *broker = nullptr;
+
+class BrokerEnvironment : public ::testing::Environment {
+ public:
+  void SetUp() override {
+    broker = mock_broker_start(mock_broker_default_options);
+    ASSERT_NE(broker, nullptr);
+  }
+
+  void TearDown() override { mock_broker_stop(broker); }
+};
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
+  ::testing::AddGlobalTestEnvironment(new BrokerEnvironment);
   return RUN_ALL_TESTS();
 }
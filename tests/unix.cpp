@@ -0,0 +1,431 @@
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+extern "C" {
+#include <lwmqtt/unix.h>
+
+#include "broker.h"
+}
+
+extern mock_broker_t *broker;
+
+TEST(Unix, Connect) {
+  lwmqtt_unix_network_t network{};
+  ASSERT_EQ(lwmqtt_unix_network_connect_timeout(&network, (char *)"localhost", mock_broker_port(broker), 1000),
+            LWMQTT_SUCCESS);
+
+  // the socket must be blocking again
+  size_t sent = 0;
+  uint8_t pingreq[2] = {0xC0, 0};
+  ASSERT_EQ(lwmqtt_unix_network_write(&network, pingreq, sizeof(pingreq), &sent, 1000), LWMQTT_SUCCESS);
+  EXPECT_EQ(sent, 2u);
+
+  lwmqtt_unix_network_disconnect(&network);
+}
+
+TEST(Unix, Refused) {
+  // get a free port
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(bind(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+  socklen_t addr_len = sizeof(addr);
+  getsockname(fd, (struct sockaddr *)&addr, &addr_len);
+  close(fd);
+
+  lwmqtt_unix_network_t network{};
+  EXPECT_EQ(lwmqtt_unix_network_connect_timeout(&network, (char *)"localhost", ntohs(addr.sin_port), 1000),
+            LWMQTT_NETWORK_FAILED_CONNECT);
+  EXPECT_EQ(lwmqtt_unix_network_connect(&network, (char *)"invalid.invalid", 1883), LWMQTT_NETWORK_FAILED_CONNECT);
+}
+
+TEST(Unix, Timeout) {
+  // create listener that does not accept any further connections
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(bind(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+  ASSERT_EQ(listen(fd, 0), 0);
+  socklen_t addr_len = sizeof(addr);
+  getsockname(fd, (struct sockaddr *)&addr, &addr_len);
+
+  // fill the backlog
+  lwmqtt_unix_network_t fillers[4] = {};
+  for (auto &filler : fillers) {
+    lwmqtt_unix_network_connect_timeout(&filler, (char *)"127.0.0.1", ntohs(addr.sin_port), 100);
+  }
+
+  uint64_t start = lwmqtt_unix_clock_get(nullptr);
+  lwmqtt_unix_network_t network{};
+  EXPECT_EQ(lwmqtt_unix_network_connect_timeout(&network, (char *)"127.0.0.1", ntohs(addr.sin_port), 300),
+            LWMQTT_NETWORK_TIMEOUT);
+  uint64_t elapsed = lwmqtt_unix_clock_get(nullptr) - start;
+  EXPECT_GE(elapsed, 300000u);
+  EXPECT_LT(elapsed, 1000000u);
+
+  for (auto &filler : fillers) {
+    lwmqtt_unix_network_disconnect(&filler);
+  }
+  close(fd);
+}
+
+static void fill_send_buffer(bool nonblocking) {
+  // create listener that never reads
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(bind(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+  ASSERT_EQ(listen(fd, 1), 0);
+  socklen_t addr_len = sizeof(addr);
+  getsockname(fd, (struct sockaddr *)&addr, &addr_len);
+
+  lwmqtt_unix_options_t options = lwmqtt_unix_default_options;
+  options.send_buffer = 4096;
+  options.receive_buffer = 4096;
+  options.nonblocking = nonblocking;
+  lwmqtt_unix_network_t network{};
+  ASSERT_EQ(lwmqtt_unix_network_connect_options(&network, (char *)"127.0.0.1", ntohs(addr.sin_port), 1000, &options),
+            LWMQTT_SUCCESS);
+  EXPECT_EQ(network.nonblocking, nonblocking);
+
+  // write until the buffers are full
+  static uint8_t data[65536];
+  lwmqtt_err_t err = LWMQTT_SUCCESS;
+  for (int i = 0; i < 100 && err == LWMQTT_SUCCESS; i++) {
+    size_t sent = 0;
+    err = lwmqtt_unix_network_write(&network, data, sizeof(data), &sent, 10);
+    if (err == LWMQTT_SUCCESS && sent == 0) {
+      break;
+    }
+  }
+
+  // only non-blocking sockets report a full buffer, blocking sockets time out without progress
+  EXPECT_EQ(err, nonblocking ? LWMQTT_WOULD_BLOCK : LWMQTT_SUCCESS);
+
+  lwmqtt_unix_network_disconnect(&network);
+  close(fd);
+}
+
+TEST(Unix, NonBlocking) {
+  fill_send_buffer(false);
+  fill_send_buffer(true);
+}
+
+TEST(Unix, Options) {
+  lwmqtt_unix_options_t options = lwmqtt_unix_default_options;
+  options.no_delay = true;
+  options.send_buffer = 65536;
+  options.quick_ack = true;
+  options.user_timeout = 5000;
+  options.keep_alive_idle = 30;
+  options.keep_alive_interval = 5;
+  options.keep_alive_count = 3;
+
+  lwmqtt_unix_network_t network{};
+  ASSERT_EQ(lwmqtt_unix_network_connect_options(&network, (char *)"127.0.0.1", mock_broker_port(broker), 1000,
+                                                &options),
+            LWMQTT_SUCCESS);
+
+  int value = 0;
+  socklen_t len = sizeof(value);
+  ASSERT_EQ(getsockopt(network.socket, IPPROTO_TCP, TCP_NODELAY, &value, &len), 0);
+  EXPECT_NE(value, 0);
+  ASSERT_EQ(getsockopt(network.socket, SOL_SOCKET, SO_KEEPALIVE, &value, &len), 0);
+  EXPECT_NE(value, 0);
+  ASSERT_EQ(getsockopt(network.socket, SOL_SOCKET, SO_SNDBUF, &value, &len), 0);
+  EXPECT_GE(value, 65536);
+#ifdef TCP_KEEPIDLE
+  ASSERT_EQ(getsockopt(network.socket, IPPROTO_TCP, TCP_KEEPIDLE, &value, &len), 0);
+  EXPECT_EQ(value, 30);
+#endif
+#ifdef TCP_USER_TIMEOUT
+  ASSERT_EQ(getsockopt(network.socket, IPPROTO_TCP, TCP_USER_TIMEOUT, &value, &len), 0);
+  EXPECT_EQ(value, 5000);
+#endif
+
+  lwmqtt_unix_network_disconnect(&network);
+}
+
+TEST(Unix, FastOpen) {
+  // create listener with fast open
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(bind(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+  int qlen = 16;
+  bool server_support = setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen)) == 0;
+  ASSERT_EQ(listen(fd, 16), 0);
+  socklen_t addr_len = sizeof(addr);
+  getsockname(fd, (struct sockaddr *)&addr, &addr_len);
+
+  lwmqtt_unix_options_t options = lwmqtt_unix_default_options;
+  options.fast_open = true;
+
+  // the first connection fetches the cookie and the second carries data in the syn if supported
+  bool syn_data = false;
+  for (int i = 0; i < 2; i++) {
+    lwmqtt_unix_network_t network{};
+    ASSERT_EQ(lwmqtt_unix_network_connect_options(&network, (char *)"127.0.0.1", ntohs(addr.sin_port), 1000, &options),
+              LWMQTT_SUCCESS);
+
+    size_t sent = 0;
+    uint8_t pingreq[2] = {0xC0, 0};
+    ASSERT_EQ(lwmqtt_unix_network_write(&network, pingreq, sizeof(pingreq), &sent, 1000), LWMQTT_SUCCESS);
+    ASSERT_EQ(sent, 2u);
+
+    int conn = accept(fd, nullptr, nullptr);
+    ASSERT_GE(conn, 0);
+    uint8_t data[2];
+    ASSERT_EQ(read(conn, data, sizeof(data)), 2);
+    EXPECT_EQ(data[0], 0xC0);
+    close(conn);
+
+#ifdef TCPI_OPT_SYN_DATA
+    struct tcp_info info = {};
+    socklen_t info_len = sizeof(info);
+    getsockopt(network.socket, IPPROTO_TCP, TCP_INFO, &info, &info_len);
+    syn_data = (info.tcpi_options & TCPI_OPT_SYN_DATA) != 0;
+#endif
+
+    lwmqtt_unix_network_disconnect(&network);
+  }
+
+  // the fallback must work regardless, the data is only sent with the syn if the kernel enables both sides
+  int sysctl = 0;
+  FILE *file = fopen("/proc/sys/net/ipv4/tcp_fastopen", "r");
+  if (file != nullptr) {
+    if (fscanf(file, "%d", &sysctl) != 1) {
+      sysctl = 0;
+    }
+    fclose(file);
+  }
+  if (server_support && (sysctl & 3) == 3) {
+    EXPECT_TRUE(syn_data);
+  }
+
+  close(fd);
+}
+
+TEST(Unix, FastOpenNonBlocking) {
+  // create listener with fast open
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(bind(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+  int qlen = 16;
+  setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen));
+  ASSERT_EQ(listen(fd, 16), 0);
+  socklen_t addr_len = sizeof(addr);
+  getsockname(fd, (struct sockaddr *)&addr, &addr_len);
+
+  lwmqtt_unix_options_t options = lwmqtt_unix_default_options;
+  options.fast_open = true;
+  options.nonblocking = true;
+
+  // the first write of each connection may find the handshake in progress, the first one also has no cookie yet
+  for (int i = 0; i < 2; i++) {
+    lwmqtt_unix_network_t network{};
+    ASSERT_EQ(lwmqtt_unix_network_connect_options(&network, (char *)"127.0.0.1", ntohs(addr.sin_port), 1000, &options),
+              LWMQTT_SUCCESS);
+
+    // retry the write while it would block
+    size_t sent = 0;
+    uint8_t pingreq[2] = {0xC0, 0};
+    lwmqtt_err_t err = LWMQTT_WOULD_BLOCK;
+    for (int j = 0; j < 1000 && sent < sizeof(pingreq); j++) {
+      err = lwmqtt_unix_network_write(&network, pingreq + sent, sizeof(pingreq) - sent, &sent, 1000);
+      if (err == LWMQTT_WOULD_BLOCK) {
+        usleep(1000);
+      } else if (err != LWMQTT_SUCCESS) {
+        break;
+      }
+    }
+    ASSERT_EQ(err, LWMQTT_SUCCESS);
+    ASSERT_EQ(sent, 2u);
+
+    int conn = accept(fd, nullptr, nullptr);
+    ASSERT_GE(conn, 0);
+    uint8_t data[2];
+    ASSERT_EQ(read(conn, data, sizeof(data)), 2);
+    EXPECT_EQ(data[0], 0xC0);
+    close(conn);
+
+    lwmqtt_unix_network_disconnect(&network);
+  }
+
+  close(fd);
+}
+
+TEST(Unix, Resolver) {
+  lwmqtt_unix_resolver_entry_t entries[2];
+  lwmqtt_unix_resolver_t resolver;
+  lwmqtt_unix_resolver_init(&resolver, entries, 2, 60000);
+
+  // the second lookup is served from the cache
+  lwmqtt_unix_addresses_t addresses;
+  ASSERT_EQ(lwmqtt_unix_resolve(&resolver, "localhost", mock_broker_port(broker), &addresses), LWMQTT_SUCCESS);
+  ASSERT_EQ(lwmqtt_unix_resolve(&resolver, "localhost", mock_broker_port(broker), &addresses), LWMQTT_SUCCESS);
+  EXPECT_GE(addresses.count, 1u);
+  EXPECT_EQ(resolver.hits, 1u);
+  EXPECT_EQ(resolver.misses, 1u);
+
+  // many networks connect with the cached addresses
+  lwmqtt_unix_network_t networks[4] = {};
+  for (auto &network : networks) {
+    ASSERT_EQ(lwmqtt_unix_network_connect_addresses(&network, &addresses, 1000, nullptr), LWMQTT_SUCCESS);
+  }
+  for (auto &network : networks) {
+    lwmqtt_unix_network_disconnect(&network);
+  }
+
+  // other ports and hosts are separate entries and replace the oldest one
+  ASSERT_EQ(lwmqtt_unix_resolve(&resolver, "localhost", 1883, &addresses), LWMQTT_SUCCESS);
+  ASSERT_EQ(lwmqtt_unix_resolve(&resolver, "127.0.0.1", 1883, &addresses), LWMQTT_SUCCESS);
+  EXPECT_EQ(addresses.count, 1u);
+  EXPECT_EQ(resolver.misses, 3u);
+  ASSERT_EQ(lwmqtt_unix_resolve(&resolver, "localhost", mock_broker_port(broker), &addresses), LWMQTT_SUCCESS);
+  EXPECT_EQ(resolver.misses, 4u);
+
+  // connects use the cache when set in the options
+  lwmqtt_unix_options_t options = lwmqtt_unix_default_options;
+  options.resolver = &resolver;
+  lwmqtt_unix_network_t network{};
+  ASSERT_EQ(lwmqtt_unix_network_connect_options(&network, (char *)"localhost", mock_broker_port(broker), 1000,
+                                                &options),
+            LWMQTT_SUCCESS);
+  EXPECT_EQ(resolver.hits, 2u);
+  lwmqtt_unix_network_disconnect(&network);
+
+  lwmqtt_unix_resolver_destroy(&resolver);
+}
+
+TEST(Unix, ResolverExpiry) {
+  lwmqtt_unix_resolver_entry_t entries[1];
+  lwmqtt_unix_resolver_t resolver;
+  lwmqtt_unix_resolver_init(&resolver, entries, 1, 1);
+
+  lwmqtt_unix_addresses_t addresses;
+  ASSERT_EQ(lwmqtt_unix_resolve(&resolver, "127.0.0.1", 1883, &addresses), LWMQTT_SUCCESS);
+  usleep(2000);
+  ASSERT_EQ(lwmqtt_unix_resolve(&resolver, "127.0.0.1", 1883, &addresses), LWMQTT_SUCCESS);
+  EXPECT_EQ(resolver.hits, 0u);
+  EXPECT_EQ(resolver.misses, 2u);
+
+  // stale addresses are kept if a refresh fails
+  strcpy(entries[0].host, "invalid.invalid");
+  entries[0].expires = 0;
+  ASSERT_EQ(lwmqtt_unix_resolve(&resolver, "invalid.invalid", 1883, &addresses), LWMQTT_SUCCESS);
+  EXPECT_EQ(addresses.count, 1u);
+  EXPECT_EQ(lwmqtt_unix_resolve(nullptr, "invalid.invalid", 1883, &addresses), LWMQTT_NETWORK_FAILED_CONNECT);
+
+  // entries that are being refreshed are not replaced, other hosts are then resolved without caching
+  entries[0].refreshing = true;
+  ASSERT_EQ(lwmqtt_unix_resolve(&resolver, "127.0.0.1", 1883, &addresses), LWMQTT_SUCCESS);
+  EXPECT_EQ(addresses.count, 1u);
+  EXPECT_STREQ(entries[0].host, "invalid.invalid");
+  EXPECT_TRUE(entries[0].refreshing);
+
+  lwmqtt_unix_resolver_destroy(&resolver);
+}
+
+static void connect_local(const char *path) {
+  mock_broker_options_t options = mock_broker_default_options;
+  options.path = path;
+  mock_broker_t *b = mock_broker_start(options);
+  ASSERT_NE(b, nullptr);
+  EXPECT_EQ(mock_broker_port(b), 0);
+
+  // tcp options must be skipped for local sockets
+  char host[128];
+  snprintf(host, sizeof(host), "unix:%s", path);
+  lwmqtt_unix_options_t network_options = lwmqtt_unix_default_options;
+  network_options.no_delay = true;
+  network_options.quick_ack = true;
+  network_options.fast_open = true;
+  lwmqtt_unix_network_t network{};
+  ASSERT_EQ(lwmqtt_unix_network_connect_options(&network, host, 0, 1000, &network_options), LWMQTT_SUCCESS);
+
+  lwmqtt_unix_timer_t timer1, timer2;
+  uint8_t write_buf[64], read_buf[64];
+  lwmqtt_client_t client;
+  lwmqtt_init(&client, write_buf, sizeof(write_buf), read_buf, sizeof(read_buf));
+  lwmqtt_set_network(&client, &network, lwmqtt_unix_network_read, lwmqtt_unix_network_write);
+  lwmqtt_set_timers(&client, &timer1, &timer2, lwmqtt_unix_timer_set, lwmqtt_unix_timer_get);
+
+  lwmqtt_return_code_t return_code;
+  ASSERT_EQ(lwmqtt_connect(&client, lwmqtt_default_options, nullptr, &return_code, 1000), LWMQTT_SUCCESS);
+  EXPECT_EQ(return_code, LWMQTT_CONNECTION_ACCEPTED);
+  ASSERT_EQ(lwmqtt_disconnect(&client, 1000), LWMQTT_SUCCESS);
+
+  lwmqtt_unix_network_disconnect(&network);
+  mock_broker_stop(b);
+}
+
+TEST(Unix, Local) {
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/lwmqtt-test-%d.sock", (int)getpid());
+  connect_local(path);
+  EXPECT_NE(access(path, F_OK), 0);
+
+  snprintf(path, sizeof(path), "@lwmqtt-test-%d", (int)getpid());
+  connect_local(path);
+
+  lwmqtt_unix_network_t network{};
+  EXPECT_EQ(lwmqtt_unix_network_connect_timeout(&network, (char *)"unix:/nonexistent/broker.sock", 0, 1000),
+            LWMQTT_NETWORK_FAILED_CONNECT);
+  EXPECT_EQ(lwmqtt_unix_network_connect_timeout(&network, (char *)"unix:", 0, 1000), LWMQTT_NETWORK_FAILED_CONNECT);
+}
+
+TEST(Unix, Spin) {
+  lwmqtt_unix_options_t options = lwmqtt_unix_default_options;
+  options.spin = 200000;
+  options.busy_poll = 50;
+  lwmqtt_unix_network_t network{};
+  ASSERT_EQ(lwmqtt_unix_network_connect_options(&network, (char *)"localhost", mock_broker_port(broker), 1000,
+                                                &options),
+            LWMQTT_SUCCESS);
+  EXPECT_EQ(network.spin, 200000u);
+
+  // send connect and spin until the connack arrives
+  uint8_t connect[14] = {0x10, 12, 0, 4, 'M', 'Q', 'T', 'T', 4, 2, 0, 10, 0, 0};
+  size_t sent = 0;
+  ASSERT_EQ(lwmqtt_unix_network_write(&network, connect, sizeof(connect), &sent, 1000), LWMQTT_SUCCESS);
+  bool available = false;
+  ASSERT_EQ(lwmqtt_unix_network_select(&network, &available, 1000), LWMQTT_SUCCESS);
+  EXPECT_TRUE(available);
+  uint8_t connack[4];
+  size_t read = 0;
+  ASSERT_EQ(lwmqtt_unix_network_read(&network, connack, sizeof(connack), &read, 1000), LWMQTT_SUCCESS);
+  EXPECT_EQ(read, 4u);
+  EXPECT_EQ(connack[0], 0x20);
+  EXPECT_EQ(network.spin_hits, 2u);
+  EXPECT_EQ(network.spin_fallbacks, 0u);
+
+  // fall back to waiting if nothing arrives, spinning at most for the timeout
+  uint64_t start = lwmqtt_unix_clock_get(nullptr);
+  ASSERT_EQ(lwmqtt_unix_network_select(&network, &available, 10), LWMQTT_SUCCESS);
+  EXPECT_FALSE(available);
+  read = 0;
+  ASSERT_EQ(lwmqtt_unix_network_read(&network, connack, sizeof(connack), &read, 10), LWMQTT_SUCCESS);
+  EXPECT_EQ(read, 0u);
+  EXPECT_LT(lwmqtt_unix_clock_get(nullptr) - start, 100000u);
+  EXPECT_EQ(network.spin_hits, 2u);
+  EXPECT_EQ(network.spin_fallbacks, 2u);
+
+  // the counters start over with a new connection
+  lwmqtt_unix_network_disconnect(&network);
+  ASSERT_EQ(lwmqtt_unix_network_connect_options(&network, (char *)"localhost", mock_broker_port(broker), 1000,
+                                                &options),
+            LWMQTT_SUCCESS);
+  EXPECT_EQ(network.spin_hits, 0u);
+  EXPECT_EQ(network.spin_fallbacks, 0u);
+
+  lwmqtt_unix_network_disconnect(&network);
+}